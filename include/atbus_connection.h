@@ -123,6 +123,29 @@ namespace atbus {
          */
         int push(const void *buffer, size_t s);
 
+        /**
+         * @brief 把多段数据作为一条消息发送，各段数据直接复制到通道的发送缓冲区，不需要先合并
+         * @param buffers 数据块地址
+         * @param sizes 数据块长度
+         * @param count 数据块数量
+         * @return 0或错误码，不支持时返回EN_ATBUS_ERR_NOT_SUPPORT
+         * @see is_push_v_supported
+         */
+        int push_v(const void *const buffers[], const size_t sizes[], size_t count);
+
+        /**
+         * @brief 发送共享数据块，io_stream连接的写队列只保存引用，写完成后释放，其他通道直接复制数据
+         * @param buf 共享数据块
+         * @return 0或错误码
+         * @note io_stream连接上共享数据块不会压缩
+         */
+        int push_shared(detail::shared_buffer *buf);
+
+        /**
+         * @brief 是否支持分段发送，目前只有未开启压缩的io_stream连接支持
+         */
+        bool is_push_v_supported() const;
+
         /**
          * @brief 获取连接的地址
          */
@@ -143,6 +166,29 @@ namespace atbus {
          */
         const endpoint *get_binding() const;
 
+        /**
+         * @brief 设置发送数据使用的压缩算法
+         * @param codec_id 压缩算法ID，必须是对端支持的算法，0表示不压缩
+         * @return 0或错误码，非io_stream连接返回EN_ATBUS_ERR_NOT_SUPPORT
+         */
+        int set_compress_codec(uint32_t codec_id);
+
+        /**
+         * @brief 获取发送数据使用的压缩算法，0表示不压缩
+         */
+        uint32_t get_compress_codec() const;
+
+        /**
+         * @brief 是否是不会出现数据损坏的io_stream连接(unix socket和本机回环)
+         */
+        bool is_trusted_transport() const;
+
+        /**
+         * @brief 设置发送时是否跳过帧校验和，对端必须支持
+         * @return 0或错误码，非可信的io_stream连接返回EN_ATBUS_ERR_NOT_SUPPORT
+         */
+        int set_skip_checksum(bool skip);
+
         inline state_t::type get_status() const { return state_; }
         inline bool check_flag(flag_t::type f) const { return flags_.test(f); }
 
@@ -173,6 +219,10 @@ namespace atbus {
                                              void *buffer, size_t s);
         static void iostream_on_written(channel::io_stream_channel *channel, channel::io_stream_connection *connection, int status,
                                         void *buffer, size_t s);
+        static void iostream_on_congested(channel::io_stream_channel *channel, channel::io_stream_connection *connection, int status,
+                                          void *buffer, size_t s);
+        static void iostream_on_drained(channel::io_stream_channel *channel, channel::io_stream_connection *connection, int status,
+                                        void *buffer, size_t s);
 
         static int shm_proc_fn(node &n, connection &conn, time_t sec, time_t usec);
 
@@ -192,6 +242,8 @@ namespace atbus {
 
         static bool unpack(void *res, connection &conn, atbus::protocol::msg &m, void *buffer, size_t s);
 
+        static bool unpack_and_dispatch(node &n, connection &conn, void *buffer, size_t s, int status, int errcode);
+
     private:
         state_t::type state_;
         channel::channel_address_t address_;
@@ -54,6 +54,7 @@ namespace atbus {
 
                 MUTABLE_FLAGS,
                 GLOBAL_ROUTER = MUTABLE_FLAGS, /** 全局路由表 **/
+                FAST_DATA_HEAD,                /** 数据消息使用定长二进制头 **/
                 MAX
             };
         } flag_t;
@@ -160,6 +161,56 @@ namespace atbus {
         size_t get_stat_pull_times() const;
         size_t get_stat_pull_size() const;
 
+        // ===== 发送流控窗口(对端授予) =====
+        /** 是否启用了发送流控(收到对端授予的窗口后启用) **/
+        inline bool is_flow_credit_enabled() const { return flow_.enabled; }
+        inline uint32_t get_flow_credits() const { return flow_.credits; }
+
+        /**
+         * @brief 增加对端授予的窗口
+         * @param credits 窗口数
+         * @param reset 是否重置为credits（连接注册时）
+         */
+        void add_flow_credits(uint32_t credits, bool reset);
+
+        /**
+         * @brief 占用发送窗口，窗口不足时不占用
+         * @param count 占用的窗口数，合并发送的数据每条占用一个
+         * @return 未启用流控或窗口足够时返回true
+         */
+        bool take_flow_credit(uint32_t count = 1);
+
+        inline bool check_flow_blocked() const { return flow_.blocked; }
+        inline void set_flow_blocked(bool v) { flow_.blocked = v; }
+
+        // ===== 接收流控窗口(授予对端) =====
+        /** 增加已处理的消息数，返回尚未归还给对端的窗口数 **/
+        inline uint32_t add_flow_consumed(uint32_t count = 1) { return flow_.consumed += count; }
+
+        /** 取出并清空尚未归还给对端的窗口数 **/
+        uint32_t pop_flow_consumed();
+
+        inline bool check_flow_peer_blocked() const { return flow_.peer_blocked; }
+        inline void set_flow_peer_blocked(bool v) { flow_.peer_blocked = v; }
+
+        // ===== 协议版本和能力协商 =====
+        /** 对端的协议版本，0表示对端不支持能力协商 **/
+        inline uint32_t get_protocol_version() const { return protocol_version_; }
+
+        /** 双方都支持的能力(protocol::reg_data::capability_t) **/
+        inline uint32_t get_capabilities() const { return capabilities_; }
+        inline bool check_capability(uint32_t cap) const { return cap == (capabilities_ & cap); }
+
+        /**
+         * @brief 设置注册时协商的结果
+         * @param protocol_version 对端的协议版本
+         * @param capabilities 双方都支持的能力
+         */
+        inline void set_capabilities(uint32_t protocol_version, uint32_t capabilities) {
+            protocol_version_ = protocol_version;
+            capabilities_ = capabilities;
+        }
+
         inline const node *get_owner() const { return owner_; }
 
     private:
@@ -186,6 +237,21 @@ namespace atbus {
             stat_t();
         };
         stat_t stat_;
+
+        // 流控数据
+        struct flow_t {
+            bool enabled;      // 对端是否启用了流控
+            bool blocked;      // 本端是否因窗口耗尽而阻塞
+            bool peer_blocked; // 对端是否因窗口耗尽而阻塞
+            uint32_t credits;  // 剩余可发送的窗口
+            uint32_t consumed; // 已处理但未归还给对端的窗口
+            flow_t();
+        };
+        flow_t flow_;
+
+        // 协商数据
+        uint32_t protocol_version_;
+        uint32_t capabilities_;
     };
 }
 
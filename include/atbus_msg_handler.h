@@ -14,9 +14,16 @@
 #include <ctime>
 #include <list>
 
+#include "detail/libatbus_config.h"
+
 namespace atbus {
     namespace protocol {
         struct msg;
+        struct node_tree;
+    }
+
+    namespace detail {
+        class shared_buffer_ptr;
     }
 
     class node;
@@ -34,8 +41,38 @@ namespace atbus {
 
         static int send_transfer_rsp(node &n, protocol::msg &, int32_t ret_code);
 
+        static int send_credit(int32_t msg_id, node &n, connection &conn, uint32_t credits, bool reset);
+
+        /**
+         * @brief 记录处理完的来自对端的消息数，处理过半或对端已阻塞时归还流控窗口
+         * @param n 节点
+         * @param ep 来源端点
+         * @param count 处理完的消息数
+         * @return 0或错误码
+         */
+        static int add_flow_consumed(node &n, endpoint &ep, uint32_t count);
+
+        static int send_node_sync(int32_t msg_id, node &n, connection &conn, protocol::node_tree *tree);
+
+        /**
+         * @brief 发送跨子树直连的地址请求或回复，按目标ID逐跳转发
+         * @param n 节点
+         * @param to 目标节点
+         * @param addr_ep 回复包里填写这个端点的监听地址，NULL则发送请求包
+         * @return 0或错误码
+         */
+        static int send_peer_conn_syn(node &n, ATBUS_MACRO_BUSID_TYPE to, const endpoint *addr_ep);
+
         static int send_msg(node &n, connection &conn, const protocol::msg &m);
 
+        /**
+         * @brief 发送内容完全相同的消息给多个连接时共享同一份打包结果
+         * @param packed 打包结果，为空时打包并写入，之后的连接直接引用
+         * @note 总是使用msgpack，io_stream连接上不会复制数据
+         * @return 0或错误码
+         */
+        static int send_msg_shared(node &n, connection &conn, const protocol::msg &m, detail::shared_buffer_ptr &packed);
+
 
         // ========================= 接收handle =========================
         static int on_recv_data_transfer_req(node &n, connection *conn, protocol::msg &, int status, int errcode);
@@ -50,6 +87,8 @@ namespace atbus {
         static int on_recv_node_conn_syn(node &n, connection *conn, protocol::msg &, int status, int errcode);
         static int on_recv_node_ping(node &n, connection *conn, protocol::msg &, int status, int errcode);
         static int on_recv_node_pong(node &n, connection *conn, protocol::msg &, int status, int errcode);
+        static int on_recv_node_credit_req(node &n, connection *conn, protocol::msg &, int status, int errcode);
+        static int on_recv_node_credit_rsp(node &n, connection *conn, protocol::msg &, int status, int errcode);
     };
 }
 
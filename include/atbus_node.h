@@ -30,7 +30,9 @@
 
 #include "detail/libatbus_channel_export.h"
 #include "detail/libatbus_config.h"
+#include "detail/endpoint_index.h"
 #include "detail/libatbus_error.h"
+#include "detail/recv_dispatcher.h"
 
 #include "atbus_endpoint.h"
 
@@ -43,7 +45,10 @@ namespace atbus {
         typedef ATBUS_MACRO_BUSID_TYPE bus_id_t;
         struct conf_flag_t {
             enum type {
-                EN_CONF_GLOBAL_ROUTER, /** 全局路由表 **/
+                EN_CONF_GLOBAL_ROUTER,         /** 全局路由表 **/
+                EN_CONF_SKIP_TRUSTED_CHECKSUM, /** unix socket和本机回环的io_stream连接跳过帧校验和，对端也开启时才生效 **/
+                EN_CONF_FAST_DATA_HEAD,        /** 数据消息使用定长二进制头代替msgpack，对端也开启时才生效 **/
+                EN_CONF_BOUNDED_ROUTER,        /** 发出的数据消息只记录跳数和最近经过的节点，设置了on_debug时才记录完整路由 **/
                 EN_CONF_MAX
             };
         };
@@ -61,6 +66,9 @@ namespace atbus {
                 EN_FT_SHUTDOWN,        /** 已完成关闭前的资源回收 **/
                 EN_FT_RECV_SELF_MSG,   /** 正在接收发给自己的信息 **/
                 EN_FT_IN_CALLBACK,     /** 在回调函数中 **/
+                EN_FT_PACKING_MSG,     /** 正在使用打包缓冲区 **/
+                EN_FT_UNPACKING_MSG,   /** 正在使用接收消息的解包器 **/
+                EN_FT_RECV_STATIC_BUF, /** 内存或共享内存通道正在使用接收缓冲区 **/
                 EN_FT_MAX,             /** flag max **/
             };
         };
@@ -73,6 +81,19 @@ namespace atbus {
             int loop_times;                              /** 消息循环次数限制，防止某些通道繁忙把其他通道堵死 **/
             int ttl;                                     /** 消息转发跳转限制 **/
 
+            // ===== 接收分发配置 =====
+            /**
+             * 接收数据的分发线程数，0则直接在IO线程中回调
+             * 大于0时接收回调在分发线程中执行，回调参数里的endpoint和connection都是NULL，来源节点ID从msg.body.forward->from获取
+             * 回调中不能调用node的任何接口，需要回复时请投递回主线程处理
+             */
+            size_t dispatch_workers;
+            /**
+             * 分发队列积压的消息数上限，积压越多node::poll每帧拉取的消息越少，0则不限制
+             * 这个限制不影响外部事件循环读取io_stream，积压时主要依靠流控窗口延迟归还来限制对端的发送速度
+             */
+            size_t dispatch_pending_limit;
+
             // ===== 连接配置 =====
             int backlog;
             time_t first_idle_timeout; /** 第一个包允许的空闲时间，秒 **/
@@ -85,9 +106,37 @@ namespace atbus {
             size_t recv_buffer_size;   /** 接收缓冲区，和数据包大小有关 **/
             size_t send_buffer_size;   /** 发送缓冲区限制 **/
             size_t send_buffer_number; /** 发送缓冲区静态Buffer数量限制，0则为动态缓冲区 **/
+            size_t send_buffer_overflow_size;  /** 静态发送缓冲区满后最多额外使用的动态缓冲区(字节)，0则不启用 **/
+            size_t send_buffer_high_watermark; /** io_stream连接发送缓冲区高水位(字节)，超过后触发on_endpoint_congested，0则不启用 **/
+            size_t send_buffer_low_watermark;  /** io_stream连接发送缓冲区低水位(字节)，拥塞后降到此值及以下时触发on_endpoint_drained，不低于高水位时修正为高水位的一半 **/
+            size_t buffer_pool_idle_size;      /** io_stream动态缓冲区内存池最多缓存的空闲内存(字节)，0则不使用内存池 **/
+
+            // ===== 压缩配置 =====
+            uint32_t compress_codec;   /** io_stream连接的压缩算法(channel::io_stream_codec::codec_type_t)，0则不启用 **/
+            size_t compress_threshold; /** 数据包达到此大小才尝试压缩 **/
+
+            // ===== 流控配置 =====
+            uint32_t flow_credit_window; /** 授予每个直连对端的接收窗口（消息数），0则不启用。对端不支持流控协议时不启用 **/
+
+            // ===== 合并发送配置 =====
+            size_t send_batch_size; /** 发往同一个直连对端的小数据在一帧内合并发送，合并包的最大长度(字节)，0则不启用 **/
+
+            // ===== 跨子树直连配置 =====
+            size_t peer_connect_threshold; /** 每秒发往同一个跨子树节点的数据包达到此数量时尝试直连，0则不启用。对端也开启时才能建立 **/
         } conf_t;
 
-        typedef std::map<bus_id_t, endpoint::ptr_t> endpoint_collection_t;
+        typedef detail::endpoint_collection_t endpoint_collection_t;
+        /** 和endpoint_collection_t同序的有序数组，成员变化时重建，查找时不需要遍历红黑树节点 **/
+        typedef detail::endpoint_index_t endpoint_index_t;
+
+        /** 全局路由表项，仅开启EN_CONF_GLOBAL_ROUTER时维护 **/
+        struct route_entry_t {
+            bus_id_t bus_id;        /** 目标节点ID **/
+            uint32_t children_mask; /** 目标节点的子节点掩码 **/
+            bus_id_t next_hop;      /** 下一跳(直连节点)ID **/
+            uint32_t distance;      /** 跳数，直连节点为1 **/
+        };
+        typedef std::map<bus_id_t, route_entry_t> route_table_t;
 
         struct evt_msg_t {
             typedef std::function<int(const node &, const endpoint *, const connection *, const protocol::msg &, const void *, size_t)>
@@ -103,6 +152,9 @@ namespace atbus {
                 on_custom_cmd_fn_t;
             typedef std::function<int(const node &, endpoint *, int)> on_add_endpoint_fn_t;
             typedef std::function<int(const node &, endpoint *, int)> on_remove_endpoint_fn_t;
+            typedef std::function<int(const node &, const endpoint *, const connection *)> on_writable_fn_t;
+            typedef std::function<int(const node &, const endpoint *, const connection *, size_t)> on_endpoint_congested_fn_t;
+            typedef std::function<int(const node &, const endpoint *, const connection *, size_t)> on_endpoint_drained_fn_t;
 
             on_recv_msg_fn_t on_recv_msg;
             on_send_data_failed_fn_t on_send_data_failed;
@@ -114,6 +166,9 @@ namespace atbus {
             on_custom_cmd_fn_t on_custom_cmd;
             on_add_endpoint_fn_t on_endpoint_added;
             on_remove_endpoint_fn_t on_endpoint_removed;
+            on_writable_fn_t on_writable;
+            on_endpoint_congested_fn_t on_endpoint_congested;
+            on_endpoint_drained_fn_t on_endpoint_drained;
         };
 
         struct flag_guard_t {
@@ -171,9 +226,17 @@ namespace atbus {
          * @param sec 当前时间-秒
          * @param sec 当前时间-微秒
          * @return 本帧处理的消息数
+         * @note 内存和共享内存通道收到的消息直接引用节点的接收缓冲区，所以在接收回调里调用proc时不会拉取这两种通道，留到下一次proc
          */
         int proc(time_t sec, time_t usec);
 
+        /**
+         * @brief 获取本帧每个通道允许拉取的消息数
+         * @note 启用分发线程池后会根据积压的消息数减少，积压到上限时返回0
+         * @return 本帧允许拉取的消息数
+         */
+        int get_recv_loop_times() const;
+
         /**
          * @brief poll libuv
          * @note can not be call in any libuv's callback
@@ -219,12 +282,80 @@ namespace atbus {
          * @param buffer 数据块地址
          * @param s 数据块长度
          * @param require_rsp 是否强制需要回包（默认情况下如果发送成功是没有回包通知的）
-         * @return 0或错误码
+         * @return 0或错误码，对端流控窗口耗尽时返回EN_ATBUS_ERR_ATNODE_WOULD_BLOCK，可以在on_writable回调后重试
          * @note 接收端收到的数据很可能不是地址对齐的，所以这里不建议发送内存数据
          *       如果非要发送内存数据的话，一定要memcpy，不能直接类型转换，除非手动设置了地址对齐规则
+         * @note 发给自己时如果没有积压的消息且不在回调中，会直接回调，不复制数据
+         *       在回调中发给自己的数据会复制一份排队，等当前回调返回后再分发
+         * @note 启用合并发送后，不需要回包的小数据会先复制到合并缓冲区，在proc或flush时才真正发送
+         *       之后发送失败时每条数据都会通过on_send_data_failed通知，流控窗口也按条数占用
          */
         int send_data(bus_id_t tid, int type, const void *buffer, size_t s, bool require_rsp = false);
 
+        /**
+         * @brief 立即发送所有合并缓冲区里的数据
+         * @return 0或第一个错误码
+         */
+        int flush();
+
+        /**
+         * @brief 立即发送发往目标的合并缓冲区里的数据
+         * @param tid 发送目标ID
+         * @return 0或错误码
+         */
+        int flush(bus_id_t tid);
+
+    private:
+        /**
+         * @brief 合并包发送失败时逐条通知on_send_data_failed
+         */
+        void on_send_batch_failed(bus_id_t tid, const send_batch_t &batch, int errcode);
+
+    public:
+
+        /**
+         * @brief 发送数据给多个目标
+         * @param targets 发送目标ID数组，重复的目标只发送一次
+         * @param n 发送目标个数
+         * @param type 自定义类型，将作为msg.head.type字段传递。可用于业务区分服务类型
+         * @param buffer 数据块地址
+         * @param s 数据块长度
+         * @return 0或第一个错误码，部分目标失败时其他目标仍然会发送
+         * @note 下一跳相同的目标只打包和发送一次，目标列表随消息头传递，由中转节点继续拆分
+         * @note 下一跳不支持多目标协议时退化为逐个目标发送
+         */
+        int send_data_multi(const bus_id_t *targets, size_t n, int type, const void *buffer, size_t s);
+
+        /**
+         * @brief 发送多目标数据消息
+         * @param targets 发送目标ID数组
+         * @param n 发送目标个数
+         * @param mb 消息构建器，发送后forward的targets和路由记录会恢复成发送前的状态
+         * @return 0或第一个错误码
+         */
+        int send_data_multi_msg(const bus_id_t *targets, size_t n, atbus::protocol::msg &mb);
+
+        /**
+         * @brief 广播数据给一个ID段里的所有节点
+         * @param tid 目标ID段里的任意ID，通常是子树根节点的ID
+         * @param mask 目标ID段的掩码位数，通常是子树根节点的children_mask
+         * @param type 自定义类型，将作为msg.head.type字段传递。可用于业务区分服务类型
+         * @param buffer 数据块地址
+         * @param s 数据块长度
+         * @return 0或第一个错误码
+         * @note 每个节点只向子树和目标范围有交集的直连子节点转发一次，接收端收到的消息带有forward_data::FLAG_BROADCAST
+         * @note 下一跳不支持广播协议时只发给下一跳自己，它的子树收不到
+         */
+        int send_data_broadcast(bus_id_t tid, uint32_t mask, int type, const void *buffer, size_t s);
+
+        /**
+         * @brief 把广播消息转发给目标范围内的下一跳，不包含本节点
+         * @param mb 消息构建器，必须带有forward_data::FLAG_BROADCAST
+         * @param prev_hop 消息的上一跳，本节点发起的消息为0
+         * @return 0或第一个错误码
+         */
+        int forward_broadcast_msg(atbus::protocol::msg &mb, bus_id_t prev_hop);
+
         /**
          * @brief 发送数据消息
          * @param tid 发送目标ID
@@ -324,6 +455,10 @@ namespace atbus {
 
         inline const endpoint_collection_t &get_brother() const { return node_brother_; };
 
+        inline const route_table_t &get_route_table() const { return route_table_; };
+
+        inline const endpoint_collection_t &get_peers() const { return node_peers_; };
+
         /**
          * @brief 获取关联的事件管理器,如果未设置则会初始化为默认时间管理器
          * @return 关联的事件管理器
@@ -363,8 +498,30 @@ namespace atbus {
 
         void on_recv(connection *conn, protocol::msg *m, int status, int errcode);
 
+        /**
+         * @brief 不解包直接转发定长二进制头的数据消息
+         * @param conn 来源连接
+         * @param view 收到的消息
+         * @note 只处理单目标、不需要回包的中转，其他情况(包括发送失败)返回false，由调用方解包后走完整的处理流程
+         * @return 已转发返回true
+         */
+        bool forward_fast_data(connection &conn, const protocol::fast_data_view &view);
+
         void on_recv_data(const endpoint *ep, connection *conn, const protocol::msg &m, const void *buffer, size_t s) const;
 
+        /**
+         * @brief 一条占用流控窗口的消息处理完毕
+         * @param ep_id 来源端点
+         * @param dispatch_pushed 处理前分发线程已投递的消息数，期间有消息投递到分发线程时等分发线程处理完再归还窗口
+         * @param count 这条消息占用的窗口数，合并包按数据条数计算
+         */
+        void on_flow_consumed(bus_id_t ep_id, size_t dispatch_pushed, uint32_t count);
+
+        /**
+         * @brief 获取已投递到分发线程的消息数，未启用分发线程时为0
+         */
+        size_t get_dispatch_pushed() const;
+
         void on_send_data_failed(const endpoint *, const connection *, const protocol::msg *m);
 
         int on_error(const char *file_path, size_t line, const endpoint *, const connection *, int, int);
@@ -376,6 +533,9 @@ namespace atbus {
         int on_parent_reg_done();
         int on_custom_cmd(const endpoint *, const connection *, bus_id_t from,
                           const std::vector<std::pair<const void *, size_t> > &cmd_args);
+        int on_writable(const endpoint *, const connection *);
+        int on_endpoint_congested(const endpoint *, const connection *, size_t pending_size);
+        int on_endpoint_drained(const endpoint *, const connection *, size_t pending_size);
 
         /**
          * @brief 关闭node
@@ -394,19 +554,63 @@ namespace atbus {
         /** dispatch all self messages **/
         int dispatch_all_self_msgs();
 
+    private:
+        /**
+         * @brief 分发一条发给自己的数据消息
+         * @note 数据区直接引用传入的数据块，回调返回后不再使用
+         */
+        void dispatch_self_data_msg(const atbus::protocol::msg_head &head, int flags, const void *buffer, size_t s);
+
+    public:
+
         inline const detail::buffer_block *get_temp_static_buffer() const { return static_buffer_; }
         inline detail::buffer_block *get_temp_static_buffer() { return static_buffer_; }
 
+        inline const detail::buffer_block *get_temp_pack_buffer() const { return pack_buffer_; }
+        inline detail::buffer_block *get_temp_pack_buffer() { return pack_buffer_; }
+
+        /**
+         * @brief 打包缓冲区正在使用时(在push的回调中再次发送)，从空闲列表取一个嵌套使用的打包缓冲区
+         * @note 用完后必须调用free_nested_pack_buffer放回，缓冲区在reset时才释放
+         */
+        detail::buffer_block *alloc_nested_pack_buffer();
+        void free_nested_pack_buffer(detail::buffer_block *block);
+
+        inline protocol::msg_unpacker &get_recv_msg_unpacker() { return recv_unpacker_; }
+
         int ping_endpoint(endpoint &ep);
 
+        /**
+         * @brief 把全局路由表的变更推送给所有开启了全局路由表的直连节点
+         * @note 新加入的直连节点推送全量表，其他节点只推送增量
+         * @return 0或错误码
+         */
         int push_node_sync();
 
+        /**
+         * @brief 向所有开启了全局路由表的直连节点请求全量路由表
+         * @return 0或错误码
+         */
         int pull_node_sync();
 
+        /**
+         * @brief 收到直连节点的路由表请求，下一次推送时给它发送全量表
+         */
+        int on_node_sync_req(const endpoint *ep);
+
+        /**
+         * @brief 收到直连节点推送的路由表，合并到本地全局路由表
+         */
+        int on_node_sync_rsp(const endpoint *ep, const protocol::node_tree &tree);
+
         uint32_t alloc_msg_seq();
 
         void add_check_list(const endpoint::ptr_t &ep);
 
+        /**
+         * @brief 设置接收数据的回调
+         * @note 开启了分发线程时，已经投递到分发线程的消息可能仍然使用旧的回调
+         */
         void set_on_recv_handle(evt_msg_t::on_recv_msg_fn_t fn);
         evt_msg_t::on_recv_msg_fn_t get_on_recv_handle() const;
 
@@ -437,15 +641,63 @@ namespace atbus {
         void set_on_remove_endpoint_handle(evt_msg_t::on_remove_endpoint_fn_t fn);
         evt_msg_t::on_remove_endpoint_fn_t get_on_remove_endpoint_handle() const;
 
+        void set_on_writable_handle(evt_msg_t::on_writable_fn_t fn);
+        evt_msg_t::on_writable_fn_t get_on_writable_handle() const;
+
+        void set_on_endpoint_congested_handle(evt_msg_t::on_endpoint_congested_fn_t fn);
+        evt_msg_t::on_endpoint_congested_fn_t get_on_endpoint_congested_handle() const;
+
+        void set_on_endpoint_drained_handle(evt_msg_t::on_endpoint_drained_fn_t fn);
+        evt_msg_t::on_endpoint_drained_fn_t get_on_endpoint_drained_handle() const;
+
         void ref_object(void *);
         void unref_object(void *);
 
     private:
-        static endpoint *find_child(endpoint_collection_t &coll, bus_id_t id);
+        /**
+         * @brief 查找发往目标的下一跳
+         * @param tid 目标ID
+         * @param fn 获取有效连接的接口
+         * @param ep_out 导出下一跳的端点，没有可用的下一跳时为NULL
+         * @param conn_out 导出下一跳的连接，没有可用的连接时为NULL
+         * @return 0或错误码
+         */
+        int find_next_hop(bus_id_t tid, endpoint::get_connection_fn_t fn, endpoint **ep_out, connection **conn_out);
 
-        bool insert_child(endpoint_collection_t &coll, endpoint::ptr_t ep);
+        /**
+         * @brief 通过下一跳的连接发送消息，处理流控窗口和路由记录
+         * @param shared_packed 多个下一跳收到的内容完全相同时共享打包结果，NULL时每次单独打包
+         */
+        int send_msg_to_next_hop(endpoint *to_ep, connection &conn, atbus::protocol::msg &m,
+                                 detail::shared_buffer_ptr *shared_packed = NULL);
+
+        /**
+         * @brief 直连节点变化时更新全局路由表
+         */
+        void route_table_add_direct(const endpoint &ep);
+        void route_table_remove_next_hop(bus_id_t next_hop);
+
+        /**
+         * @brief 在下一次proc时推送路由表变更，同一秒内的多次变更合并推送
+         */
+        void schedule_node_sync_push();
+
+        /**
+         * @brief 给单个直连节点发送路由表
+         * @param ep 目标节点
+         * @param full 是否发送全量表
+         */
+        int send_node_sync(endpoint &ep, bool full);
+
+        /**
+         * @brief 检查上一秒发往跨子树节点的流量，超过阈值的向目标请求监听地址
+         * @note 请求经由父节点逐跳转发，目标回复后再主动连接
+         */
+        void check_peer_traffic(time_t sec);
+
+        bool insert_child(endpoint_collection_t &coll, endpoint_index_t &index, endpoint::ptr_t ep);
 
-        bool remove_child(endpoint_collection_t &coll, bus_id_t id);
+        bool remove_child(endpoint_collection_t &coll, endpoint_index_t &index, bus_id_t id);
 
         bool remove_collection(endpoint_collection_t &coll);
 
@@ -460,9 +712,28 @@ namespace atbus {
          */
         void add_ping_timer(endpoint::ptr_t &ep);
 
+        /**
+         * @brief 分发线程中的数据回调
+         */
+        static void on_dispatch_recv_data(void *priv_data, detail::recv_dispatcher::job_t &job);
+
+        /**
+         * @brief 更新分发线程使用的接收回调副本
+         */
+        void update_dispatch_recv_handle();
+
     public:
         void stat_add_dispatch_times();
 
+        /**
+         * @brief 使下一跳缓存全部失效
+         * @note 端点、连接或路由关系有任何变化时都要调用
+         */
+        void invalidate_route_cache();
+
+        inline size_t get_stat_route_cache_hit_times() const { return stat_.route_cache_hit_times; }
+        inline size_t get_stat_fast_forward_times() const { return stat_.fast_forward_times; }
+
     private:
         // ============ 基础信息 ============
         // ID
@@ -484,10 +755,32 @@ namespace atbus {
         std::unique_ptr<channel::io_stream_channel, io_stream_channel_del> iostream_channel_;
         std::unique_ptr<channel::io_stream_conf> iostream_conf_;
         evt_msg_t event_msg_;
-        typedef std::list<std::vector<unsigned char> > self_data_msgs_t;
+        // 排队的发给自己的数据消息，数据区复制到共享数据块里
+        // 没有积压且不在回调中时会直接分发，不经过这里，也不复制
+        struct self_data_msg_t {
+            atbus::protocol::msg_head head;
+            int flags;
+            detail::shared_buffer_ptr content;
+        };
+        typedef std::list<self_data_msg_t> self_data_msgs_t;
         typedef std::list<std::vector<std::vector<unsigned char> > > self_cmd_msgs_t;
         self_data_msgs_t self_data_msgs_;
         self_cmd_msgs_t self_cmd_msgs_;
+        std::unique_ptr<detail::recv_dispatcher> recv_dispatcher_;
+        // 分发线程使用的接收回调副本，只能通过std::atomic_load/std::atomic_store访问
+        std::shared_ptr<evt_msg_t::on_recv_msg_fn_t> dispatch_recv_handle_;
+        struct send_batch_t {
+            std::vector<unsigned char> data;
+            std::vector<uint32_t> sequences; // 每条数据分配的消息序号，发送失败时逐条通知
+
+            inline bool empty() const { return data.empty(); }
+            inline void swap(send_batch_t &other) {
+                data.swap(other.data);
+                sequences.swap(other.sequences);
+            }
+        };
+        typedef detail::auto_select_map<bus_id_t, send_batch_t>::type send_batch_map_t;
+        send_batch_map_t send_batches_;
 
         // ============ 定时器 ============
         typedef struct {
@@ -501,6 +794,7 @@ namespace atbus {
             time_t usec;
 
             time_t node_sync_push;                                   // 节点变更推送
+            time_t peer_connect_check;                               // 跨子树直连的流量检测
             time_t father_opr_time_point;                            // 父节点操作时间（断线重连或Ping）
             timer_desc_ls<std::weak_ptr<endpoint> >::type ping_list; // 定时ping
             timer_desc_ls<connection::ptr_t>::type connecting_list;  // 未完成连接（正在网络连接或握手）
@@ -510,6 +804,11 @@ namespace atbus {
 
         // 轮训接收通道集
         detail::buffer_block *static_buffer_;
+        // 发送消息的打包缓冲区
+        detail::buffer_block *pack_buffer_;
+        std::vector<detail::buffer_block *> nested_pack_buffers_; // 嵌套发送时使用的空闲打包缓冲区
+        // 接收消息的解包器
+        protocol::msg_unpacker recv_unpacker_;
         detail::auto_select_map<std::string, connection::ptr_t>::type proc_connections_;
 
         // 基于事件的通道信息
@@ -524,15 +823,41 @@ namespace atbus {
 
         // 兄弟节点
         endpoint_collection_t node_brother_;
+        endpoint_index_t node_brother_index_;
 
         // 子节点
         endpoint_collection_t node_children_;
+        endpoint_index_t node_children_index_;
+
+        // 跨子树直连节点，key是节点ID
+        endpoint_collection_t node_peers_;
+        typedef detail::auto_select_map<bus_id_t, size_t>::type peer_traffic_map_t;
+        peer_traffic_map_t peer_traffic_;              // 本周期发往跨子树节点的数据包数
+        std::map<bus_id_t, time_t> peer_connect_pending_; // 已请求直连的节点和重试时间
 
         // 全局路由表
+        route_table_t route_table_;
+        std::set<bus_id_t> route_changed_;   // 待推送的变更节点
+        std::set<bus_id_t> route_full_sync_; // 待推送全量表的直连节点
+        bool route_pull_pending_;            // 有路由被撤销，下次推送时向直连节点请求全量表找回其他路由
+
+        // 下一跳缓存，按目标ID直接映射，代数和route_cache_generation_不一致的缓存项无效
+        struct route_cache_entry_t {
+            bus_id_t tid;
+            endpoint::get_connection_fn_t fn;
+            endpoint *ep;
+            connection *conn;
+            uint32_t generation;
+        };
+        enum { ROUTE_CACHE_SIZE = 64 };
+        route_cache_entry_t route_cache_[ROUTE_CACHE_SIZE];
+        uint32_t route_cache_generation_;
 
         // 统计信息
         struct stat_info_t {
             size_t dispatch_times;
+            size_t route_cache_hit_times;
+            size_t fast_forward_times;
 
             stat_info_t();
         };
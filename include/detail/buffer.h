@@ -91,7 +91,183 @@ namespace atbus {
             friend class buffer_manager;
             size_t size_;
             size_t used_;
+            buffer_block *prev_;
+            buffer_block *next_;
+        };
+
+        /**
+         * @brief size-class slab pool of buffer_block, not thread safe
+         * @note blocks are rounded up to the smallest size class and cached in a free list of that class after free,
+         *       blocks larger than the largest size class are allocated by buffer_block::malloc directly
+         * @note cached blocks are released to system when idle size exceed max_idle_size or when trim is called
+         */
+        class buffer_block_pool {
+        public:
+            struct stat_t {
+                size_t alloc_count;    // total alloc times
+                size_t hit_count;      // alloc times served by free lists
+                size_t oversize_count; // alloc times larger than the largest size class
+                size_t trim_count;     // blocks released to system
+                size_t used_number;    // pooled blocks in use
+                size_t held_number;    // blocks cached in free lists
+                size_t held_size;      // bytes cached in free lists
+            };
+
+        private:
+            buffer_block_pool(const buffer_block_pool &);
+            buffer_block_pool &operator=(const buffer_block_pool &);
+
+        public:
+            buffer_block_pool();
+            ~buffer_block_pool();
+
+            /**
+             * @brief set size classes
+             * @param sizes data size of every class, will be sorted and deduplicated
+             * @param count number of size classes, 0 to disable pooling
+             * @note this api will fail when there are pooled blocks in use
+             * @return true on success
+             */
+            bool set_size_classes(const size_t *sizes, size_t count);
+
+            inline const std::vector<size_t> &get_size_classes() const { return class_sizes_; }
+
+            /**
+             * @brief set the max bytes cached in free lists, blocks will be released to system once exceeded
+             * @param max_size max idle size, 0 means do not cache any block
+             */
+            void set_max_idle_size(size_t max_size);
+
+            inline size_t get_max_idle_size() const { return max_idle_size_; }
+
+            /** alloc and init buffer_block **/
+            buffer_block *malloc(size_t s);
+
+            /** destroy buffer_block and put it back to free list **/
+            void free(buffer_block *p);
+
+            /**
+             * @brief release cached blocks to system, larger classes first
+             * @param keep_size bytes to keep in free lists
+             */
+            void trim(size_t keep_size = 0);
+
+            inline const stat_t &get_stat() const { return stat_; }
+
+            /** hit rate of alloc, in [0, 1] **/
+            double get_hit_rate() const;
+
+        private:
+            size_t find_class(size_t s) const;
+
+        private:
+            std::vector<size_t> class_sizes_;
+            std::vector<void *> free_lists_;
+            size_t max_idle_size_;
+            stat_t stat_;
+        };
+
+        /**
+         * @brief refcounted immutable buffer, head and data are allocated in one block, not thread safe
+         * @note data can only be written by the creator before it's shared, then it can be referenced by several
+         *       write queues without copying, and will be freed when the last reference is released
+         */
+        class shared_buffer {
+        public:
+            inline const void *data() const { return reinterpret_cast<const char *>(this) + head_size(); }
+
+            /** writable data, can only be used before this buffer is shared **/
+            inline void *mutable_data() { return reinterpret_cast<char *>(this) + head_size(); }
+
+            inline size_t size() const { return size_; }
+
+            inline size_t use_count() const { return ref_count_; }
+
+            void add_ref();
+
+            /** decrease reference count and free it when it's the last reference **/
+            void release();
+
+        public:
+            /** alloc shared_buffer with one reference owned by caller **/
+            static shared_buffer *malloc(size_t s);
+
+            /** alloc shared_buffer with one reference owned by caller and copy segments into it **/
+            static shared_buffer *create(const void *const bufs[], const size_t lens[], size_t count);
+
+            static size_t head_size();
+
+        private:
+            size_t ref_count_;
+            size_t size_;
+        };
+
+        /**
+         * @brief smart pointer of shared_buffer, not thread safe
+         */
+        class shared_buffer_ptr {
+        public:
+            inline shared_buffer_ptr() : buffer_(NULL) {}
+
+            /** take the reference owned by caller **/
+            inline explicit shared_buffer_ptr(shared_buffer *p) : buffer_(p) {}
+
+            inline shared_buffer_ptr(const shared_buffer_ptr &other) : buffer_(other.buffer_) {
+                if (NULL != buffer_) {
+                    buffer_->add_ref();
+                }
+            }
+
+            inline ~shared_buffer_ptr() { reset(); }
+
+            inline shared_buffer_ptr &operator=(const shared_buffer_ptr &other) {
+                shared_buffer_ptr copy(other);
+                swap(copy);
+                return *this;
+            }
+
+            /** release current buffer and take the reference of p owned by caller **/
+            inline void reset(shared_buffer *p = NULL) {
+                if (NULL != buffer_) {
+                    buffer_->release();
+                }
+                buffer_ = p;
+            }
+
+            inline void swap(shared_buffer_ptr &other) { std::swap(buffer_, other.buffer_); }
+
+            inline shared_buffer *get() const { return buffer_; }
+            inline shared_buffer *operator->() const { return buffer_; }
+            inline operator bool() const { return NULL != buffer_; }
+
+        private:
+            shared_buffer *buffer_;
+        };
+
+        /**
+         * @brief fixed size output stream, can be used as Stream of msgpack::packer
+         * @note data will not be written after overflow, but the required size will still be accumulated
+         */
+        class fixed_buffer_stream {
+        public:
+            fixed_buffer_stream(void *pointer, size_t s);
+
+            void write(const char *buf, size_t s);
+
+            void reset();
+
+            inline void *data() { return pointer_; }
+            inline const void *data() const { return pointer_; }
+
+            /** written size, or required size if overflow **/
+            inline size_t size() const { return used_; }
+            inline size_t capacity() const { return capacity_; }
+            inline bool overflow() const { return used_ > capacity_; }
+
+        private:
             void *pointer_;
+            size_t capacity_;
+            size_t used_;
         };
 
         /**
@@ -167,14 +343,45 @@ namespace atbus {
              * @brief set dynamic mode(use malloc when push buffer) or static mode(malloc a huge buffer at once)
              * @param max_size circle buffer size when static mode, 0 when dynamic mode
              * @param max_number buffer number when static mode
+             * @param overflow_size max total size of dynamic blocks chained after the circle buffer when it's full, 0 to disable
              * @note this api will clear buffer data already exists
+             * @note when overflow is enabled, push_back will not fail when circle buffer is full until the total size exceed
+             *       max_size + overflow_size, and overflow blocks will be freed once they are popped
              */
-            void set_mode(size_t max_size, size_t max_number);
+            void set_mode(size_t max_size, size_t max_number, size_t overflow_size = 0);
 
             inline bool is_static_mode() const { return NULL != static_buffer_.buffer_; }
             inline bool is_dynamic_mode() const { return NULL == static_buffer_.buffer_; }
 
+            /** static mode and allow to overflow to dynamic blocks **/
+            inline bool is_overflow_enabled() const { return NULL != static_buffer_.buffer_ && static_buffer_.overflow_size_ > 0; }
+
+            /** has dynamic blocks chained after the circle buffer in static mode **/
+            inline bool is_overflowed() const { return NULL != static_buffer_.buffer_ && NULL != dynamic_buffer_.head_; }
+
+            /**
+             * @brief set the block pool used in dynamic mode
+             * @param pool block pool, NULL to use malloc/free directly
+             * @note pool must be alive until this manager is reset or destroyed, and this api will fail when manager is not empty
+             * @return true on success
+             */
+            bool set_block_pool(buffer_block_pool *pool);
+
+            inline buffer_block_pool *get_block_pool() const { return block_pool_; }
+
         private:
+            buffer_block *dynamic_malloc(size_t s);
+
+            void dynamic_free(buffer_block *p);
+
+            void dynamic_link_back(buffer_block *p);
+
+            void dynamic_link_front(buffer_block *p);
+
+            void dynamic_unlink(buffer_block *p);
+
+            void dynamic_replace(buffer_block *old_block, buffer_block *new_block);
+
             buffer_block *static_front();
 
             buffer_block *static_back();
@@ -219,10 +426,18 @@ namespace atbus {
                 size_t head_;
                 size_t tail_;
                 std::vector<buffer_block *> circle_index_;
+                size_t overflow_size_;
+            };
+
+            // intrusive list, linked by buffer_block::prev_ and buffer_block::next_
+            struct dynamic_buffer_t {
+                buffer_block *head_;
+                buffer_block *tail_;
             };
 
             static_buffer_t static_buffer_;
-            std::list<buffer_block *> dynamic_buffer_;
+            dynamic_buffer_t dynamic_buffer_;
+            buffer_block_pool *block_pool_;
 
             limit_t limit_;
         };
@@ -0,0 +1,38 @@
+#ifndef LIBATBUS_DETAIL_ENDPOINT_INDEX_H_
+#define LIBATBUS_DETAIL_ENDPOINT_INDEX_H_
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "std/smart_ptr.h"
+
+#include "detail/libatbus_config.h"
+
+namespace atbus {
+    class endpoint;
+
+    namespace detail {
+        typedef std::map<ATBUS_MACRO_BUSID_TYPE, std::shared_ptr<endpoint> > endpoint_collection_t;
+        /** 和endpoint_collection_t同序的有序数组，成员变化时重建，查找时不需要遍历红黑树节点 **/
+        typedef std::vector<std::pair<ATBUS_MACRO_BUSID_TYPE, endpoint *> > endpoint_index_t;
+
+        /**
+         * @brief 查找目标ID所在子域的直连节点
+         * @param index 直连节点的查找索引
+         * @param id 目标ID
+         * @return 目标节点或者负责转发的直连节点，找不到则返回NULL
+         */
+        endpoint *find_child(const endpoint_index_t &index, ATBUS_MACRO_BUSID_TYPE id);
+
+        /**
+         * @brief 按直连节点集合重建查找索引
+         */
+        void rebuild_endpoint_index(const endpoint_collection_t &coll, endpoint_index_t &index);
+    }
+}
+
+#endif
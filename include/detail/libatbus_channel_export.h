@@ -67,8 +67,23 @@ namespace atbus {
         extern int io_stream_disconnect_fd(io_stream_channel *channel, adapter::fd_t fd, io_stream_callback_t callback);
         extern int io_stream_try_write(io_stream_connection *connection);
         extern int io_stream_send(io_stream_connection *connection, const void *buf, size_t len);
+        // 把多段数据作为一条消息发送，只复制一次。多段数据不会压缩
+        extern int io_stream_send_v(io_stream_connection *connection, const void *const bufs[], const size_t lens[], size_t count);
+        // 发送共享数据块，写队列只保存引用，写完成后释放。共享数据块不会压缩
+        extern int io_stream_send_shared(io_stream_connection *connection, ::atbus::detail::shared_buffer *buf);
 
         extern void io_stream_show_channel(io_stream_channel *channel, std::ostream &out);
+
+        // 注册自定义的压缩算法，需要在所有连接建立前调用，非线程安全
+        extern int io_stream_register_codec(const io_stream_codec *codec);
+        extern const io_stream_codec *io_stream_get_codec(uint8_t id);
+        // 设置发送数据使用的压缩算法，必须是对端支持的算法，一般在注册握手时协商
+        extern int io_stream_set_codec(io_stream_connection *connection, uint8_t id);
+
+        // 是否是不会出现数据损坏的传输(unix socket和本机回环地址)
+        extern bool io_stream_is_trusted_transport(const io_stream_connection *connection);
+        // 设置发送时是否跳过帧校验和，只能用于可信的传输，并且对端要支持，一般在注册握手时协商
+        extern int io_stream_set_skip_checksum(io_stream_connection *connection, bool skip);
     }
 }
 
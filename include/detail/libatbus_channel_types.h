@@ -12,11 +12,13 @@
 #define LIBATBUS_CHANNEL_TYPES_H_
 
 #include <cstddef>
+#include <deque>
 #include <map>
 #include <ostream>
 #include <stdint.h>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "lock/seq_alloc.h"
 #include "std/smart_ptr.h"
@@ -75,13 +77,36 @@ namespace atbus {
                                              size_t s                          // 额外参数长度
                                              );
 
+        /**
+         * @brief io_stream传输压缩算法
+         * @note 压缩帧的数据区为1字节算法ID + varint的原始长度 + 压缩后的数据，帧头的hash异或压缩标记和普通帧区分
+         *       接收端总是可以识别压缩帧，所以只有发送端需要知道对端是否支持
+         */
+        struct io_stream_codec {
+            typedef enum {
+                EN_CT_NONE = 0, // 保留，表示不压缩
+                EN_CT_LZ = 1,   // 内置的LZ类快速压缩算法
+                EN_CT_MAX = 256,
+            } codec_type_t;
+
+            uint8_t id;
+            const char *name;
+            size_t (*compress_bound)(size_t in_len);
+            // 返回压缩后的长度，失败返回0
+            size_t (*compress)(const void *in, size_t in_len, void *out, size_t out_len);
+            // 成功返回0，解压后的长度必须正好是out_len
+            int (*decompress)(const void *in, size_t in_len, void *out, size_t out_len);
+        };
+
         struct io_stream_callback_evt_t {
             enum mem_fn_t {
                 EN_FN_ACCEPTED = 0,
                 EN_FN_CONNECTED, // 连接或listen成功
                 EN_FN_DISCONNECTED,
                 EN_FN_RECVED,
-                EN_FN_WRITEN,
+                EN_FN_WRITEN,    // 开启压缩时回调的是实际发送的帧数据
+                EN_FN_CONGESTED, // 发送缓冲区超过高水位
+                EN_FN_DRAINED,   // 拥塞后发送缓冲区降到低水位
                 MAX
             };
             // 回调函数
@@ -96,6 +121,9 @@ namespace atbus {
                 EN_CF_ACCEPT,
                 EN_CF_WRITING,
                 EN_CF_CLOSING,
+                EN_CF_CONGESTED,
+                EN_CF_NO_CHECKSUM, // 发送时不计算帧校验和，仅可信的传输(unix socket和本机回环)可用
+                EN_CF_TRUSTED,     // 可信的传输，在accept或connect完成时根据地址判定
                 EN_CF_MAX,
             } flag_t;
 
@@ -125,6 +153,21 @@ namespace atbus {
             read_head_t read_head;
             ::atbus::detail::buffer_manager write_buffers; // 写数据缓冲区(两种Buffer管理方式，一种动态，一种静态)
 
+            /**
+             * @brief 写数据缓冲区里每一帧的帧头长度(32bits hash+vint)和数据长度，和入队顺序一致
+             * @note 合并发送块时帧的顺序不变，写完成和关闭时按索引回调，不需要再解析帧头
+             * @note 引用共享数据块的帧在发送块里只有帧头，写完成后释放引用
+             */
+            typedef struct {
+                size_t head_len;
+                size_t data_len;
+                ::atbus::detail::shared_buffer *shared; // 引用的共享数据块，NULL表示数据在发送块里
+            } write_frame_t;
+            std::deque<write_frame_t> write_frames;
+            size_t write_shared_size; // 写队列里引用的共享数据块总长度
+
+            const io_stream_codec *codec; // 发送数据使用的压缩算法，NULL表示不压缩
+
             // 自定义数据区域
             void *data;
         };
@@ -138,8 +181,13 @@ namespace atbus {
             size_t recv_buffer_static;
             size_t send_buffer_max_size;
             size_t send_buffer_limit_size;
+            size_t send_buffer_overflow_size;  // 静态发送缓冲区满后最多额外使用的动态缓冲区(字节)，0表示不启用
             size_t recv_buffer_max_size;
             size_t recv_buffer_limit_size;
+            size_t send_buffer_high_watermark; // 发送缓冲区高水位(字节)，0表示不启用拥塞通知
+            size_t send_buffer_low_watermark;  // 发送缓冲区低水位(字节)，拥塞后降到此值及以下时通知恢复，不低于高水位时修正为高水位的一半
+            size_t buffer_pool_idle_size;      // 动态缓冲区内存池最多缓存的空闲内存(字节)，0表示不使用内存池
+            size_t compress_threshold;         // 开启压缩的连接上，数据长度达到此值才尝试压缩
 
             time_t confirm_timeout;
             int backlog; // backlog indicates the number of connections the kernel might queue
@@ -158,6 +206,9 @@ namespace atbus {
 
             io_stream_conf conf;
 
+            // 所有连接动态模式的缓冲区共享的内存池，必须在连接池之前声明以保证后析构
+            ::atbus::detail::buffer_block_pool block_pool;
+
             typedef ATBUS_ADVANCE_TYPE_MAP(adapter::fd_t, std::shared_ptr<io_stream_connection>) conn_pool_t;
             conn_pool_t conn_pool;
             typedef ATBUS_ADVANCE_TYPE_MAP(uintptr_t, std::shared_ptr<io_stream_connection>) conn_gc_pool_t;
@@ -166,6 +217,8 @@ namespace atbus {
             // 事件响应
             io_stream_callback_evt_t evt;
 
+            std::vector<char> decompress_buffer; // 解压缓冲区
+
             int error_code; // 记录外部的错误码
             // 统计信息
             util::lock::seq_alloc_u32 active_reqs; // 正在进行的req数量
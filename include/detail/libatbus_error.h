@@ -19,6 +19,7 @@ typedef enum {
     EN_ATBUS_ERR_ACCESS_DENY = -11,    // 不允许的操作
     EN_ATBUS_ERR_UNPACK = -12,         // 解包失败
     EN_ATBUS_ERR_PACK = -13,           // 打包失败
+    EN_ATBUS_ERR_NOT_SUPPORT = -14,    // 当前编译环境不支持
 
     EN_ATBUS_ERR_ATNODE_NOT_FOUND = -65,        // 查找不到目标节点
     EN_ATBUS_ERR_ATNODE_INVALID_ID = -66,       // 不可用的ID
@@ -29,6 +30,7 @@ typedef enum {
     EN_ATBUS_ERR_ATNODE_TTL = -71,              // ttl限制
     EN_ATBUS_ERR_ATNODE_MASK_CONFLICT = -72,    // 域范围错误或冲突
     EN_ATBUS_ERR_ATNODE_ID_CONFLICT = -73,      // ID冲突
+    EN_ATBUS_ERR_ATNODE_WOULD_BLOCK = -74,      // 流控窗口已耗尽，等待on_writable回调后重试
 
     EN_ATBUS_ERR_CHANNEL_SIZE_TOO_SMALL = -101,
     EN_ATBUS_ERR_CHANNEL_BUFFER_INVALID = -102, // 缓冲区错误（已被其他模块使用或检测冲突）
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstring>
 #include <ostream>
 #include <stdint.h>
 
@@ -25,6 +26,8 @@ enum ATBUS_PROTOCOL_CMD {
     ATBUS_CMD_NODE_CONN_SYN,
     ATBUS_CMD_NODE_PING,
     ATBUS_CMD_NODE_PONG,
+    ATBUS_CMD_NODE_CREDIT_REQ,
+    ATBUS_CMD_NODE_CREDIT_RSP,
 
     ATBUS_CMD_MAX
 };
@@ -81,20 +84,219 @@ namespace atbus {
             bin_data_block content;                     // ID: 3
             int flags;                                  // ID: 4 | require a response message even success
 
+            enum { ROUTER_TRACE_SIZE = 8 };
+            uint32_t hop_count;                                     // ID: 5 | FLAG_BOUNDED_ROUTER时的跳数
+            ATBUS_MACRO_BUSID_TYPE router_trace[ROUTER_TRACE_SIZE]; // ID: 6 | FLAG_BOUNDED_ROUTER时最近经过的节点，环形数组
+
             enum flag_t {
                 FLAG_REQUIRE_RSP = 0,
+                FLAG_BOUNDED_ROUTER = 1, // 不再展开router，只记录跳数和最近经过的节点，消息长度不随跳数增长
+                FLAG_BATCH = 2,          // content是多条数据合并的批量包(batch_data)
+                FLAG_MULTICAST = 3,      // 发往targets里的所有节点，to无效，中转节点按下一跳拆分后继续转发
+                FLAG_BROADCAST = 4,      // 发往to的低to_mask位所覆盖ID段里的所有节点，每个父节点只向范围有交集的子节点转发一次
             };
 
-            forward_data() : from(0), to(0), flags(0) {
+            std::vector<ATBUS_MACRO_BUSID_TYPE> targets; // ID: 7 | FLAG_MULTICAST时的目标列表
+            uint32_t to_mask;                            // ID: 8 | FLAG_BROADCAST时目标ID段的掩码位数
+
+            forward_data() : from(0), to(0), flags(0), hop_count(0), to_mask(0) {
                 content.size = 0;
                 content.ptr = NULL;
+                for (size_t i = 0; i < ROUTER_TRACE_SIZE; ++i) {
+                    router_trace[i] = 0;
+                }
             }
 
-            inline bool check_flag(flag_t f) { return 0 != (flags & (1 << f)); }
+            inline bool check_flag(flag_t f) const { return 0 != (flags & (1 << f)); }
             inline void set_flag(flag_t f) { flags |= (1 << f); }
             inline void unset_flag(flag_t f) { flags &= ~(1 << f); }
 
-            MSGPACK_DEFINE(from, to, router, content, flags);
+            /**
+             * @brief 记录经过的节点
+             * @param id 节点ID
+             * @param full_trace FLAG_BOUNDED_ROUTER时是否同时写入完整的router，调试用
+             */
+            inline void push_router(ATBUS_MACRO_BUSID_TYPE id, bool full_trace) {
+                if (!check_flag(FLAG_BOUNDED_ROUTER)) {
+                    router.push_back(id);
+                    return;
+                }
+
+                router_trace[hop_count % ROUTER_TRACE_SIZE] = id;
+                ++hop_count;
+                if (full_trace) {
+                    router.push_back(id);
+                }
+            }
+
+            /**
+             * @brief 获取已经过的跳数
+             * @note 老版本的节点转发时只会写入router，所以取两者中较大的
+             */
+            inline size_t get_hop_count() const {
+                return router.size() > static_cast<size_t>(hop_count) ? router.size() : static_cast<size_t>(hop_count);
+            }
+
+            inline size_t get_router_trace_size() const {
+                return hop_count < static_cast<uint32_t>(ROUTER_TRACE_SIZE) ? static_cast<size_t>(hop_count)
+                                                                           : static_cast<size_t>(ROUTER_TRACE_SIZE);
+            }
+
+            /**
+             * @brief 把定长路由记录展开成router并清除FLAG_BOUNDED_ROUTER，转发给不支持的节点前调用
+             * @note 老版本按router的长度计算跳数，环形数组里已经覆盖掉的节点用0占位
+             * @note 已有的router只会追加，调用方可以用resize恢复
+             */
+            inline void expand_router() {
+                if (!check_flag(FLAG_BOUNDED_ROUTER)) {
+                    return;
+                }
+
+                // 调试时已经记录了完整路由，否则补齐到跳数
+                if (router.size() < static_cast<size_t>(hop_count)) {
+                    size_t missing = static_cast<size_t>(hop_count) - router.size();
+                    size_t trace_size = get_router_trace_size();
+                    if (trace_size > missing) {
+                        trace_size = missing;
+                    }
+
+                    router.resize(router.size() + missing - trace_size, static_cast<ATBUS_MACRO_BUSID_TYPE>(0));
+                    for (uint32_t i = hop_count - static_cast<uint32_t>(trace_size); i < hop_count; ++i) {
+                        router.push_back(router_trace[i % ROUTER_TRACE_SIZE]);
+                    }
+                }
+
+                unset_flag(FLAG_BOUNDED_ROUTER);
+                hop_count = 0;
+            }
+
+            /**
+             * @brief 打包的字段数
+             * @note FLAG_BOUNDED_ROUTER时才打包hop_count和router_trace，多目标或广播时才打包targets和to_mask
+             * @note 尾部不需要的字段直接省略，中间不需要的字段用nil占位，老版本只读取前5个字段
+             */
+            inline uint32_t get_msgpack_field_count() const {
+                if (!targets.empty() || 0 != to_mask) {
+                    return 9;
+                }
+
+                return check_flag(FLAG_BOUNDED_ROUTER) ? 7 : 5;
+            }
+
+            template <typename Packer>
+            void msgpack_pack(Packer &pk) const {
+                uint32_t field_count = get_msgpack_field_count();
+                pk.pack_array(field_count);
+                pk.pack(from);
+                pk.pack(to);
+                pk.pack(router);
+                pk.pack(content);
+                pk.pack(flags);
+                if (field_count <= 5) {
+                    return;
+                }
+
+                if (check_flag(FLAG_BOUNDED_ROUTER)) {
+                    // 环形数组只打包已写入的部分
+                    size_t trace_size = get_router_trace_size();
+                    pk.pack(hop_count);
+                    pk.pack_array(static_cast<uint32_t>(trace_size));
+                    for (size_t i = 0; i < trace_size; ++i) {
+                        pk.pack(router_trace[i]);
+                    }
+                } else {
+                    pk.pack_nil();
+                    pk.pack_nil();
+                }
+
+                if (field_count <= 7) {
+                    return;
+                }
+
+                pk.pack(targets);
+                pk.pack(to_mask);
+            }
+
+            void msgpack_unpack(msgpack::object const &o) {
+                if (o.type != msgpack::type::ARRAY) throw msgpack::type_error();
+
+                const msgpack::object *fields = o.via.array.ptr;
+                uint32_t field_count = o.via.array.size;
+                if (field_count > 0) fields[0].convert(from);
+                if (field_count > 1) fields[1].convert(to);
+                if (field_count > 2) fields[2].convert(router);
+                if (field_count > 3) fields[3].convert(content);
+                if (field_count > 4) fields[4].convert(flags);
+
+                // 省略或nil的字段使用默认值
+                hop_count = 0;
+                if (field_count > 5 && !fields[5].is_nil()) {
+                    fields[5].convert(hop_count);
+                }
+
+                if (field_count > 6 && msgpack::type::ARRAY == fields[6].type) {
+                    uint32_t trace_size = fields[6].via.array.size;
+                    if (trace_size > static_cast<uint32_t>(ROUTER_TRACE_SIZE)) {
+                        throw msgpack::type_error();
+                    }
+
+                    for (uint32_t i = 0; i < trace_size; ++i) {
+                        fields[6].via.array.ptr[i].convert(router_trace[i]);
+                    }
+                }
+
+                targets.clear();
+                if (field_count > 7 && !fields[7].is_nil()) {
+                    fields[7].convert(targets);
+                }
+
+                to_mask = 0;
+                if (field_count > 8 && !fields[8].is_nil()) {
+                    fields[8].convert(to_mask);
+                }
+            }
+
+            template <typename MSGPACK_OBJECT>
+            void msgpack_object(MSGPACK_OBJECT *o, msgpack::zone &z) const {
+                uint32_t field_count = get_msgpack_field_count();
+                o->type = msgpack::type::ARRAY;
+                o->via.array.size = field_count;
+                o->via.array.ptr = static_cast<msgpack::object *>(z.allocate_align(sizeof(msgpack::object) * field_count));
+
+                msgpack::object *fields = o->via.array.ptr;
+                fields[0] = msgpack::object(from, z);
+                fields[1] = msgpack::object(to, z);
+                fields[2] = msgpack::object(router, z);
+                fields[3] = msgpack::object(content, z);
+                fields[4] = msgpack::object(flags, z);
+                if (field_count <= 5) {
+                    return;
+                }
+
+                if (check_flag(FLAG_BOUNDED_ROUTER)) {
+                    uint32_t trace_size = static_cast<uint32_t>(get_router_trace_size());
+                    fields[5] = msgpack::object(hop_count, z);
+                    fields[6].type = msgpack::type::ARRAY;
+                    fields[6].via.array.size = trace_size;
+                    fields[6].via.array.ptr = NULL;
+                    if (trace_size > 0) {
+                        fields[6].via.array.ptr = static_cast<msgpack::object *>(z.allocate_align(sizeof(msgpack::object) * trace_size));
+                    }
+                    for (uint32_t i = 0; i < trace_size; ++i) {
+                        fields[6].via.array.ptr[i] = msgpack::object(router_trace[i], z);
+                    }
+                } else {
+                    fields[5] = msgpack::object();
+                    fields[6] = msgpack::object();
+                }
+
+                if (field_count <= 7) {
+                    return;
+                }
+
+                fields[7] = msgpack::object(targets, z);
+                fields[8] = msgpack::object(to_mask, z);
+            }
 
             template <typename CharT, typename Traits>
             friend std::basic_ostream<CharT, Traits> &operator<<(std::basic_ostream<CharT, Traits> &os, const forward_data &mbc) {
@@ -110,6 +312,33 @@ namespace atbus {
                     os << std::endl;
                 }
 
+                if (mbc.check_flag(FLAG_BOUNDED_ROUTER)) {
+                    os << "      hop_count: " << mbc.hop_count << std::endl;
+                    os << "      router_trace: ";
+                    for (size_t i = 0; i < mbc.get_router_trace_size(); ++i) {
+                        if (0 != i) {
+                            os << ", ";
+                        }
+                        os << mbc.router_trace[i];
+                    }
+                    os << std::endl;
+                }
+
+                if (!mbc.targets.empty()) {
+                    os << "      targets: ";
+                    for (size_t i = 0; i < mbc.targets.size(); ++i) {
+                        if (0 != i) {
+                            os << ", ";
+                        }
+                        os << mbc.targets[i];
+                    }
+                    os << std::endl;
+                }
+
+                if (mbc.check_flag(FLAG_BROADCAST)) {
+                    os << "      to_mask: " << mbc.to_mask << std::endl;
+                }
+
                 os << "      content: " << mbc.content << std::endl;
                 os << "      flags: " << mbc.flags << std::endl;
                 os << "    }";
@@ -132,14 +361,15 @@ namespace atbus {
 
         struct node_data {
             ATBUS_MACRO_BUSID_TYPE bus_id;  // ID: 0
-            bool overwrite;                 // ID: 1
+            bool overwrite;                 // ID: 1 | true则添加或更新这个节点的路由，false则删除
             bool flags;                     // ID: 2
             ATBUS_MACRO_BUSID_TYPE children_id_mask;
             std::vector<node_data> children;
+            uint32_t distance; // ID: 5 | 发送方到这个节点的跳数
 
-            node_data() : bus_id(0), overwrite(false), flags(0), children_id_mask(0) {}
+            node_data() : bus_id(0), overwrite(false), flags(0), children_id_mask(0), distance(0) {}
 
-            MSGPACK_DEFINE(bus_id, overwrite, flags, children_id_mask, children);
+            MSGPACK_DEFINE(bus_id, overwrite, flags, children_id_mask, children, distance);
 
             template <typename CharT, typename Traits>
             friend std::basic_ostream<CharT, Traits> &operator<<(std::basic_ostream<CharT, Traits> &os, const node_data &mbc) {
@@ -148,6 +378,7 @@ namespace atbus {
                    << "        overwrite: " << mbc.overwrite << std::endl
                    << "        flags: " << mbc.flags << std::endl
                    << "        children_id_mask: " << mbc.children_id_mask << std::endl
+                   << "        distance: " << mbc.distance << std::endl
                    << "        children: (" << mbc.children.size() << ")" << std::endl;
                 for (size_t i = 0; i < mbc.children.size(); ++i) {
                     os << "      " << mbc.children[i] << std::endl;
@@ -160,12 +391,15 @@ namespace atbus {
 
         struct node_tree {
             std::vector<node_data> nodes; // ID: 0
+            bool full;                    // ID: 1 | 全量表，替换掉之前从发送方学习到的所有路由
+
+            node_tree() : full(false) {}
 
-            MSGPACK_DEFINE(nodes);
+            MSGPACK_DEFINE(nodes, full);
 
             template <typename CharT, typename Traits>
             friend std::basic_ostream<CharT, Traits> &operator<<(std::basic_ostream<CharT, Traits> &os, const node_tree &mbc) {
-                os << "{" << std::endl;
+                os << "{" << std::endl << "      full: " << mbc.full << std::endl;
                 for (size_t i = 0; i < mbc.nodes.size(); ++i) {
                     os << "      nodes: " << mbc.nodes[i] << std::endl;
                 }
@@ -191,18 +425,62 @@ namespace atbus {
             }
         };
 
+        struct credit_data {
+            uint32_t credits; // ID: 0 | 授予的流控窗口（消息数）
+            bool reset;       // ID: 1 | 是否重置窗口（连接注册时）
+
+            credit_data() : credits(0), reset(false) {}
+
+            MSGPACK_DEFINE(credits, reset);
+
+            template <typename CharT, typename Traits>
+            friend std::basic_ostream<CharT, Traits> &operator<<(std::basic_ostream<CharT, Traits> &os, const credit_data &mbc) {
+                os << "{" << std::endl
+                   << "      credits: " << mbc.credits << std::endl
+                   << "      reset: " << mbc.reset << std::endl
+                   << "    }";
+
+                return os;
+            }
+        };
+
         struct reg_data {
+            typedef enum {
+                EN_SF_SKIP_CHECKSUM = 0x01, // 可信的io_stream连接(unix socket和本机回环)可以接收跳过校验和的帧
+            } stream_flag_t;
+
+            // 节点的可选能力，连接上只使用双方都支持的部分，新能力可以逐个节点上线
+            typedef enum {
+                EN_CAP_FAST_DATA_HEAD = 0x01, // 可以收发定长二进制头的数据消息
+                EN_CAP_BOUNDED_ROUTER = 0x02, // 可以处理forward_data::FLAG_BOUNDED_ROUTER
+                EN_CAP_FLOW_CREDIT = 0x04,    // 支持流控窗口协议(ATBUS_CMD_NODE_CREDIT_REQ/RSP)
+                EN_CAP_BATCH_DATA = 0x08,     // 可以接收合并发送的数据消息(forward_data::FLAG_BATCH)
+                EN_CAP_MULTICAST = 0x10,      // 可以接收并继续拆分转发多目标的数据消息(forward_data::FLAG_MULTICAST)
+                EN_CAP_BROADCAST = 0x20,      // 可以接收并继续向子树转发广播的数据消息(forward_data::FLAG_BROADCAST)
+            } capability_t;
+
+            enum {
+                PROTOCOL_VERSION = 1, // 0表示不支持能力协商的老版本
+            };
+
             ATBUS_MACRO_BUSID_TYPE bus_id;      // ID: 0
             int32_t pid;                        // ID: 1
             std::string hostname;               // ID: 2
             std::vector<channel_data> channels; // ID: 3
             uint32_t children_id_mask;          // ID: 4
             uint32_t flags;                     // ID: 5
+            uint32_t compress_codec;            // ID: 6, io_stream连接可以解压的算法，0表示不启用压缩
+            uint32_t stream_flags;              // ID: 7, io_stream连接的帧格式选项(stream_flag_t)
+            uint32_t protocol_version;          // ID: 8, 协议版本
+            uint32_t capabilities;              // ID: 9, 本节点支持的能力(capability_t)
 
 
-            reg_data() : bus_id(0), pid(0), children_id_mask(0), flags(0){}
+            reg_data()
+                : bus_id(0), pid(0), children_id_mask(0), flags(0), compress_codec(0), stream_flags(0), protocol_version(0),
+                  capabilities(0) {}
 
-            MSGPACK_DEFINE(bus_id, pid, hostname, channels, children_id_mask, flags);
+            MSGPACK_DEFINE(bus_id, pid, hostname, channels, children_id_mask, flags, compress_codec, stream_flags, protocol_version,
+                           capabilities);
 
             template <typename CharT, typename Traits>
             friend std::basic_ostream<CharT, Traits> &operator<<(std::basic_ostream<CharT, Traits> &os, const reg_data &mbc) {
@@ -215,6 +493,10 @@ namespace atbus {
                 }
                 os << "      children_id_mask: " << mbc.children_id_mask << std::endl
                    << "      flags: " << mbc.flags << std::endl
+                   << "      compress_codec: " << mbc.compress_codec << std::endl
+                   << "      stream_flags: " << mbc.stream_flags << std::endl
+                   << "      protocol_version: " << mbc.protocol_version << std::endl
+                   << "      capabilities: " << mbc.capabilities << std::endl
                    << "    }";
 
                 return os;
@@ -222,13 +504,29 @@ namespace atbus {
         };
 
         struct conn_data {
-            channel_data address; // ID: 0
+            channel_data address;               // ID: 0 | to为0时直接连接这个地址
+            ATBUS_MACRO_BUSID_TYPE from;        // ID: 1 | 请求直连的节点
+            ATBUS_MACRO_BUSID_TYPE to;          // ID: 2 | 非0时按目标ID逐跳转发
+            std::string hostname;               // ID: 3 | 回复包里目标节点的机器名
+            std::vector<channel_data> channels; // ID: 4 | 回复包里目标节点的监听地址，为空则是请求包
+            uint32_t hop_count;                 // ID: 5 | 逐跳转发时已经经过的节点数
 
-            MSGPACK_DEFINE(address);
+            conn_data() : from(0), to(0), hop_count(0) {}
+
+            MSGPACK_DEFINE(address, from, to, hostname, channels, hop_count);
 
             template <typename CharT, typename Traits>
             friend std::basic_ostream<CharT, Traits> &operator<<(std::basic_ostream<CharT, Traits> &os, const conn_data &mbc) {
-                os << "{" << std::endl << "      address: " << mbc.address << std::endl << "    }";
+                os << "{" << std::endl
+                   << "      address: " << mbc.address << std::endl
+                   << "      from: " << mbc.from << std::endl
+                   << "      to: " << mbc.to << std::endl
+                   << "      hostname: " << mbc.hostname << std::endl
+                   << "      hop_count: " << mbc.hop_count << std::endl;
+                for (size_t i = 0; i < mbc.channels.size(); ++i) {
+                    os << "      channels: " << mbc.channels[i] << std::endl;
+                }
+                os << "    }";
 
                 return os;
             }
@@ -242,32 +540,42 @@ namespace atbus {
             reg_data *reg;
             conn_data *conn;
             custom_command_data *custom;
+            credit_data *credit;
+
+            msg_body() : forward(NULL), sync(NULL), ping(NULL), reg(NULL), conn(NULL), custom(NULL), credit(NULL) {
+                spare_.forward = NULL;
+                spare_.sync = NULL;
+                spare_.ping = NULL;
+                spare_.reg = NULL;
+                spare_.conn = NULL;
+                spare_.custom = NULL;
+                spare_.credit = NULL;
+            }
 
-            msg_body() : forward(NULL), sync(NULL), ping(NULL), reg(NULL), conn(NULL), custom(NULL) {}
             ~msg_body() {
-                if (NULL != forward) {
-                    delete forward;
-                }
-
-                if (NULL != sync) {
-                    delete sync;
-                }
-
-                if (NULL != ping) {
-                    delete ping;
-                }
-
-                if (NULL != reg) {
-                    delete reg;
-                }
-
-                if (NULL != conn) {
-                    delete conn;
-                }
+                reset();
+
+                delete spare_.forward;
+                delete spare_.sync;
+                delete spare_.ping;
+                delete spare_.reg;
+                delete spare_.conn;
+                delete spare_.custom;
+                delete spare_.credit;
+            }
 
-                if (NULL != custom) {
-                    delete custom;
-                }
+            /**
+             * @brief 清空消息体
+             * @note 已分配的消息体对象会恢复成默认值并保留下来，下次make_body时复用
+             */
+            void reset() {
+                recycle(forward, spare_.forward);
+                recycle(sync, spare_.sync);
+                recycle(ping, spare_.ping);
+                recycle(reg, spare_.reg);
+                recycle(conn, spare_.conn);
+                recycle(custom, spare_.custom);
+                recycle(credit, spare_.credit);
             }
 
             template <typename TPtr>
@@ -276,6 +584,13 @@ namespace atbus {
                     return p;
                 }
 
+                TPtr *&spare = get_spare(p);
+                if (NULL != spare) {
+                    p = spare;
+                    spare = NULL;
+                    return p;
+                }
+
                 return p = new TPtr();
             }
 
@@ -321,14 +636,55 @@ namespace atbus {
                     os << "    custom:" << *mb.custom << std::endl;
                 }
 
+                if (NULL != mb.credit) {
+                    os << "    credit:" << *mb.credit << std::endl;
+                }
+
                 os << "  }";
 
                 return os;
             }
 
         private:
+            template <typename TPtr>
+            static void recycle(TPtr *&p, TPtr *&spare) {
+                if (NULL == p) {
+                    return;
+                }
+
+                if (NULL == spare) {
+                    // 复制赋值会保留容器已分配的内存
+                    TPtr empty_body;
+                    *p = empty_body;
+                    spare = p;
+                } else {
+                    delete p;
+                }
+                p = NULL;
+            }
+
+            forward_data *&get_spare(forward_data *) { return spare_.forward; }
+            node_tree *&get_spare(node_tree *) { return spare_.sync; }
+            ping_data *&get_spare(ping_data *) { return spare_.ping; }
+            reg_data *&get_spare(reg_data *) { return spare_.reg; }
+            conn_data *&get_spare(conn_data *) { return spare_.conn; }
+            custom_command_data *&get_spare(custom_command_data *) { return spare_.custom; }
+            credit_data *&get_spare(credit_data *) { return spare_.credit; }
+
             msg_body(const msg_body &);
             msg_body &operator=(const msg_body &);
+
+        private:
+            struct spare_body_t {
+                forward_data *forward;
+                node_tree *sync;
+                ping_data *ping;
+                reg_data *reg;
+                conn_data *conn;
+                custom_command_data *custom;
+                credit_data *credit;
+            };
+            spare_body_t spare_;
         };
 
         struct msg_head {
@@ -369,6 +725,11 @@ namespace atbus {
                 head.src_bus_id = src_bus_id;
             }
 
+            void reset() {
+                head = msg_head();
+                body.reset();
+            }
+
             template <typename CharT, typename Traits>
             friend std::basic_ostream<CharT, Traits> &operator<<(std::basic_ostream<CharT, Traits> &os, const msg &m) {
                 os << "{" << std::endl << "  head: " << m.head << std::endl << "  body:" << m.body << std::endl << "}";
@@ -376,6 +737,463 @@ namespace atbus {
                 return os;
             }
         };
+
+        /**
+         * @brief 数据消息的定长二进制头，握手时双方都开启了才会用于ATBUS_CMD_DATA_TRANSFORM_REQ/RSP
+         * @note 所有整数都是小端序，首字节0xC1在msgpack中不会出现，用来和msgpack编码的消息区分
+         * @note | magic(1) | version(1) | cmd(1) | router count(1) | type(4) | ret(4) | sequence(4) | flags(4) |
+         *       | src_bus_id(8) | from(8) | to(8) | hop count(4) | router(8 * router count) | content |
+         * @note FLAG_BOUNDED_ROUTER时router段是router_trace，否则是router，hop count为0
+         */
+        class fast_data_view;
+        struct batch_data;
+
+        struct fast_data_head {
+            enum {
+                MAGIC = 0xC1,
+                VERSION = 1,
+                HEAD_SIZE = 48,
+                ROUTER_NODE_SIZE = 8,
+                MAX_ROUTER_COUNT = 255
+            };
+
+            // 各字段的偏移
+            enum {
+                OFFSET_VERSION = 1,
+                OFFSET_CMD = 2,
+                OFFSET_ROUTER_COUNT = 3,
+                OFFSET_TYPE = 4,
+                OFFSET_RET = 8,
+                OFFSET_SEQUENCE = 12,
+                OFFSET_FLAGS = 16,
+                OFFSET_SRC_BUS_ID = 20,
+                OFFSET_FROM = 28,
+                OFFSET_TO = 36,
+                OFFSET_HOP_COUNT = 44
+            };
+
+            static inline bool is_supported(const msg &m) {
+                if ((ATBUS_CMD_DATA_TRANSFORM_REQ != m.head.cmd && ATBUS_CMD_DATA_TRANSFORM_RSP != m.head.cmd) || NULL == m.body.forward) {
+                    return false;
+                }
+
+                // 定长头里没有目标列表和广播掩码，多目标和广播的消息走msgpack
+                if (!m.body.forward->targets.empty() || m.body.forward->check_flag(forward_data::FLAG_BROADCAST)) {
+                    return false;
+                }
+
+                // 开启调试的完整路由跟踪时走msgpack
+                if (m.body.forward->check_flag(forward_data::FLAG_BOUNDED_ROUTER)) {
+                    return m.body.forward->router.empty();
+                }
+
+                return m.body.forward->router.size() <= static_cast<size_t>(MAX_ROUTER_COUNT);
+            }
+
+            static inline size_t get_router_count(const forward_data &fwd) {
+                if (fwd.check_flag(forward_data::FLAG_BOUNDED_ROUTER)) {
+                    return fwd.get_router_trace_size();
+                }
+
+                return fwd.router.size();
+            }
+
+            static inline bool is_fast_data_head(const void *buffer, size_t s) {
+                return NULL != buffer && s > 0 && MAGIC == *reinterpret_cast<const unsigned char *>(buffer);
+            }
+
+            static inline size_t packed_size(const msg &m) {
+                if (!is_supported(m)) {
+                    return 0;
+                }
+
+                return HEAD_SIZE + ROUTER_NODE_SIZE * get_router_count(*m.body.forward) + m.body.forward->content.size;
+            }
+
+            /**
+             * @brief 打包数据消息
+             * @return 打包后的长度，不支持的消息或缓冲区不足时返回0
+             */
+            static size_t pack(const msg &m, void *buffer, size_t s) {
+                size_t ret = packed_size(m);
+                if (0 == ret || NULL == buffer || s < ret) {
+                    return 0;
+                }
+
+                size_t head_len = pack_head(m, buffer, s);
+                if (m.body.forward->content.size > 0) {
+                    memcpy(reinterpret_cast<unsigned char *>(buffer) + head_len, m.body.forward->content.ptr, m.body.forward->content.size);
+                }
+
+                return ret;
+            }
+
+            /**
+             * @brief 只打包消息头和路由，数据段可以由调用方直接从原始缓冲区发送
+             * @return 消息头和路由的长度，不支持的消息或缓冲区不足时返回0
+             */
+            static size_t pack_head(const msg &m, void *buffer, size_t s) {
+                if (!is_supported(m)) {
+                    return 0;
+                }
+
+                const forward_data &fwd = *m.body.forward;
+                size_t router_count = get_router_count(fwd);
+                size_t ret = HEAD_SIZE + ROUTER_NODE_SIZE * router_count;
+                if (NULL == buffer || s < ret) {
+                    return 0;
+                }
+
+                unsigned char *p = reinterpret_cast<unsigned char *>(buffer);
+                p[0] = MAGIC;
+                p[OFFSET_VERSION] = VERSION;
+                p[OFFSET_CMD] = static_cast<unsigned char>(m.head.cmd);
+                p[OFFSET_ROUTER_COUNT] = static_cast<unsigned char>(router_count);
+                write_u32(p + OFFSET_TYPE, static_cast<uint32_t>(m.head.type));
+                write_u32(p + OFFSET_RET, static_cast<uint32_t>(m.head.ret));
+                write_u32(p + OFFSET_SEQUENCE, m.head.sequence);
+                write_u32(p + OFFSET_FLAGS, static_cast<uint32_t>(fwd.flags));
+                write_u64(p + OFFSET_SRC_BUS_ID, static_cast<uint64_t>(m.head.src_bus_id));
+                write_u64(p + OFFSET_FROM, static_cast<uint64_t>(fwd.from));
+                write_u64(p + OFFSET_TO, static_cast<uint64_t>(fwd.to));
+                write_u32(p + OFFSET_HOP_COUNT, fwd.check_flag(forward_data::FLAG_BOUNDED_ROUTER) ? fwd.hop_count : 0);
+
+                p += HEAD_SIZE;
+                if (fwd.check_flag(forward_data::FLAG_BOUNDED_ROUTER)) {
+                    for (size_t i = 0; i < router_count; ++i) {
+                        write_u64(p, static_cast<uint64_t>(fwd.router_trace[i]));
+                        p += ROUTER_NODE_SIZE;
+                    }
+                } else {
+                    for (size_t i = 0; i < router_count; ++i) {
+                        write_u64(p, static_cast<uint64_t>(fwd.router[i]));
+                        p += ROUTER_NODE_SIZE;
+                    }
+                }
+
+                return ret;
+            }
+
+            /**
+             * @brief 解包数据消息
+             * @note 不会复制数据，m.body.forward->content直接引用输入缓冲区
+             * @return 成功返回true
+             */
+            static bool unpack(msg &m, const void *buffer, size_t s);
+
+            /**
+             * @brief 中转时重新生成消息头，复制原消息头和路由并记录经过的本节点
+             * @param view 收到的消息
+             * @param relay_id 本节点ID，同时写入src_bus_id
+             * @note 数据段不复制，由调用方直接从接收缓冲区发送
+             * @return 新的消息头和路由的长度，路由已满或缓冲区不足时返回0
+             */
+            static size_t pack_relay_head(const fast_data_view &view, ATBUS_MACRO_BUSID_TYPE relay_id, void *buffer, size_t s);
+
+        private:
+            friend class fast_data_view;
+            friend struct batch_data;
+
+            static inline void write_u32(unsigned char *p, uint32_t v) {
+                p[0] = static_cast<unsigned char>(v & 0xFF);
+                p[1] = static_cast<unsigned char>((v >> 8) & 0xFF);
+                p[2] = static_cast<unsigned char>((v >> 16) & 0xFF);
+                p[3] = static_cast<unsigned char>((v >> 24) & 0xFF);
+            }
+
+            static inline void write_u64(unsigned char *p, uint64_t v) {
+                write_u32(p, static_cast<uint32_t>(v & 0xFFFFFFFF));
+                write_u32(p + 4, static_cast<uint32_t>(v >> 32));
+            }
+
+            static inline uint32_t read_u32(const unsigned char *p) {
+                return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+                       (static_cast<uint32_t>(p[3]) << 24);
+            }
+
+            static inline uint64_t read_u64(const unsigned char *p) {
+                return static_cast<uint64_t>(read_u32(p)) | (static_cast<uint64_t>(read_u32(p + 4)) << 32);
+            }
+        };
+
+        /**
+         * @brief 定长二进制头数据消息的只读视图
+         * @note 直接在接收缓冲区上按偏移读取字段，路由节点不需要解包或复制数据就可以检查to和router
+         * @note 缓冲区格式不合法时is_valid()返回false，这时不能读取其他字段
+         */
+        class fast_data_view {
+        public:
+            fast_data_view(const void *buffer, size_t s) : buffer_(NULL), size_(0) {
+                if (!fast_data_head::is_fast_data_head(buffer, s) || s < static_cast<size_t>(fast_data_head::HEAD_SIZE)) {
+                    return;
+                }
+
+                const unsigned char *p = reinterpret_cast<const unsigned char *>(buffer);
+                if (fast_data_head::VERSION != p[fast_data_head::OFFSET_VERSION] ||
+                    (ATBUS_CMD_DATA_TRANSFORM_REQ != p[fast_data_head::OFFSET_CMD] &&
+                     ATBUS_CMD_DATA_TRANSFORM_RSP != p[fast_data_head::OFFSET_CMD])) {
+                    return;
+                }
+
+                size_t router_count = p[fast_data_head::OFFSET_ROUTER_COUNT];
+                if (s < static_cast<size_t>(fast_data_head::HEAD_SIZE) + fast_data_head::ROUTER_NODE_SIZE * router_count) {
+                    return;
+                }
+
+                buffer_ = p;
+                size_ = s;
+            }
+
+            inline bool is_valid() const { return NULL != buffer_; }
+            inline const void *data() const { return buffer_; }
+            inline size_t size() const { return size_; }
+
+            inline ATBUS_PROTOCOL_CMD get_cmd() const { return static_cast<ATBUS_PROTOCOL_CMD>(buffer_[fast_data_head::OFFSET_CMD]); }
+
+            inline int32_t get_type() const {
+                return static_cast<int32_t>(fast_data_head::read_u32(buffer_ + fast_data_head::OFFSET_TYPE));
+            }
+
+            inline int32_t get_ret() const { return static_cast<int32_t>(fast_data_head::read_u32(buffer_ + fast_data_head::OFFSET_RET)); }
+            inline uint32_t get_sequence() const { return fast_data_head::read_u32(buffer_ + fast_data_head::OFFSET_SEQUENCE); }
+            inline int get_flags() const { return static_cast<int>(fast_data_head::read_u32(buffer_ + fast_data_head::OFFSET_FLAGS)); }
+
+            inline ATBUS_MACRO_BUSID_TYPE get_src_bus_id() const {
+                return static_cast<ATBUS_MACRO_BUSID_TYPE>(fast_data_head::read_u64(buffer_ + fast_data_head::OFFSET_SRC_BUS_ID));
+            }
+
+            inline ATBUS_MACRO_BUSID_TYPE get_from() const {
+                return static_cast<ATBUS_MACRO_BUSID_TYPE>(fast_data_head::read_u64(buffer_ + fast_data_head::OFFSET_FROM));
+            }
+
+            inline ATBUS_MACRO_BUSID_TYPE get_to() const {
+                return static_cast<ATBUS_MACRO_BUSID_TYPE>(fast_data_head::read_u64(buffer_ + fast_data_head::OFFSET_TO));
+            }
+
+            inline uint32_t get_hop_count() const { return fast_data_head::read_u32(buffer_ + fast_data_head::OFFSET_HOP_COUNT); }
+            inline size_t get_router_size() const { return buffer_[fast_data_head::OFFSET_ROUTER_COUNT]; }
+
+            inline bool check_flag(forward_data::flag_t f) const { return 0 != (get_flags() & (1 << f)); }
+
+            /**
+             * @brief 获取已经过的跳数，和forward_data::get_hop_count一致
+             */
+            inline size_t get_passed_hops() const {
+                return check_flag(forward_data::FLAG_BOUNDED_ROUTER) ? static_cast<size_t>(get_hop_count()) : get_router_size();
+            }
+
+            inline ATBUS_MACRO_BUSID_TYPE get_router(size_t idx) const {
+                return static_cast<ATBUS_MACRO_BUSID_TYPE>(
+                    fast_data_head::read_u64(buffer_ + fast_data_head::HEAD_SIZE + fast_data_head::ROUTER_NODE_SIZE * idx));
+            }
+
+            inline size_t get_content_offset() const {
+                return fast_data_head::HEAD_SIZE + fast_data_head::ROUTER_NODE_SIZE * get_router_size();
+            }
+
+            inline size_t get_content_size() const { return size_ - get_content_offset(); }
+            inline const void *get_content() const { return get_content_size() > 0 ? buffer_ + get_content_offset() : NULL; }
+
+        private:
+            const unsigned char *buffer_;
+            size_t size_;
+        };
+
+        inline bool fast_data_head::unpack(msg &m, const void *buffer, size_t s) {
+            fast_data_view view(buffer, s);
+            if (!view.is_valid()) {
+                return false;
+            }
+
+            forward_data *fwd = m.body.make_body(m.body.forward);
+            if (NULL == fwd) {
+                return false;
+            }
+
+            m.head.cmd = view.get_cmd();
+            m.head.type = view.get_type();
+            m.head.ret = view.get_ret();
+            m.head.sequence = view.get_sequence();
+            m.head.src_bus_id = view.get_src_bus_id();
+            fwd->flags = view.get_flags();
+            fwd->from = view.get_from();
+            fwd->to = view.get_to();
+
+            size_t router_count = view.get_router_size();
+            if (fwd->check_flag(forward_data::FLAG_BOUNDED_ROUTER)) {
+                if (router_count > static_cast<size_t>(forward_data::ROUTER_TRACE_SIZE)) {
+                    return false;
+                }
+
+                fwd->hop_count = view.get_hop_count();
+                fwd->router.clear();
+                for (size_t i = 0; i < router_count; ++i) {
+                    fwd->router_trace[i] = view.get_router(i);
+                }
+            } else {
+                fwd->router.resize(router_count);
+                for (size_t i = 0; i < router_count; ++i) {
+                    fwd->router[i] = view.get_router(i);
+                }
+            }
+
+            fwd->content.size = view.get_content_size();
+            fwd->content.ptr = view.get_content();
+            return true;
+        }
+
+        inline size_t fast_data_head::pack_relay_head(const fast_data_view &view, ATBUS_MACRO_BUSID_TYPE relay_id, void *buffer, size_t s) {
+            if (!view.is_valid() || NULL == buffer) {
+                return 0;
+            }
+
+            bool bounded = view.check_flag(forward_data::FLAG_BOUNDED_ROUTER);
+            size_t router_count = view.get_router_size();
+            size_t new_router_count;
+            if (bounded) {
+                // 路由记录的长度必须和跳数一致，否则写入位置会超出路由段
+                size_t hop_count = static_cast<size_t>(view.get_hop_count());
+                if (router_count != (hop_count < static_cast<size_t>(forward_data::ROUTER_TRACE_SIZE)
+                                         ? hop_count
+                                         : static_cast<size_t>(forward_data::ROUTER_TRACE_SIZE))) {
+                    return 0;
+                }
+                new_router_count = router_count < static_cast<size_t>(forward_data::ROUTER_TRACE_SIZE) ? router_count + 1 : router_count;
+            } else {
+                if (router_count >= static_cast<size_t>(MAX_ROUTER_COUNT)) {
+                    return 0;
+                }
+                new_router_count = router_count + 1;
+            }
+
+            size_t ret = HEAD_SIZE + ROUTER_NODE_SIZE * new_router_count;
+            if (s < ret) {
+                return 0;
+            }
+
+            unsigned char *p = reinterpret_cast<unsigned char *>(buffer);
+            memcpy(p, view.data(), HEAD_SIZE + ROUTER_NODE_SIZE * router_count);
+            p[OFFSET_ROUTER_COUNT] = static_cast<unsigned char>(new_router_count);
+            write_u64(p + OFFSET_SRC_BUS_ID, static_cast<uint64_t>(relay_id));
+
+            // 和forward_data::push_router一致，定长路由记录是环形数组
+            if (bounded) {
+                uint32_t hop_count = view.get_hop_count();
+                write_u32(p + OFFSET_HOP_COUNT, hop_count + 1);
+                size_t trace_idx = static_cast<size_t>(hop_count % forward_data::ROUTER_TRACE_SIZE);
+                write_u64(p + HEAD_SIZE + ROUTER_NODE_SIZE * trace_idx, static_cast<uint64_t>(relay_id));
+            } else {
+                write_u64(p + HEAD_SIZE + ROUTER_NODE_SIZE * router_count, static_cast<uint64_t>(relay_id));
+            }
+
+            return ret;
+        }
+
+        /**
+         * @brief 合并发送的数据消息(forward_data::FLAG_BATCH)的内容格式
+         * @note 每条数据: | type(4) | length(4) | data(length) |，整数都是小端序
+         */
+        struct batch_data {
+            enum { ENTRY_HEAD_SIZE = 8 };
+
+            /**
+             * @brief 追加一条数据
+             */
+            static inline void append(std::vector<unsigned char> &out, int32_t type, const void *buffer, size_t s) {
+                size_t offset = out.size();
+                out.resize(offset + ENTRY_HEAD_SIZE + s);
+                fast_data_head::write_u32(&out[offset], static_cast<uint32_t>(type));
+                fast_data_head::write_u32(&out[offset + 4], static_cast<uint32_t>(s));
+                if (s > 0) {
+                    memcpy(&out[offset + ENTRY_HEAD_SIZE], buffer, s);
+                }
+            }
+
+            /**
+             * @brief 读取offset处的一条数据
+             * @param type 输出数据类型
+             * @param data 输出数据地址，直接引用输入缓冲区
+             * @param data_size 输出数据长度
+             * @return 下一条数据的偏移，格式错误返回0
+             */
+            static inline size_t next(const void *buffer, size_t s, size_t offset, int32_t &type, const void *&data, size_t &data_size) {
+                if (NULL == buffer || offset + ENTRY_HEAD_SIZE > s || offset + ENTRY_HEAD_SIZE < offset) {
+                    return 0;
+                }
+
+                const unsigned char *p = reinterpret_cast<const unsigned char *>(buffer) + offset;
+                type = static_cast<int32_t>(fast_data_head::read_u32(p));
+                data_size = static_cast<size_t>(fast_data_head::read_u32(p + 4));
+                if (data_size > s - offset - ENTRY_HEAD_SIZE) {
+                    return 0;
+                }
+
+                data = data_size > 0 ? p + ENTRY_HEAD_SIZE : NULL;
+                return offset + ENTRY_HEAD_SIZE + data_size;
+            }
+
+            /**
+             * @brief 统计合并包里的数据条数，格式错误时只统计前面合法的部分
+             */
+            static inline size_t count(const void *buffer, size_t s) {
+                size_t ret = 0;
+                size_t offset = 0;
+                while (offset < s) {
+                    int32_t type = 0;
+                    const void *data = NULL;
+                    size_t data_size = 0;
+                    offset = next(buffer, s, offset, type, data, data_size);
+                    if (0 == offset) {
+                        break;
+                    }
+                    ++ret;
+                }
+
+                return ret;
+            }
+        };
+
+        /**
+         * @brief 接收消息的解包器，复用msgpack的zone和消息对象
+         * @note 稳态下解包不再分配内存，解出的bin和str数据直接引用输入缓冲区
+         * @note 返回的消息在下一次unpack或release前有效，输入缓冲区也需要保持有效
+         */
+        class msg_unpacker {
+        public:
+            msg_unpacker() {}
+
+            msg *unpack(const void *buffer, size_t s) {
+                release();
+
+                // 数据消息的定长二进制头不需要经过msgpack
+                if (fast_data_head::is_fast_data_head(buffer, s)) {
+                    return fast_data_head::unpack(msg_, buffer, s) ? &msg_ : NULL;
+                }
+
+                msgpack::object obj = msgpack::unpack(zone_, reinterpret_cast<const char *>(buffer), s, reference_buffer, NULL);
+                if (obj.is_nil()) {
+                    return NULL;
+                }
+
+                obj.convert(msg_);
+                return &msg_;
+            }
+
+            void release() {
+                msg_.reset();
+                zone_.clear();
+            }
+
+        private:
+            static bool reference_buffer(msgpack::type::object_type, size_t, void *) { return true; }
+
+            msg_unpacker(const msg_unpacker &);
+            msg_unpacker &operator=(const msg_unpacker &);
+
+        private:
+            msgpack::zone zone_;
+            msg msg_;
+        };
     }
 }
 
@@ -467,6 +1285,12 @@ namespace msgpack {
                             break;
                         }
 
+                        case ATBUS_CMD_NODE_CREDIT_REQ:
+                        case ATBUS_CMD_NODE_CREDIT_RSP: {
+                            body_obj.convert(*v.body.make_body(v.body.credit));
+                            break;
+                        }
+
                         default: { // invalid cmd
                             break;
                         }
@@ -547,6 +1371,16 @@ namespace msgpack {
                         break;
                     }
 
+                    case ATBUS_CMD_NODE_CREDIT_REQ:
+                    case ATBUS_CMD_NODE_CREDIT_RSP: {
+                        if (NULL == v.body.credit) {
+                            o.pack_nil();
+                        } else {
+                            o.pack(*v.body.credit);
+                        }
+                        break;
+                    }
+
                     default: { // invalid cmd
                         o.pack_nil();
                         break;
@@ -628,6 +1462,16 @@ namespace msgpack {
                         break;
                     }
 
+                    case ATBUS_CMD_NODE_CREDIT_REQ:
+                    case ATBUS_CMD_NODE_CREDIT_RSP: {
+                        if (NULL == v.body.credit) {
+                            o.via.map.ptr[1].val = msgpack::object();
+                        } else {
+                            v.body.credit->msgpack_object(&o.via.map.ptr[1].val, o.zone);
+                        }
+                        break;
+                    }
+
                     default: { // invalid cmd
                         o.via.map.ptr[1].val = msgpack::object();
                         break;
@@ -0,0 +1,37 @@
+#pragma once
+
+#ifndef LIBATBUS_DETAIL_LZ_CODEC_H_
+#define LIBATBUS_DETAIL_LZ_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace atbus {
+    namespace detail {
+        /**
+         * @brief 内置的LZ77类快速压缩算法(LZ4 block格式)，用于io_stream传输压缩
+         * @note 单次压缩的窗口为64KB，不依赖外部库
+         */
+        namespace lz {
+            /**
+             * @brief 获取压缩输出缓冲区的最大需求长度
+             */
+            size_t compress_bound(size_t in_len);
+
+            /**
+             * @brief 压缩数据
+             * @return 压缩后的长度，输出缓冲区不足时返回0
+             */
+            size_t compress(const void *in, size_t in_len, void *out, size_t out_len);
+
+            /**
+             * @brief 解压数据
+             * @param out_len 解压后的原始长度，必须和压缩前完全一致
+             * @return 0或错误码
+             */
+            int decompress(const void *in, size_t in_len, void *out, size_t out_len);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef LIBATBUS_DETAIL_RECV_DISPATCHER_H_
+#define LIBATBUS_DETAIL_RECV_DISPATCHER_H_
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "design_pattern/noncopyable.h"
+#include "lock/atomic_int_type.h"
+
+#include "detail/libatbus_config.h"
+#include "detail/libatbus_protocol.h"
+
+namespace atbus {
+    namespace detail {
+        struct recv_dispatcher_worker;
+
+        /**
+         * @brief 接收数据的分发线程池
+         * @note 同一个来源(key)的消息总是投递到同一个工作线程，以保证单个发送者的消息时序
+         * @note push/stop/get_pending 只能在IO线程调用，处理函数在工作线程中被调用
+         */
+        class recv_dispatcher : public util::design_pattern::noncopyable {
+        public:
+            struct job_t {
+                protocol::msg_head head;
+                int flags;
+                ATBUS_MACRO_BUSID_TYPE from;
+                ATBUS_MACRO_BUSID_TYPE to;
+                std::vector<unsigned char> data;
+                bool credit_only;      // 只用于在前面的消息处理完后归还流控窗口，不回调
+                uint32_t credit_count; // credit_only时归还的窗口数
+            };
+
+            typedef std::vector<std::pair<ATBUS_MACRO_BUSID_TYPE, uint32_t> > credit_list_t;
+
+            typedef void (*handle_fn_t)(void *priv_data, job_t &job);
+
+        public:
+            recv_dispatcher();
+            ~recv_dispatcher();
+
+            /**
+             * @brief 启动工作线程
+             * @param worker_number 工作线程数
+             * @param fn 处理函数
+             * @param priv_data 处理函数的私有数据
+             * @return 0或错误码
+             */
+            int start(size_t worker_number, handle_fn_t fn, void *priv_data);
+
+            /**
+             * @brief 处理完所有积压的消息并停止工作线程
+             */
+            void stop();
+
+            /**
+             * @brief 复制数据并投递到工作线程
+             * @param key 分发key(来源bus id)
+             * @param head 消息头
+             * @param flags 转发标记
+             * @param from 来源
+             * @param to 目标
+             * @param buffer 数据块地址
+             * @param s 数据块长度
+             * @return 0或错误码
+             */
+            int push(ATBUS_MACRO_BUSID_TYPE key, const protocol::msg_head &head, int flags, ATBUS_MACRO_BUSID_TYPE from,
+                     ATBUS_MACRO_BUSID_TYPE to, const void *buffer, size_t s);
+
+            /**
+             * @brief 投递一个流控窗口归还标记，同一个key之前投递的消息处理完后才会被取出
+             * @param key 分发key(来源bus id)
+             * @param count 归还的窗口数
+             * @return 0或错误码
+             */
+            int push_credit(ATBUS_MACRO_BUSID_TYPE key, uint32_t count);
+
+            /**
+             * @brief 取出已经可以归还的流控窗口，只能在IO线程调用
+             * @param out 导出来源bus id和归还的消息数
+             */
+            void pop_credits(credit_list_t &out);
+
+            /**
+             * @brief 获取已投递的消息数，不包含流控窗口归还标记
+             */
+            inline size_t get_pushed() const { return pushed_count_; }
+
+            inline bool is_running() const { return !workers_.empty(); }
+
+            inline size_t get_worker_number() const { return workers_.size(); }
+
+            /**
+             * @brief 获取已投递但未处理完成的消息数
+             */
+            size_t get_pending() const;
+
+            /**
+             * @brief 获取已处理完成的消息数
+             */
+            size_t get_completed() const;
+
+        private:
+            static void worker_main(recv_dispatcher *self, recv_dispatcher_worker *worker);
+
+        private:
+            handle_fn_t handle_fn_;
+            void *priv_data_;
+            std::vector<recv_dispatcher_worker *> workers_;
+            size_t pushed_count_;
+            util::lock::atomic_int_type<size_t> completed_count_;
+        };
+    }
+}
+
+#endif
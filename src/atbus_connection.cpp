@@ -346,6 +346,10 @@ namespace atbus {
         }
 
         state_ = state_t::DISCONNECTING;
+        if (NULL != owner_) {
+            owner_->invalidate_route_cache();
+        }
+
         if (NULL != conn_data_.free_fn) {
             if (NULL != owner_) {
                 int res = conn_data_.free_fn(*owner_, *this);
@@ -394,6 +398,70 @@ namespace atbus {
         return conn_data_.push_fn(*this, buffer, s);
     }
 
+    int connection::push_v(const void *const buffers[], const size_t sizes[], size_t count) {
+        size_t s = 0;
+        for (size_t i = 0; i < count; ++i) {
+            s += sizes[i];
+        }
+
+        ++stat_.push_start_times;
+        stat_.push_start_size += s;
+
+        if (state_t::CONNECTED != state_ && state_t::HANDSHAKING != state_) {
+            ++stat_.push_failed_times;
+            stat_.push_failed_size += s;
+
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        if (!is_push_v_supported()) {
+            ++stat_.push_failed_times;
+            stat_.push_failed_size += s;
+
+            return EN_ATBUS_ERR_NOT_SUPPORT;
+        }
+
+        int ret = channel::io_stream_send_v(conn_data_.shared.ios_fd.conn, buffers, sizes, count);
+        if (ret < 0) {
+            ++stat_.push_failed_times;
+            stat_.push_failed_size += s;
+        }
+        return ret;
+    }
+
+    int connection::push_shared(detail::shared_buffer *buf) {
+        if (NULL == buf) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        // 非io_stream通道需要复制到通道内存里
+        if (ios_push_fn != conn_data_.push_fn || NULL == conn_data_.shared.ios_fd.conn) {
+            return push(buf->data(), buf->size());
+        }
+
+        ++stat_.push_start_times;
+        stat_.push_start_size += buf->size();
+
+        if (state_t::CONNECTED != state_ && state_t::HANDSHAKING != state_) {
+            ++stat_.push_failed_times;
+            stat_.push_failed_size += buf->size();
+
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        int ret = channel::io_stream_send_shared(conn_data_.shared.ios_fd.conn, buf);
+        if (ret < 0) {
+            ++stat_.push_failed_times;
+            stat_.push_failed_size += buf->size();
+        }
+        return ret;
+    }
+
+    bool connection::is_push_v_supported() const {
+        // 压缩需要连续的数据，开启了压缩的连接仍然先合并再发送
+        return ios_push_fn == conn_data_.push_fn && NULL != conn_data_.shared.ios_fd.conn && NULL == conn_data_.shared.ios_fd.conn->codec;
+    }
+
     bool connection::is_connected() const { return state_t::CONNECTED == state_; }
 
     endpoint *connection::get_binding() { return binding_; }
@@ -512,15 +580,8 @@ namespace atbus {
         ++conn->stat_.pull_times;
         conn->stat_.pull_size += s;
 
-        // unpack
-        msgpack::unpacked result;
-        protocol::msg m;
-        if (false == unpack(&result, *conn, m, buffer, s)) {
-            return;
-        }
-
         if (NULL != _this) {
-            _this->on_recv(conn, &m, status, channel->error_code);
+            unpack_and_dispatch(*_this, *conn, buffer, s, status, channel->error_code);
         }
     }
 
@@ -604,14 +665,82 @@ namespace atbus {
         }
     }
 
+    void connection::iostream_on_congested(channel::io_stream_channel *channel, channel::io_stream_connection *conn_ios, int status,
+                                           void *buffer, size_t s) {
+        node *n = reinterpret_cast<node *>(channel->data);
+        connection *conn = reinterpret_cast<connection *>(conn_ios->data);
+        if (NULL == n || NULL == conn) {
+            return;
+        }
+
+        ATBUS_FUNC_NODE_DEBUG(*n, conn->get_binding(), conn, NULL, "send buffer of %p congested, pending %llu bytes", conn_ios,
+                              static_cast<unsigned long long>(s));
+        n->on_endpoint_congested(conn->get_binding(), conn, s);
+    }
+
+    void connection::iostream_on_drained(channel::io_stream_channel *channel, channel::io_stream_connection *conn_ios, int status,
+                                         void *buffer, size_t s) {
+        node *n = reinterpret_cast<node *>(channel->data);
+        connection *conn = reinterpret_cast<connection *>(conn_ios->data);
+        if (NULL == n || NULL == conn) {
+            return;
+        }
+
+        ATBUS_FUNC_NODE_DEBUG(*n, conn->get_binding(), conn, NULL, "send buffer of %p drained, pending %llu bytes", conn_ios,
+                              static_cast<unsigned long long>(s));
+        n->on_endpoint_drained(conn->get_binding(), conn, s);
+    }
+
+    int connection::set_compress_codec(uint32_t codec_id) {
+        if (ios_push_fn != conn_data_.push_fn || NULL == conn_data_.shared.ios_fd.conn) {
+            return 0 == codec_id ? EN_ATBUS_ERR_SUCCESS : EN_ATBUS_ERR_NOT_SUPPORT;
+        }
+
+        if (codec_id >= channel::io_stream_codec::EN_CT_MAX) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        return channel::io_stream_set_codec(conn_data_.shared.ios_fd.conn, static_cast<uint8_t>(codec_id));
+    }
+
+    uint32_t connection::get_compress_codec() const {
+        if (ios_push_fn != conn_data_.push_fn || NULL == conn_data_.shared.ios_fd.conn || NULL == conn_data_.shared.ios_fd.conn->codec) {
+            return 0;
+        }
+
+        return conn_data_.shared.ios_fd.conn->codec->id;
+    }
+
+    bool connection::is_trusted_transport() const {
+        if (ios_push_fn != conn_data_.push_fn || NULL == conn_data_.shared.ios_fd.conn) {
+            return false;
+        }
+
+        return channel::io_stream_is_trusted_transport(conn_data_.shared.ios_fd.conn);
+    }
+
+    int connection::set_skip_checksum(bool skip) {
+        if (ios_push_fn != conn_data_.push_fn || NULL == conn_data_.shared.ios_fd.conn) {
+            return skip ? EN_ATBUS_ERR_NOT_SUPPORT : EN_ATBUS_ERR_SUCCESS;
+        }
+
+        return channel::io_stream_set_skip_checksum(conn_data_.shared.ios_fd.conn, skip);
+    }
+
     int connection::shm_proc_fn(node &n, connection &conn, time_t sec, time_t usec) {
         int ret = 0;
-        size_t left_times = n.get_conf().loop_times;
+        size_t left_times = static_cast<size_t>(n.get_recv_loop_times());
         detail::buffer_block *static_buffer = n.get_temp_static_buffer();
         if (NULL == static_buffer) {
             return ATBUS_FUNC_NODE_ERROR(n, NULL, &conn, EN_ATBUS_ERR_NOT_INITED, 0);
         }
 
+        // 收到的消息直接引用接收缓冲区，回调中再次调用proc时不能覆盖，留到下一次proc再拉取
+        node::flag_guard_t static_buffer_guard(&n, node::flag_t::EN_FT_RECV_STATIC_BUF);
+        if (!static_buffer_guard) {
+            return 0;
+        }
+
         while (left_times-- > 0) {
             size_t recv_len;
             int res = channel::shm_recv(conn.conn_data_.shared.shm.channel, static_buffer->data(), static_buffer->size(), &recv_len);
@@ -630,15 +759,9 @@ namespace atbus {
                 ++conn.stat_.pull_times;
                 conn.stat_.pull_size += recv_len;
 
-                // unpack
-                msgpack::unpacked result;
-                protocol::msg m;
-                if (false == unpack(&result, conn, m, static_buffer->data(), recv_len)) {
-                    continue;
+                if (unpack_and_dispatch(n, conn, static_buffer->data(), recv_len, res, res)) {
+                    ++ret;
                 }
-
-                n.on_recv(&conn, &m, res, res);
-                ++ret;
             }
         }
 
@@ -662,12 +785,18 @@ namespace atbus {
 
     int connection::mem_proc_fn(node &n, connection &conn, time_t sec, time_t usec) {
         int ret = 0;
-        size_t left_times = n.get_conf().loop_times;
+        size_t left_times = static_cast<size_t>(n.get_recv_loop_times());
         detail::buffer_block *static_buffer = n.get_temp_static_buffer();
         if (NULL == static_buffer) {
             return ATBUS_FUNC_NODE_ERROR(n, NULL, &conn, EN_ATBUS_ERR_NOT_INITED, 0);
         }
 
+        // 同shm_proc_fn，回调中再次调用proc时不拉取
+        node::flag_guard_t static_buffer_guard(&n, node::flag_t::EN_FT_RECV_STATIC_BUF);
+        if (!static_buffer_guard) {
+            return 0;
+        }
+
         while (left_times-- > 0) {
             size_t recv_len;
             int res = channel::mem_recv(conn.conn_data_.shared.mem.channel, static_buffer->data(), static_buffer->size(), &recv_len);
@@ -686,15 +815,9 @@ namespace atbus {
                 ++conn.stat_.pull_times;
                 conn.stat_.pull_size += recv_len;
 
-                // unpack
-                msgpack::unpacked result;
-                protocol::msg m;
-                if (false == unpack(&result, conn, m, static_buffer->data(), recv_len)) {
-                    continue;
+                if (unpack_and_dispatch(n, conn, static_buffer->data(), recv_len, res, res)) {
+                    ++ret;
                 }
-
-                n.on_recv(&conn, &m, res, res);
-                ++ret;
             }
         }
 
@@ -733,6 +856,15 @@ namespace atbus {
     }
 
     bool connection::unpack(void *res, connection &conn, atbus::protocol::msg &m, void *buffer, size_t s) {
+        if (protocol::fast_data_head::is_fast_data_head(buffer, s)) {
+            if (false == protocol::fast_data_head::unpack(m, buffer, s)) {
+                ATBUS_FUNC_NODE_ERROR(*conn.owner_, conn.binding_, &conn, EN_ATBUS_ERR_UNPACK, EN_ATBUS_ERR_UNPACK);
+                return false;
+            }
+
+            return true;
+        }
+
         msgpack::unpacked *result = reinterpret_cast<msgpack::unpacked *>(res);
         msgpack::unpack(*result, reinterpret_cast<const char *>(buffer), s);
         msgpack::object obj = result->get();
@@ -744,4 +876,39 @@ namespace atbus {
         obj.convert(m);
         return true;
     }
+
+    bool connection::unpack_and_dispatch(node &n, connection &conn, void *buffer, size_t s, int status, int errcode) {
+        // 定长头的数据消息只是中转时，直接在接收缓冲区上检查to和router后转发，不需要解包
+        if (status >= 0 && errcode >= 0 && protocol::fast_data_head::is_fast_data_head(buffer, s)) {
+            protocol::fast_data_view view(buffer, s);
+            if (n.forward_fast_data(conn, view)) {
+                return true;
+            }
+        }
+
+        // 优先复用节点的解包器，避免每条消息都重新分配zone和消息体
+        // 回调中再次收包(比如在回调里调用了proc)时解包器正在使用，这时退化为临时对象
+        node::flag_guard_t unpack_guard(&n, node::flag_t::EN_FT_UNPACKING_MSG);
+        if (unpack_guard) {
+            protocol::msg_unpacker &unpacker = n.get_recv_msg_unpacker();
+            protocol::msg *m = unpacker.unpack(buffer, s);
+            if (NULL == m) {
+                ATBUS_FUNC_NODE_ERROR(n, conn.binding_, &conn, EN_ATBUS_ERR_UNPACK, EN_ATBUS_ERR_UNPACK);
+                return false;
+            }
+
+            n.on_recv(&conn, m, status, errcode);
+            unpacker.release();
+            return true;
+        }
+
+        msgpack::unpacked result;
+        protocol::msg m;
+        if (false == unpack(&result, conn, m, buffer, s)) {
+            return false;
+        }
+
+        n.on_recv(&conn, &m, status, errcode);
+        return true;
+    }
 }
@@ -36,7 +36,7 @@ namespace atbus {
         return ret;
     }
 
-    endpoint::endpoint() : id_(0), children_mask_(0), pid_(0), owner_(NULL) { flags_.reset(); }
+    endpoint::endpoint() : id_(0), children_mask_(0), pid_(0), owner_(NULL), protocol_version_(0), capabilities_(0) { flags_.reset(); }
 
     endpoint::~endpoint() {
         flags_.set(flag_t::DESTRUCTING, true);
@@ -67,11 +67,15 @@ namespace atbus {
         data_conn_.clear();
 
         flags_.reset();
+        flow_ = flow_t();
+        protocol_version_ = 0;
+        capabilities_ = 0;
         // 只要endpoint存在，则它一定存在于owner_的某个位置。
         // 并且这个值只能在创建时指定，所以不能重置这个值
 
         // 所有的endpoint的reset行为都要加入到检测和释放列表
         if (NULL != owner_) {
+            owner_->invalidate_route_cache();
             owner_->add_check_list(tmp_holder);
         }
     }
@@ -145,6 +149,11 @@ namespace atbus {
         if (connection::state_t::HANDSHAKING == conn->get_status()) {
             conn->state_ = connection::state_t::CONNECTED;
         }
+
+        // 新连接可能比缓存中的连接更优
+        if (NULL != owner_) {
+            owner_->invalidate_route_cache();
+        }
         return true;
     }
 
@@ -187,6 +196,9 @@ namespace atbus {
             if ((*iter).get() == conn) {
                 conn->binding_ = NULL;
                 data_conn_.erase(iter);
+                if (NULL != owner_) {
+                    owner_->invalidate_route_cache();
+                }
 
                 // 数据节点全部离线也直接下线
                 // 内存和共享内存通道不会被动下线
@@ -331,6 +343,36 @@ namespace atbus {
 
     time_t endpoint::get_stat_last_pong() const { return stat_.last_pong_time; }
 
+    endpoint::flow_t::flow_t() : enabled(false), blocked(false), peer_blocked(false), credits(0), consumed(0) {}
+
+    void endpoint::add_flow_credits(uint32_t credits, bool reset) {
+        flow_.enabled = true;
+        if (reset) {
+            flow_.credits = credits;
+        } else {
+            flow_.credits += credits;
+        }
+    }
+
+    bool endpoint::take_flow_credit(uint32_t count) {
+        if (!flow_.enabled) {
+            return true;
+        }
+
+        if (flow_.credits < count) {
+            return false;
+        }
+
+        flow_.credits -= count;
+        return true;
+    }
+
+    uint32_t endpoint::pop_flow_consumed() {
+        uint32_t ret = flow_.consumed;
+        flow_.consumed = 0;
+        return ret;
+    }
+
     size_t endpoint::get_stat_push_start_times() const {
         size_t ret = 0;
         for (std::list<connection::ptr_t>::const_iterator iter = data_conn_.begin(); iter != data_conn_.end(); ++iter) {
@@ -1,4 +1,6 @@
-﻿#include <sstream>
+﻿#include <algorithm>
+#include <sstream>
+#include <vector>
 
 #include "common/string_oprs.h"
 
@@ -30,6 +32,8 @@ namespace atbus {
                 ATBUS_CMD_REG_NAME(ATBUS_CMD_NODE_CONN_SYN);
                 ATBUS_CMD_REG_NAME(ATBUS_CMD_NODE_PING);
                 ATBUS_CMD_REG_NAME(ATBUS_CMD_NODE_PONG);
+                ATBUS_CMD_REG_NAME(ATBUS_CMD_NODE_CREDIT_REQ);
+                ATBUS_CMD_REG_NAME(ATBUS_CMD_NODE_CREDIT_RSP);
 
                 for (int i = 0; i < ATBUS_CMD_MAX; ++i) {
                     if (fn_names[i].empty()) {
@@ -50,6 +54,246 @@ namespace atbus {
 
             return fn_names[cmd].c_str();
         }
+
+        // 本节点可以解压并且开启了压缩的算法，0表示不启用
+        static uint32_t get_local_compress_codec(const node &n) {
+            uint32_t codec_id = n.get_conf().compress_codec;
+            if (0 == codec_id || codec_id >= channel::io_stream_codec::EN_CT_MAX ||
+                NULL == channel::io_stream_get_codec(static_cast<uint8_t>(codec_id))) {
+                return 0;
+            }
+
+            return codec_id;
+        }
+
+        // 本节点在这个连接上可以接收的帧格式选项
+        static uint32_t get_local_stream_flags(const node &n, const connection &conn) {
+            uint32_t ret = 0;
+            if (n.get_conf().flags.test(node::conf_flag_t::EN_CONF_SKIP_TRUSTED_CHECKSUM) && conn.is_trusted_transport()) {
+                ret |= protocol::reg_data::EN_SF_SKIP_CHECKSUM;
+            }
+
+            return ret;
+        }
+
+        // 本节点支持的能力
+        static uint32_t get_local_capabilities(const node &n) {
+            uint32_t ret = protocol::reg_data::EN_CAP_BOUNDED_ROUTER | protocol::reg_data::EN_CAP_FLOW_CREDIT |
+                           protocol::reg_data::EN_CAP_BATCH_DATA | protocol::reg_data::EN_CAP_MULTICAST |
+                           protocol::reg_data::EN_CAP_BROADCAST;
+            if (n.get_conf().flags.test(node::conf_flag_t::EN_CONF_FAST_DATA_HEAD)) {
+                ret |= protocol::reg_data::EN_CAP_FAST_DATA_HEAD;
+            }
+
+            return ret;
+        }
+
+        // 双方都支持的能力，老版本的对端只能从endpoint的flags里推断
+        static uint32_t get_common_capabilities(const node &n, const protocol::reg_data &reg) {
+            uint32_t peer_caps = reg.capabilities;
+            if (0 == reg.protocol_version) {
+                peer_caps = 0;
+                std::bitset<endpoint::flag_t::MAX> reg_flags(reg.flags);
+                if (reg_flags.test(endpoint::flag_t::FAST_DATA_HEAD)) {
+                    peer_caps |= protocol::reg_data::EN_CAP_FAST_DATA_HEAD;
+                }
+            }
+
+            return get_local_capabilities(n) & peer_caps;
+        }
+
+        // 嵌套发送时借用节点的打包缓冲区，离开作用域时归还
+        struct nested_pack_buffer_guard_t {
+            node &owner;
+            detail::buffer_block *block;
+
+            nested_pack_buffer_guard_t(node &n, bool nested) : owner(n), block(nested ? n.alloc_nested_pack_buffer() : NULL) {}
+            ~nested_pack_buffer_guard_t() {
+                if (NULL != block) {
+                    owner.free_nested_pack_buffer(block);
+                }
+            }
+        };
+
+        // 消息处理完以后记录流控窗口，处理过程中端点可能被移除，所以只保存ID
+        struct flow_consumed_guard_t {
+            node &owner;
+            node::bus_id_t ep_id;
+            size_t dispatch_pushed;
+            uint32_t count; // 合并包按数据条数归还
+            bool enabled;
+
+            flow_consumed_guard_t(node &n, const endpoint *ep)
+                : owner(n), ep_id(NULL == ep ? 0 : ep->get_id()), dispatch_pushed(n.get_dispatch_pushed()), count(1), enabled(NULL != ep) {}
+            ~flow_consumed_guard_t() {
+                if (enabled) {
+                    owner.on_flow_consumed(ep_id, dispatch_pushed, count);
+                }
+            }
+        };
+
+        // 拆开合并发送的数据，逐条回调，回调时的消息和单独发送的一样
+        static int dispatch_batch_data(node &n, connection *conn, protocol::msg &m) {
+            const void *batch_ptr = m.body.forward->content.ptr;
+            size_t batch_size = m.body.forward->content.size;
+            m.body.forward->unset_flag(protocol::forward_data::FLAG_BATCH);
+
+            size_t offset = 0;
+            while (offset < batch_size) {
+                int32_t type = 0;
+                const void *data = NULL;
+                size_t data_size = 0;
+                size_t next = protocol::batch_data::next(batch_ptr, batch_size, offset, type, data, data_size);
+                if (0 == next) {
+                    ATBUS_FUNC_NODE_ERROR(n, conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
+                    return EN_ATBUS_ERR_BAD_DATA;
+                }
+
+                m.head.type = type;
+                m.body.forward->content.ptr = data;
+                m.body.forward->content.size = data_size;
+                n.on_recv_data(conn->get_binding(), conn, m, data, data_size);
+                offset = next;
+            }
+
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        // 多目标的数据消息，发给自己的直接回调，其他目标按本节点的路由拆分后继续转发
+        static int dispatch_multicast_data(node &n, connection *conn, protocol::msg &m) {
+            std::vector<node::bus_id_t> targets;
+            targets.swap(m.body.forward->targets);
+            m.body.forward->unset_flag(protocol::forward_data::FLAG_MULTICAST);
+
+            size_t targets_size = targets.size();
+            targets.erase(std::remove(targets.begin(), targets.end(), n.get_id()), targets.end());
+            if (targets.size() != targets_size) {
+                m.body.forward->to = n.get_id();
+                n.on_recv_data(conn->get_binding(), conn, m, m.body.forward->content.ptr, m.body.forward->content.size);
+            }
+
+            if (targets.empty()) {
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            if (m.body.forward->get_hop_count() >= static_cast<size_t>(n.get_conf().ttl)) {
+                return msg_handler::send_transfer_rsp(n, m, EN_ATBUS_ERR_ATNODE_TTL);
+            }
+
+            int res = n.send_data_multi_msg(&targets[0], targets.size(), m);
+            if (res < 0) {
+                // 失败的通知里带上这一跳负责的目标列表
+                m.body.forward->targets.swap(targets);
+                res = msg_handler::send_transfer_rsp(n, m, res);
+            }
+
+            return res;
+        }
+
+        // 跨子树直连的地址请求和回复，不是发给自己的按目标ID逐跳转发
+        static int dispatch_peer_conn_syn(node &n, protocol::msg &m) {
+            protocol::conn_data &syn = *m.body.conn;
+            if (syn.to != n.get_id()) {
+                // 和数据转发一样受ttl限制，防止路由出错时在节点间循环转发
+                if (syn.hop_count >= static_cast<uint32_t>(n.get_conf().ttl)) {
+                    return EN_ATBUS_ERR_ATNODE_TTL;
+                }
+
+                ++syn.hop_count;
+                return n.send_ctrl_msg(syn.to, m);
+            }
+
+            // 本节点未开启直连则不回复，请求方超时后会重试
+            if (0 == n.get_conf().peer_connect_threshold) {
+                ATBUS_FUNC_NODE_DEBUG(n, NULL, NULL, &m, "node recv peer conn_syn but peer connection is disabled");
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            // 请求包，回复自己的监听地址
+            if (syn.channels.empty()) {
+                return msg_handler::send_peer_conn_syn(n, syn.from, n.get_self_endpoint());
+            }
+
+            // 回复包，已经建立了直连则忽略
+            if (NULL != n.get_endpoint(syn.from)) {
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            // 握手只能使用io_stream通道，同一台机器上优先使用unix socket
+            // 注册时会再按机器名和进程号建立共享内存的数据通道
+            bool share_host = syn.hostname == n.get_hostname();
+            const std::string *addr = NULL;
+            for (size_t i = 0; i < syn.channels.size(); ++i) {
+                const std::string &chan = syn.channels[i].address;
+                if (0 == UTIL_STRFUNC_STRNCASE_CMP("mem:", chan.c_str(), 4) || 0 == UTIL_STRFUNC_STRNCASE_CMP("shm:", chan.c_str(), 4)) {
+                    continue;
+                }
+
+                if (0 == UTIL_STRFUNC_STRNCASE_CMP("unix:", chan.c_str(), 5)) {
+                    if (share_host) {
+                        addr = &chan;
+                        break;
+                    }
+                    continue;
+                }
+
+                if (NULL == addr) {
+                    addr = &chan;
+                }
+            }
+
+            if (NULL == addr) {
+                return EN_ATBUS_ERR_NO_LISTEN;
+            }
+
+            ATBUS_FUNC_NODE_DEBUG(n, NULL, NULL, &m, "node recv peer conn_syn and prepare connect to %s", addr->c_str());
+            return n.connect(addr->c_str());
+        }
+
+        // 广播的数据消息，本节点在目标范围内时回调，再转发给范围内的下一跳
+        static int dispatch_broadcast_data(node &n, connection *conn, protocol::msg &m) {
+            node::bus_id_t prev_hop = m.head.src_bus_id;
+            const protocol::forward_data &fwd = *m.body.forward;
+            if (n.get_id() >= endpoint::get_children_min_id(fwd.to, fwd.to_mask) &&
+                n.get_id() <= endpoint::get_children_max_id(fwd.to, fwd.to_mask)) {
+                n.on_recv_data(conn->get_binding(), conn, m, fwd.content.ptr, fwd.content.size);
+            }
+
+            int res = n.forward_broadcast_msg(m, prev_hop);
+            if (res < 0) {
+                res = msg_handler::send_transfer_rsp(n, m, res);
+            }
+
+            return res;
+        }
+
+        // 根据对端注册信息设置发送时的压缩算法和帧格式，双方都开启了才生效
+        static void setup_stream_options(node &n, connection &conn, const protocol::reg_data &reg) {
+            uint32_t codec_id = 0;
+            if (0 != get_local_compress_codec(n) && 0 != reg.compress_codec && reg.compress_codec < channel::io_stream_codec::EN_CT_MAX &&
+                NULL != channel::io_stream_get_codec(static_cast<uint8_t>(reg.compress_codec))) {
+                codec_id = reg.compress_codec;
+            }
+
+            int res = conn.set_compress_codec(codec_id);
+            if (res < 0) {
+                ATBUS_FUNC_NODE_ERROR(n, conn.get_binding(), &conn, res, 0);
+            }
+
+            bool skip_checksum = 0 != (get_local_stream_flags(n, conn) & reg.stream_flags & protocol::reg_data::EN_SF_SKIP_CHECKSUM);
+            res = conn.set_skip_checksum(skip_checksum);
+            if (res < 0) {
+                ATBUS_FUNC_NODE_ERROR(n, conn.get_binding(), &conn, res, 0);
+            }
+
+            // 能力和数据消息的格式按端点记录，内存和共享内存通道是单工的，只能使用控制连接上协商的结果
+            endpoint *ep = conn.get_binding();
+            if (NULL != ep) {
+                uint32_t caps = get_common_capabilities(n, reg);
+                ep->set_capabilities(reg.protocol_version, caps);
+                ep->set_flag(endpoint::flag_t::FAST_DATA_HEAD, 0 != (caps & protocol::reg_data::EN_CAP_FAST_DATA_HEAD));
+            }
+        }
     }
 
     int msg_handler::dispatch_msg(node &n, connection *conn, protocol::msg *m, int status, int errcode) {
@@ -67,6 +311,8 @@ namespace atbus {
             fns[ATBUS_CMD_NODE_CONN_SYN] = msg_handler::on_recv_node_conn_syn;
             fns[ATBUS_CMD_NODE_PING] = msg_handler::on_recv_node_ping;
             fns[ATBUS_CMD_NODE_PONG] = msg_handler::on_recv_node_pong;
+            fns[ATBUS_CMD_NODE_CREDIT_REQ] = msg_handler::on_recv_node_credit_req;
+            fns[ATBUS_CMD_NODE_CREDIT_RSP] = msg_handler::on_recv_node_credit_rsp;
         }
 
         if (NULL == m) {
@@ -126,10 +372,69 @@ namespace atbus {
 
         reg->children_id_mask = n.get_self_endpoint()->get_children_mask();
         reg->flags = n.get_self_endpoint()->get_flags();
+        reg->compress_codec = detail::get_local_compress_codec(n);
+        reg->stream_flags = detail::get_local_stream_flags(n, conn);
+        reg->protocol_version = protocol::reg_data::PROTOCOL_VERSION;
+        reg->capabilities = detail::get_local_capabilities(n);
+
+        return send_msg(n, conn, m);
+    }
+
+    int msg_handler::send_node_sync(int32_t msg_id, node &n, connection &conn, protocol::node_tree *tree) {
+        if (msg_id != ATBUS_CMD_NODE_SYNC_REQ && msg_id != ATBUS_CMD_NODE_SYNC_RSP) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        protocol::msg m;
+        m.init(n.get_id(), static_cast<ATBUS_PROTOCOL_CMD>(msg_id), 0, 0, n.alloc_msg_seq());
+
+        // 请求包没有包体
+        if (ATBUS_CMD_NODE_SYNC_RSP == msg_id) {
+            protocol::node_tree *body = m.body.make_body(m.body.sync);
+            if (NULL == body) {
+                return EN_ATBUS_ERR_MALLOC;
+            }
+
+            if (NULL != tree) {
+                body->nodes.swap(tree->nodes);
+                body->full = tree->full;
+            }
+        }
 
         return send_msg(n, conn, m);
     }
 
+    int msg_handler::send_peer_conn_syn(node &n, ATBUS_MACRO_BUSID_TYPE to, const endpoint *addr_ep) {
+        // 没有监听地址的节点不能被直连，回复包的地址列表也不能为空
+        if (NULL != addr_ep && addr_ep->get_listen().empty()) {
+            return EN_ATBUS_ERR_NO_LISTEN;
+        }
+
+        protocol::msg m;
+        m.init(n.get_id(), ATBUS_CMD_NODE_CONN_SYN, 0, 0, n.alloc_msg_seq());
+
+        protocol::conn_data *syn = m.body.make_body(m.body.conn);
+        if (NULL == syn) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        syn->to = to;
+        if (NULL == addr_ep) {
+            syn->from = n.get_id();
+        } else {
+            syn->from = addr_ep->get_id();
+            syn->hostname = addr_ep->get_hostname();
+
+            const std::list<std::string> &listen_addrs = addr_ep->get_listen();
+            for (std::list<std::string>::const_iterator iter = listen_addrs.begin(); iter != listen_addrs.end(); ++iter) {
+                syn->channels.push_back(protocol::channel_data());
+                syn->channels.back().address = *iter;
+            }
+        }
+
+        return n.send_ctrl_msg(to, m);
+    }
+
     int msg_handler::send_transfer_rsp(node &n, protocol::msg &m, int32_t ret_code) {
         m.init(n.get_id(), ATBUS_CMD_DATA_TRANSFORM_RSP, 0, ret_code, m.head.sequence);
         m.body.forward->to = m.body.forward->from;
@@ -138,21 +443,132 @@ namespace atbus {
         return n.send_ctrl_msg(m.body.forward->to, m);
     }
 
+    int msg_handler::send_credit(int32_t msg_id, node &n, connection &conn, uint32_t credits, bool reset) {
+        if (msg_id != ATBUS_CMD_NODE_CREDIT_REQ && msg_id != ATBUS_CMD_NODE_CREDIT_RSP) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        protocol::msg m;
+        m.init(n.get_id(), static_cast<ATBUS_PROTOCOL_CMD>(msg_id), 0, 0, n.alloc_msg_seq());
+
+        protocol::credit_data *credit = m.body.make_body(m.body.credit);
+        if (NULL == credit) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        credit->credits = credits;
+        credit->reset = reset;
+
+        return send_msg(n, conn, m);
+    }
+
+    int msg_handler::add_flow_consumed(node &n, endpoint &ep, uint32_t count) {
+        uint32_t consumed = ep.add_flow_consumed(count);
+        if (false == ep.check_flow_peer_blocked() && consumed * 2 < n.get_conf().flow_credit_window) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        connection *ctrl_conn = n.get_self_endpoint()->get_ctrl_connection(&ep);
+        if (NULL == ctrl_conn) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        ep.set_flow_peer_blocked(false);
+        int res = send_credit(ATBUS_CMD_NODE_CREDIT_RSP, n, *ctrl_conn, ep.pop_flow_consumed(), false);
+        if (res < 0) {
+            ATBUS_FUNC_NODE_ERROR(n, &ep, ctrl_conn, res, 0);
+        }
+        return res;
+    }
+
     int msg_handler::send_msg(node &n, connection &conn, const protocol::msg &m) {
-        std::stringstream ss;
-        msgpack::pack(ss, m);
-        std::string packed_buffer = ss.str();
+        size_t msg_size = n.get_conf().msg_size;
+
+        // 直接打包到节点的打包缓冲区，超出msg_size时不再写入
+        // 在push的回调中再次发送时缓冲区正在使用，这时使用节点上复用的嵌套打包缓冲区
+        node::flag_guard_t pack_guard(&n, node::flag_t::EN_FT_PACKING_MSG);
+        detail::nested_pack_buffer_guard_t nested_guard(n, !pack_guard);
+        detail::buffer_block *pack_buffer = pack_guard ? n.get_temp_pack_buffer() : nested_guard.block;
+        if (NULL == pack_buffer || pack_buffer->size() < msg_size) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+        void *pack_data = pack_buffer->data();
+
+        // 对端支持时数据消息使用定长二进制头
+        const endpoint *peer_ep = conn.get_binding();
+        bool use_fast_head =
+            NULL != peer_ep && peer_ep->get_flag(endpoint::flag_t::FAST_DATA_HEAD) && protocol::fast_data_head::is_supported(m);
+
+        if (use_fast_head && conn.is_push_v_supported()) {
+            // 只重新生成消息头，数据段直接从来源缓冲区(发送的数据或转发时的接收缓冲区)复制到连接的发送缓冲区
+            size_t head_size = protocol::fast_data_head::pack_head(m, pack_data, msg_size);
+            size_t content_size = m.body.forward->content.size;
+            if (0 == head_size || head_size + content_size >= msg_size) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            ATBUS_FUNC_NODE_DEBUG(n, conn.get_binding(), &conn, &m, "node send msg(cmd=%s, type=%d, sequence=%u, ret=%d, length=%llu)",
+                                  detail::get_cmd_name(m.head.cmd), m.head.type, m.head.sequence, m.head.ret,
+                                  static_cast<unsigned long long>(head_size + content_size));
 
-        if (packed_buffer.size() >= n.get_conf().msg_size) {
-            return EN_ATBUS_ERR_BUFF_LIMIT;
+            const void *bufs[2] = {pack_data, m.body.forward->content.ptr};
+            size_t lens[2] = {head_size, content_size};
+            return conn.push_v(bufs, lens, 2);
+        }
+
+        size_t packed_size;
+        if (use_fast_head) {
+            packed_size = protocol::fast_data_head::pack(m, pack_data, msg_size);
+            if (0 == packed_size || packed_size >= msg_size) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+        } else {
+            detail::fixed_buffer_stream packed_stream(pack_data, msg_size);
+            msgpack::pack(packed_stream, m);
+
+            if (packed_stream.overflow() || packed_stream.size() >= msg_size) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+            packed_size = packed_stream.size();
         }
 
         ATBUS_FUNC_NODE_DEBUG(n, conn.get_binding(), &conn, &m, "node send msg(cmd=%s, type=%d, sequence=%u, ret=%d, length=%llu)",
                               detail::get_cmd_name(m.head.cmd), m.head.type, m.head.sequence, m.head.ret,
-                              static_cast<unsigned long long>(packed_buffer.size()));
+                              static_cast<unsigned long long>(packed_size));
+
+        return conn.push(pack_data, packed_size);
+    }
+
+    int msg_handler::send_msg_shared(node &n, connection &conn, const protocol::msg &m, detail::shared_buffer_ptr &packed) {
+        if (!packed) {
+            size_t msg_size = n.get_conf().msg_size;
+
+            node::flag_guard_t pack_guard(&n, node::flag_t::EN_FT_PACKING_MSG);
+            detail::nested_pack_buffer_guard_t nested_guard(n, !pack_guard);
+            detail::buffer_block *pack_buffer = pack_guard ? n.get_temp_pack_buffer() : nested_guard.block;
+            if (NULL == pack_buffer || pack_buffer->size() < msg_size) {
+                return EN_ATBUS_ERR_MALLOC;
+            }
+
+            detail::fixed_buffer_stream packed_stream(pack_buffer->data(), msg_size);
+            msgpack::pack(packed_stream, m);
+            if (packed_stream.overflow() || packed_stream.size() >= msg_size) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            const void *bufs[1] = {packed_stream.data()};
+            size_t lens[1] = {packed_stream.size()};
+            packed.reset(detail::shared_buffer::create(bufs, lens, 1));
+            if (!packed) {
+                return EN_ATBUS_ERR_MALLOC;
+            }
+        }
+
+        ATBUS_FUNC_NODE_DEBUG(n, conn.get_binding(), &conn, &m, "node send shared msg(cmd=%s, type=%d, sequence=%u, ret=%d, length=%llu)",
+                              detail::get_cmd_name(m.head.cmd), m.head.type, m.head.sequence, m.head.ret,
+                              static_cast<unsigned long long>(packed->size()));
 
-        return conn.push(packed_buffer.data(), packed_buffer.size());
-        ;
+        return conn.push_shared(packed.get());
     }
 
     int msg_handler::on_recv_data_transfer_req(node &n, connection *conn, protocol::msg &m, int status, int errcode) {
@@ -161,9 +577,43 @@ namespace atbus {
             return EN_ATBUS_ERR_BAD_DATA;
         }
 
+        // 流控窗口按直连的端点统计，和发送方一样只计算对端自己发起的消息
+        // 消息处理完(包括转发和分发线程中的回调)后才归还
+        endpoint *from_ep = conn->get_binding();
+        detail::flow_consumed_guard_t flow_guard(n, (n.get_conf().flow_credit_window > 0 && NULL != from_ep &&
+                                                     from_ep->check_capability(protocol::reg_data::EN_CAP_FLOW_CREDIT) &&
+                                                     m.body.forward->from == from_ep->get_id())
+                                                        ? from_ep
+                                                        : NULL);
+
+        if (m.body.forward->check_flag(atbus::protocol::forward_data::FLAG_MULTICAST)) {
+            int res = detail::dispatch_multicast_data(n, conn, m);
+            if (res < 0) {
+                ATBUS_FUNC_NODE_ERROR(n, NULL, NULL, res, 0);
+            }
+            return res;
+        }
+
+        if (m.body.forward->check_flag(atbus::protocol::forward_data::FLAG_BROADCAST)) {
+            int res = detail::dispatch_broadcast_data(n, conn, m);
+            if (res < 0) {
+                ATBUS_FUNC_NODE_ERROR(n, NULL, NULL, res, 0);
+            }
+            return res;
+        }
+
         if (m.body.forward->to == n.get_id()) {
             ATBUS_FUNC_NODE_DEBUG(n, (NULL == conn ? NULL : conn->get_binding()), conn, &m, "node recv data length = %lld",
                                   static_cast<unsigned long long>(m.body.forward->content.size));
+            if (m.body.forward->check_flag(atbus::protocol::forward_data::FLAG_BATCH)) {
+                // 发送方按数据条数占用窗口，这里也按条数归还
+                size_t entry_count = protocol::batch_data::count(m.body.forward->content.ptr, m.body.forward->content.size);
+                if (entry_count > 1) {
+                    flow_guard.count = static_cast<uint32_t>(entry_count);
+                }
+                return detail::dispatch_batch_data(n, conn, m);
+            }
+
             n.on_recv_data(conn->get_binding(), conn, m, m.body.forward->content.ptr, m.body.forward->content.size);
 
             if (m.body.forward->check_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP)) {
@@ -172,7 +622,7 @@ namespace atbus {
             return EN_ATBUS_ERR_SUCCESS;
         }
 
-        if (m.body.forward->router.size() >= static_cast<size_t>(n.get_conf().ttl)) {
+        if (m.body.forward->get_hop_count() >= static_cast<size_t>(n.get_conf().ttl)) {
             return send_transfer_rsp(n, m, EN_ATBUS_ERR_ATNODE_TTL);
         }
 
@@ -263,11 +713,22 @@ namespace atbus {
     }
 
     int msg_handler::on_recv_node_sync_req(node &n, connection *conn, protocol::msg &, int status, int errcode) {
-        return EN_ATBUS_ERR_SUCCESS;
+        // 只接受直连节点的请求
+        if (NULL == conn || NULL == conn->get_binding()) {
+            ATBUS_FUNC_NODE_ERROR(n, NULL, conn, EN_ATBUS_ERR_BAD_DATA, 0);
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        return n.on_node_sync_req(conn->get_binding());
     }
 
-    int msg_handler::on_recv_node_sync_rsp(node &n, connection *conn, protocol::msg &, int status, int errcode) {
-        return EN_ATBUS_ERR_SUCCESS;
+    int msg_handler::on_recv_node_sync_rsp(node &n, connection *conn, protocol::msg &m, int status, int errcode) {
+        if (NULL == m.body.sync || NULL == conn || NULL == conn->get_binding()) {
+            ATBUS_FUNC_NODE_ERROR(n, NULL == conn ? NULL : conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        return n.on_node_sync_rsp(conn->get_binding(), *m.body.sync);
     }
 
     int msg_handler::on_recv_node_reg_req(node &n, connection *conn, protocol::msg &m, int status, int errcode) {
@@ -428,6 +889,18 @@ namespace atbus {
             if (rsp_code < 0) {
                 ATBUS_FUNC_NODE_ERROR(n, ep, conn, ret, errcode);
                 conn->disconnect();
+                return ret;
+            }
+
+            detail::setup_stream_options(n, *conn, *m.body.reg);
+
+            if (NULL != ep && n.get_conf().flow_credit_window > 0 && ep->check_capability(protocol::reg_data::EN_CAP_FLOW_CREDIT)) {
+                // 授予对端初始的流控窗口
+                ep->pop_flow_consumed();
+                int res = send_credit(ATBUS_CMD_NODE_CREDIT_RSP, n, *conn, n.get_conf().flow_credit_window, true);
+                if (res < 0) {
+                    ATBUS_FUNC_NODE_ERROR(n, ep, conn, res, 0);
+                }
             }
 
             return ret;
@@ -465,7 +938,22 @@ namespace atbus {
 
             conn->disconnect();
             return m.head.ret;
-        } else if (node::state_t::CONNECTING_PARENT == n.get_state()) {
+        }
+
+        if (NULL != m.body.reg) {
+            detail::setup_stream_options(n, *conn, *m.body.reg);
+        }
+
+        // 授予对端初始的流控窗口，对端不支持流控协议时不启用
+        if (NULL != ep && n.get_conf().flow_credit_window > 0 && ep->check_capability(protocol::reg_data::EN_CAP_FLOW_CREDIT)) {
+            ep->pop_flow_consumed();
+            int res = send_credit(ATBUS_CMD_NODE_CREDIT_RSP, n, *conn, n.get_conf().flow_credit_window, true);
+            if (res < 0) {
+                ATBUS_FUNC_NODE_ERROR(n, ep, conn, res, 0);
+            }
+        }
+
+        if (node::state_t::CONNECTING_PARENT == n.get_state()) {
             // 父节点返回的rsp成功则可以上线
             // 这时候父节点的endpoint不一定初始化完毕
             if (n.is_parent_node(m.body.reg->bus_id)) {
@@ -489,6 +977,14 @@ namespace atbus {
             return EN_ATBUS_ERR_BAD_DATA;
         }
 
+        if (0 != m.body.conn->to) {
+            int res = detail::dispatch_peer_conn_syn(n, m);
+            if (res < 0) {
+                ATBUS_FUNC_NODE_ERROR(n, conn->get_binding(), conn, res, 0);
+            }
+            return res;
+        }
+
         ATBUS_FUNC_NODE_DEBUG(n, NULL, NULL, &m, "node recv conn_syn and prepare connect to %s", m.body.conn->address.address.c_str());
         int ret = n.connect(m.body.conn->address.address.c_str());
         if (ret < 0) {
@@ -534,4 +1030,46 @@ namespace atbus {
 
         return EN_ATBUS_ERR_SUCCESS;
     }
+
+    int msg_handler::on_recv_node_credit_req(node &n, connection *conn, protocol::msg &m, int status, int errcode) {
+        if (NULL == m.body.credit || NULL == conn) {
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        endpoint *ep = conn->get_binding();
+        if (NULL == ep) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        // 对端窗口已耗尽，立即归还已处理的部分，否则等处理下一条消息时归还
+        uint32_t consumed = ep->pop_flow_consumed();
+        if (0 == consumed) {
+            ep->set_flow_peer_blocked(true);
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        ep->set_flow_peer_blocked(false);
+        return send_credit(ATBUS_CMD_NODE_CREDIT_RSP, n, *conn, consumed, false);
+    }
+
+    int msg_handler::on_recv_node_credit_rsp(node &n, connection *conn, protocol::msg &m, int status, int errcode) {
+        if (NULL == m.body.credit || NULL == conn) {
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        endpoint *ep = conn->get_binding();
+        if (NULL == ep) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        ep->add_flow_credits(m.body.credit->credits, m.body.credit->reset);
+        ATBUS_FUNC_NODE_DEBUG(n, ep, conn, &m, "node recv credits %u, left credits %u", m.body.credit->credits, ep->get_flow_credits());
+
+        if (ep->check_flow_blocked() && ep->get_flow_credits() > 0) {
+            ep->set_flow_blocked(false);
+            n.on_writable(ep, conn);
+        }
+
+        return EN_ATBUS_ERR_SUCCESS;
+    }
 }
@@ -13,6 +13,7 @@
 #pragma comment(lib, "Ws2_32.lib")
 #endif
 
+#include <algorithm>
 #include <assert.h>
 #include <cstddef>
 #include <cstdio>
@@ -34,6 +35,29 @@
 #include "detail/libatbus_protocol.h"
 
 namespace atbus {
+    namespace detail {
+        // 多目标发送时下一跳相同的一组目标
+        struct multicast_group_t {
+            endpoint *ep;
+            connection *conn;
+            std::vector<ATBUS_MACRO_BUSID_TYPE> targets;
+
+            multicast_group_t() : ep(NULL), conn(NULL) {}
+        };
+
+        // 路由同步消息按条目数拆分，消息头和单个条目打包后的最大长度
+        enum {
+            NODE_SYNC_HEAD_RESERVE_SIZE = 64,
+            NODE_SYNC_NODE_PACK_SIZE = 32,
+        };
+
+        // 端点的子树ID段是否和[min_id, max_id]有交集
+        static bool is_subtree_intersect(const endpoint &ep, ATBUS_MACRO_BUSID_TYPE min_id, ATBUS_MACRO_BUSID_TYPE max_id) {
+            return endpoint::get_children_min_id(ep.get_id(), ep.get_children_mask()) <= max_id &&
+                   endpoint::get_children_max_id(ep.get_id(), ep.get_children_mask()) >= min_id;
+        }
+    }
+
     node::flag_guard_t::flag_guard_t(const node *o, flag_t::type f) : owner(const_cast<node *>(o)), flag(f), holder(false) {
         if (owner && !owner->flags_.test(flag)) {
             holder = true;
@@ -47,11 +71,17 @@ namespace atbus {
         }
     }
 
-    node::node() : state_(state_t::CREATED), ev_loop_(NULL), static_buffer_(NULL), on_debug(NULL) {
+    node::node() : state_(state_t::CREATED), ev_loop_(NULL), static_buffer_(NULL), pack_buffer_(NULL), on_debug(NULL) {
+        // 代数从1开始，初始的缓存项都是无效的
+        route_cache_generation_ = 0;
+        invalidate_route_cache();
+
         event_timer_.sec = 0;
         event_timer_.usec = 0;
         event_timer_.node_sync_push = 0;
+        event_timer_.peer_connect_check = 0;
         event_timer_.father_opr_time_point = 0;
+        route_pull_pending_ = false;
 
         flags_.reset();
     }
@@ -75,6 +105,9 @@ namespace atbus {
         conf->loop_times = 128;
         conf->ttl = 16; // 默认最长8次跳转
 
+        conf->dispatch_workers = 0;
+        conf->dispatch_pending_limit = 4096;
+
         conf->first_idle_timeout = ATBUS_MACRO_CONNECTION_CONFIRM_TIMEOUT;
         conf->ping_interval = 60;
         conf->retry_interval = 3;
@@ -85,6 +118,19 @@ namespace atbus {
         conf->recv_buffer_size = ATBUS_MACRO_MSG_LIMIT * 32; // default for 3 times of ATBUS_MACRO_MSG_LIMIT = 2MB
         conf->send_buffer_size = ATBUS_MACRO_MSG_LIMIT;
         conf->send_buffer_number = 0;
+        conf->send_buffer_overflow_size = 0;
+        conf->send_buffer_high_watermark = 0;
+        conf->send_buffer_low_watermark = 0;
+        conf->buffer_pool_idle_size = ATBUS_MACRO_MSG_LIMIT * 16;
+
+        conf->compress_codec = 0;
+        conf->compress_threshold = 512;
+
+        conf->flow_credit_window = 0;
+
+        conf->send_batch_size = 0;
+
+        conf->peer_connect_threshold = 0;
 
         conf->flags.reset();
     }
@@ -110,6 +156,16 @@ namespace atbus {
             conf_ = *conf;
         }
 
+        // 合并包还要加上消息头和路由，最多使用msg_size的一半
+        if (conf_.send_batch_size > conf_.msg_size / 2) {
+            conf_.send_batch_size = conf_.msg_size / 2;
+        }
+
+        // 低水位必须低于高水位，否则拥塞通知会在每次写入时反复触发
+        if (conf_.send_buffer_high_watermark > 0 && conf_.send_buffer_low_watermark >= conf_.send_buffer_high_watermark) {
+            conf_.send_buffer_low_watermark = conf_.send_buffer_high_watermark / 2;
+        }
+
         ev_loop_ = conf_.ev_loop;
         self_ = endpoint::create(this, id, conf_.children_mask, get_pid(), get_hostname());
         if (!self_) {
@@ -117,13 +173,29 @@ namespace atbus {
         }
         // 复制配置
         self_->set_flag(endpoint::flag_t::GLOBAL_ROUTER, conf_.flags.test(conf_flag_t::EN_CONF_GLOBAL_ROUTER));
+        self_->set_flag(endpoint::flag_t::FAST_DATA_HEAD, conf_.flags.test(conf_flag_t::EN_CONF_FAST_DATA_HEAD));
 
         static_buffer_ = detail::buffer_block::malloc(conf_.msg_size + detail::buffer_block::head_size(conf_.msg_size) +
                                                       16); // 预留hash码32位长度和vint长度);
+        pack_buffer_ = detail::buffer_block::malloc(conf_.msg_size);
 
         self_data_msgs_.clear();
         self_cmd_msgs_.clear();
 
+        // 接收数据分发线程池
+        if (conf_.dispatch_workers > 0) {
+            recv_dispatcher_.reset(new detail::recv_dispatcher());
+            if (recv_dispatcher_) {
+                int res = recv_dispatcher_->start(conf_.dispatch_workers, on_dispatch_recv_data, this);
+                if (res < 0) {
+                    // 不支持时退化为在IO线程中回调
+                    recv_dispatcher_.reset();
+                    ATBUS_FUNC_NODE_ERROR(*this, NULL, NULL, res, 0);
+                }
+            }
+        }
+        update_dispatch_recv_handle();
+
         state_ = state_t::INITED;
         return EN_ATBUS_ERR_SUCCESS;
     }
@@ -169,6 +241,10 @@ namespace atbus {
                 ;
         }
 
+        // 合并缓冲区里的数据尽量发出去
+        flush();
+        send_batches_.clear();
+
         // first save all connection, and then reset it
         typedef detail::auto_select_map<std::string, connection::ptr_t>::type auto_map_t;
         {
@@ -192,8 +268,22 @@ namespace atbus {
             remove_endpoint(node_father_.node_->get_id());
         }
         // endpoint 不应该游离在node以外，所以这里就应该要触发endpoint::reset
+        // 先清空索引，移除回调中不会再查找到这些节点
+        node_brother_index_.clear();
+        node_children_index_.clear();
         remove_collection(node_brother_);
         remove_collection(node_children_);
+        remove_collection(node_peers_);
+        peer_traffic_.clear();
+        peer_connect_pending_.clear();
+
+        // 清空全局路由表
+        route_table_.clear();
+        route_changed_.clear();
+        route_full_sync_.clear();
+        route_pull_pending_ = false;
+        event_timer_.node_sync_push = 0;
+        invalidate_route_cache();
 
         // 清空检测列表和ping列表
         event_timer_.pending_check_list_.clear();
@@ -221,6 +311,13 @@ namespace atbus {
             uv_run(get_evloop(), UV_RUN_ONCE);
         }
 
+        // 等待分发线程处理完剩余的消息
+        if (recv_dispatcher_) {
+            recv_dispatcher_->stop();
+            recv_dispatcher_.reset();
+        }
+        update_dispatch_recv_handle();
+
         // 基础数据
         iostream_channel_.reset(); // 这里结束后就不会再触发回调了
         iostream_conf_.reset();
@@ -236,6 +333,16 @@ namespace atbus {
             static_buffer_ = NULL;
         }
 
+        if (NULL != pack_buffer_) {
+            detail::buffer_block::free(pack_buffer_);
+            pack_buffer_ = NULL;
+        }
+
+        for (size_t i = 0; i < nested_pack_buffers_.size(); ++i) {
+            detail::buffer_block::free(nested_pack_buffers_[i]);
+        }
+        nested_pack_buffers_.clear();
+
         conf_.flags.reset();
         state_ = state_t::CREATED;
         flags_.reset();
@@ -351,6 +458,12 @@ namespace atbus {
             }
         }
 
+        // 跨子树直连检测
+        if (conf_.peer_connect_threshold > 0 && event_timer_.peer_connect_check < sec) {
+            event_timer_.peer_connect_check = sec;
+            check_peer_traffic(sec);
+        }
+
 
         // 检测队列
         if (!event_timer_.pending_check_list_.empty()) {
@@ -371,6 +484,21 @@ namespace atbus {
             event_timer_.pending_check_list_.clear();
         }
 
+        // 归还分发线程已处理完的消息占用的流控窗口
+        if (recv_dispatcher_) {
+            detail::recv_dispatcher::credit_list_t credits;
+            recv_dispatcher_->pop_credits(credits);
+            for (size_t i = 0; i < credits.size(); ++i) {
+                endpoint *ep = get_endpoint(credits[i].first);
+                if (NULL != ep && ep->get_id() == credits[i].first) {
+                    msg_handler::add_flow_consumed(*this, *ep, credits[i].second);
+                }
+            }
+        }
+
+        // 合并发送的数据
+        flush();
+
         // dispatcher all self msgs
         ret += dispatch_all_self_msgs();
 
@@ -383,9 +511,25 @@ namespace atbus {
         return ret;
     }
 
+    int node::get_recv_loop_times() const {
+        int ret = conf_.loop_times;
+        if (!recv_dispatcher_ || 0 == conf_.dispatch_pending_limit || ret <= 0) {
+            return ret;
+        }
+
+        // 按积压比例减少拉取次数，分发线程处理完以后自然恢复
+        size_t pending = recv_dispatcher_->get_pending();
+        if (pending >= conf_.dispatch_pending_limit) {
+            return 0;
+        }
+
+        ret = static_cast<int>(static_cast<size_t>(ret) * (conf_.dispatch_pending_limit - pending) / conf_.dispatch_pending_limit);
+        return ret > 0 ? ret : 1;
+    }
+
     int node::poll() {
         // point to point IO stream channels
-        int loop_left = conf_.loop_times;
+        int loop_left = get_recv_loop_times();
         size_t stat_dispatch = stat_.dispatch_times;
         while (iostream_channel_ && loop_left > 0 &&
                EN_ATBUS_ERR_EV_RUN == channel::io_stream_run(get_iostream_channel(), adapter::RUN_NOWAIT)) {
@@ -488,26 +632,39 @@ namespace atbus {
         if (node_father_.node_ && id == node_father_.node_->get_id()) {
             node_father_.node_->reset();
             node_father_.node_.reset();
+            route_table_remove_next_hop(id);
+            invalidate_route_cache();
             return EN_ATBUS_ERR_SUCCESS;
         }
 
-        endpoint *ep = find_child(node_brother_, id);
+        endpoint *ep = detail::find_child(node_brother_index_, id);
         if (NULL != ep && ep->get_id() == id) {
             ep->reset();
 
             // 移除连接关系
-            remove_child(node_brother_, id);
-            // TODO 移除全局表
+            remove_child(node_brother_, node_brother_index_, id);
+            route_table_remove_next_hop(id);
             return EN_ATBUS_ERR_SUCCESS;
         }
 
-        ep = find_child(node_children_, id);
+        ep = detail::find_child(node_children_index_, id);
         if (NULL != ep && ep->get_id() == id) {
             ep->reset();
 
             // 移除连接关系
-            remove_child(node_brother_, id);
-            // TODO 移除全局表
+            remove_child(node_brother_, node_brother_index_, id);
+            route_table_remove_next_hop(id);
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        endpoint_collection_t::iterator iter = node_peers_.find(id);
+        if (iter != node_peers_.end()) {
+            endpoint::ptr_t peer = iter->second;
+            peer->reset();
+
+            // 移除连接关系
+            node_peers_.erase(id);
+            invalidate_route_cache();
             return EN_ATBUS_ERR_SUCCESS;
         }
 
@@ -547,6 +704,35 @@ namespace atbus {
             return ret;
         }
 
+        // 合并发送，只合并发往支持的直连对端的小数据
+        if (conf_.send_batch_size > 0) {
+            size_t entry_size = protocol::batch_data::ENTRY_HEAD_SIZE + s;
+            const endpoint *ep = get_endpoint(tid);
+            if (!require_rsp && entry_size <= conf_.send_batch_size && NULL != ep &&
+                ep->check_capability(protocol::reg_data::EN_CAP_BATCH_DATA)) {
+                // 每条数据都要占用一个流控窗口，超出当前可用的窗口时也先把之前的发出去
+                send_batch_t &batch = send_batches_[tid];
+                if (!batch.empty() && (batch.data.size() + entry_size > conf_.send_batch_size ||
+                                       (ep->is_flow_credit_enabled() && batch.sequences.size() >= ep->get_flow_credits()))) {
+                    int res = flush(tid);
+                    if (res < 0) {
+                        return res;
+                    }
+                }
+
+                send_batch_t &cur = send_batches_[tid];
+                protocol::batch_data::append(cur.data, type, buffer, s);
+                cur.sequences.push_back(alloc_msg_seq());
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            // 不能合并的数据要先把之前合并的发出去，保证时序
+            int res = flush(tid);
+            if (res < 0) {
+                return res;
+            }
+        }
+
         m.init(get_id(), ATBUS_CMD_DATA_TRANSFORM_REQ, type, 0, alloc_msg_seq());
 
         if (NULL == m.body.make_body(m.body.forward)) {
@@ -564,6 +750,401 @@ namespace atbus {
         return send_data_msg(tid, m);
     }
 
+    int node::flush() {
+        if (send_batches_.empty()) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        // 发送过程中的回调可能会修改send_batches_，所以先复制一份目标列表
+        std::vector<bus_id_t> tids;
+        tids.reserve(send_batches_.size());
+        for (send_batch_map_t::iterator iter = send_batches_.begin(); iter != send_batches_.end(); ++iter) {
+            if (!iter->second.empty()) {
+                tids.push_back(iter->first);
+            }
+        }
+
+        int ret = EN_ATBUS_ERR_SUCCESS;
+        for (size_t i = 0; i < tids.size(); ++i) {
+            int res = flush(tids[i]);
+            if (res < 0 && EN_ATBUS_ERR_SUCCESS == ret) {
+                ret = res;
+            }
+        }
+
+        return ret;
+    }
+
+    int node::flush(bus_id_t tid) {
+        send_batch_map_t::iterator iter = send_batches_.find(tid);
+        if (iter == send_batches_.end() || iter->second.empty()) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        send_batch_t batch;
+        batch.swap(iter->second);
+
+        atbus::protocol::msg m;
+        m.init(get_id(), ATBUS_CMD_DATA_TRANSFORM_REQ, 0, 0, alloc_msg_seq());
+        if (NULL == m.body.make_body(m.body.forward)) {
+            batch.swap(send_batches_[tid]);
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        m.body.forward->from = get_id();
+        m.body.forward->to = tid;
+        m.body.forward->content.ptr = &batch.data[0];
+        m.body.forward->content.size = batch.data.size();
+        m.body.forward->set_flag(atbus::protocol::forward_data::FLAG_BATCH);
+
+        int ret = send_data_msg(tid, m);
+
+        send_batch_t &cur = send_batches_[tid];
+        if (EN_ATBUS_ERR_ATNODE_WOULD_BLOCK == ret) {
+            // 流控窗口耗尽时保留数据，下次再发
+            batch.data.insert(batch.data.end(), cur.data.begin(), cur.data.end());
+            batch.sequences.insert(batch.sequences.end(), cur.sequences.begin(), cur.sequences.end());
+            cur.swap(batch);
+        } else {
+            // send_data已经返回了成功，发送失败的数据要逐条通知
+            if (ret < 0) {
+                ATBUS_FUNC_NODE_ERROR(*this, get_endpoint(tid), NULL, ret, 0);
+                on_send_batch_failed(tid, batch, ret);
+            }
+
+            // 复用缓冲区，回调里可能又合并了新的数据
+            send_batch_t &reuse = send_batches_[tid];
+            if (reuse.empty()) {
+                batch.data.clear();
+                batch.sequences.clear();
+                reuse.swap(batch);
+            }
+        }
+
+        return ret;
+    }
+
+    void node::on_send_batch_failed(bus_id_t tid, const send_batch_t &batch, int errcode) {
+        if (!event_msg_.on_send_data_failed || batch.empty()) {
+            return;
+        }
+
+        const endpoint *ep = get_endpoint(tid);
+        size_t offset = 0;
+        for (size_t i = 0; offset < batch.data.size(); ++i) {
+            int32_t type = 0;
+            const void *data = NULL;
+            size_t data_size = 0;
+            size_t next = protocol::batch_data::next(&batch.data[0], batch.data.size(), offset, type, data, data_size);
+            if (0 == next) {
+                break;
+            }
+
+            // 和发送失败的回包一样，按每条数据的类型和序号通知
+            atbus::protocol::msg m;
+            m.init(get_id(), ATBUS_CMD_DATA_TRANSFORM_RSP, type, errcode, i < batch.sequences.size() ? batch.sequences[i] : 0);
+
+            // fake body
+            protocol::forward_data fwd;
+            m.body.forward = &fwd;
+            m.body.forward->from = get_id();
+            m.body.forward->to = tid;
+            m.body.forward->content.ptr = data;
+            m.body.forward->content.size = data_size;
+
+            on_send_data_failed(ep, NULL, &m);
+
+            // remove reference
+            m.body.forward = NULL;
+            offset = next;
+        }
+    }
+
+    int node::send_data_multi(const bus_id_t *targets, size_t n, int type, const void *buffer, size_t s) {
+        if (state_t::CREATED == state_) {
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        if (NULL == targets && n > 0) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        if (s >= conf_.msg_size) {
+            return EN_ATBUS_ERR_BUFF_LIMIT;
+        }
+
+        // 合并缓冲区里的数据要先发出去，保证时序
+        if (!send_batches_.empty()) {
+            for (size_t i = 0; i < n; ++i) {
+                int res = flush(targets[i]);
+                if (res < 0) {
+                    return res;
+                }
+            }
+        }
+
+        atbus::protocol::msg m;
+        m.init(get_id(), ATBUS_CMD_DATA_TRANSFORM_REQ, type, 0, alloc_msg_seq());
+
+        if (NULL == m.body.make_body(m.body.forward)) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        m.body.forward->from = get_id();
+        m.body.forward->content.ptr = buffer;
+        m.body.forward->content.size = s;
+
+        return send_data_multi_msg(targets, n, m);
+    }
+
+    int node::send_data_multi_msg(const bus_id_t *targets, size_t n, atbus::protocol::msg &m) {
+        if (state_t::CREATED == state_) {
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        if ((NULL == targets && n > 0) || NULL == m.body.forward) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        // 去重，同一个目标只收到一次
+        std::vector<bus_id_t> sorted_targets(targets, targets + n);
+        std::sort(sorted_targets.begin(), sorted_targets.end());
+        sorted_targets.erase(std::unique(sorted_targets.begin(), sorted_targets.end()), sorted_targets.end());
+
+        // 按下一跳的连接分组，每个连接只发送一次
+        int ret = EN_ATBUS_ERR_SUCCESS;
+        bool to_self = false;
+        std::vector<detail::multicast_group_t> groups;
+        std::map<connection *, size_t> group_index;
+        for (size_t i = 0; i < sorted_targets.size(); ++i) {
+            bus_id_t tid = sorted_targets[i];
+            if (tid == get_id()) {
+                to_self = true;
+                continue;
+            }
+
+            endpoint *ep = NULL;
+            connection *conn = NULL;
+            int res = find_next_hop(tid, &endpoint::get_data_connection, &ep, &conn);
+            if (res >= 0 && NULL == conn) {
+                res = EN_ATBUS_ERR_ATNODE_NO_CONNECTION;
+            }
+
+            if (res < 0) {
+                if (EN_ATBUS_ERR_SUCCESS == ret) {
+                    ret = res;
+                }
+                continue;
+            }
+
+            std::map<connection *, size_t>::iterator iter = group_index.find(conn);
+            if (iter == group_index.end()) {
+                iter = group_index.insert(std::make_pair(conn, groups.size())).first;
+                groups.push_back(detail::multicast_group_t());
+                groups.back().ep = ep;
+                groups.back().conn = conn;
+            }
+            groups[iter->second].targets.push_back(tid);
+        }
+
+        // 每次发送都会追加路由记录，发下一组前恢复
+        protocol::forward_data &fwd = *m.body.forward;
+        size_t router_size = fwd.router.size();
+        uint32_t hop_count = fwd.hop_count;
+        int flags = fwd.flags;
+        fwd.unset_flag(atbus::protocol::forward_data::FLAG_MULTICAST);
+        fwd.targets.clear();
+
+        if (to_self) {
+            fwd.to = get_id();
+            int res = send_data_msg(get_id(), m);
+            if (res < 0 && EN_ATBUS_ERR_SUCCESS == ret) {
+                ret = res;
+            }
+        }
+
+        for (size_t i = 0; i < groups.size(); ++i) {
+            detail::multicast_group_t &group = groups[i];
+
+            // 只有一个目标或者下一跳不支持时按单播发送，数据区仍然直接引用原始缓冲区
+            if (1 == group.targets.size() || !group.ep->check_capability(protocol::reg_data::EN_CAP_MULTICAST)) {
+                for (size_t j = 0; j < group.targets.size(); ++j) {
+                    fwd.to = group.targets[j];
+                    int res = send_data_msg(group.targets[j], m);
+                    if (res < 0 && EN_ATBUS_ERR_SUCCESS == ret) {
+                        ret = res;
+                    }
+
+                    fwd.router.resize(router_size);
+                    fwd.hop_count = hop_count;
+                    fwd.flags = flags;
+                    fwd.unset_flag(atbus::protocol::forward_data::FLAG_MULTICAST);
+                }
+                continue;
+            }
+
+            // 目标列表放在消息头里，下一跳再按自己的路由拆分
+            fwd.to = group.ep->get_id();
+            fwd.targets.swap(group.targets);
+            fwd.set_flag(atbus::protocol::forward_data::FLAG_MULTICAST);
+            int res = send_msg_to_next_hop(group.ep, *group.conn, m);
+            if (res < 0 && EN_ATBUS_ERR_SUCCESS == ret) {
+                ret = res;
+            }
+
+            fwd.targets.swap(group.targets);
+            fwd.router.resize(router_size);
+            fwd.hop_count = hop_count;
+            fwd.flags = flags;
+            fwd.unset_flag(atbus::protocol::forward_data::FLAG_MULTICAST);
+        }
+
+        return ret;
+    }
+
+    int node::send_data_broadcast(bus_id_t tid, uint32_t mask, int type, const void *buffer, size_t s) {
+        if (state_t::CREATED == state_) {
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        if (s >= conf_.msg_size) {
+            return EN_ATBUS_ERR_BUFF_LIMIT;
+        }
+
+        bus_id_t min_id = endpoint::get_children_min_id(tid, mask);
+        bus_id_t max_id = endpoint::get_children_max_id(tid, mask);
+
+        // 发往目标范围内的合并缓冲区里的数据要先发出去，保证时序
+        std::vector<bus_id_t> flush_tids;
+        for (send_batch_map_t::iterator iter = send_batches_.begin(); iter != send_batches_.end(); ++iter) {
+            if (!iter->second.empty() && iter->first >= min_id && iter->first <= max_id) {
+                flush_tids.push_back(iter->first);
+            }
+        }
+        for (size_t i = 0; i < flush_tids.size(); ++i) {
+            int res = flush(flush_tids[i]);
+            if (res < 0) {
+                return res;
+            }
+        }
+
+        atbus::protocol::msg m;
+        m.init(get_id(), ATBUS_CMD_DATA_TRANSFORM_REQ, type, 0, alloc_msg_seq());
+
+        if (NULL == m.body.make_body(m.body.forward)) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        m.body.forward->from = get_id();
+        m.body.forward->to = tid;
+        m.body.forward->to_mask = mask;
+        m.body.forward->content.ptr = buffer;
+        m.body.forward->content.size = s;
+        m.body.forward->set_flag(atbus::protocol::forward_data::FLAG_BROADCAST);
+
+        int ret = EN_ATBUS_ERR_SUCCESS;
+        if (get_id() >= min_id && get_id() <= max_id) {
+            ret = send_data_msg(get_id(), m);
+        }
+
+        int res = forward_broadcast_msg(m, 0);
+        if (res < 0 && EN_ATBUS_ERR_SUCCESS == ret) {
+            ret = res;
+        }
+
+        return ret;
+    }
+
+    int node::forward_broadcast_msg(atbus::protocol::msg &m, bus_id_t prev_hop) {
+        if (state_t::CREATED == state_) {
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        if (NULL == m.body.forward || !m.body.forward->check_flag(atbus::protocol::forward_data::FLAG_BROADCAST)) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        protocol::forward_data &fwd = *m.body.forward;
+        bus_id_t min_id = endpoint::get_children_min_id(fwd.to, fwd.to_mask);
+        bus_id_t max_id = endpoint::get_children_max_id(fwd.to, fwd.to_mask);
+
+        // 向下只发给子树和目标范围有交集的子节点，来源的子节点已经处理过自己的子树
+        std::vector<endpoint *> next_hops;
+        for (endpoint_collection_t::iterator iter = node_children_.begin(); iter != node_children_.end(); ++iter) {
+            endpoint *ep = iter->second.get();
+            if (NULL != ep && ep->get_id() != prev_hop && detail::is_subtree_intersect(*ep, min_id, max_id)) {
+                next_hops.push_back(ep);
+            }
+        }
+
+        // 来自父节点或兄弟节点的消息只向下转发，否则目标范围超出本节点的子树时还要向上转发
+        bool from_upper = 0 != prev_hop && !is_child_node(prev_hop);
+        if (!from_upper && !(min_id >= endpoint::get_children_min_id(get_id(), self_->get_children_mask()) &&
+                             max_id <= endpoint::get_children_max_id(get_id(), self_->get_children_mask()))) {
+            if (node_father_.node_) {
+                next_hops.push_back(node_father_.node_.get());
+            } else {
+                // 没有父节点时由顶层的兄弟节点各自负责自己的子树
+                for (endpoint_collection_t::iterator iter = node_brother_.begin(); iter != node_brother_.end(); ++iter) {
+                    endpoint *ep = iter->second.get();
+                    if (NULL != ep && ep->get_id() != prev_hop && detail::is_subtree_intersect(*ep, min_id, max_id)) {
+                        next_hops.push_back(ep);
+                    }
+                }
+            }
+        }
+
+        if (next_hops.empty()) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        if (fwd.get_hop_count() >= static_cast<size_t>(conf_.ttl)) {
+            return EN_ATBUS_ERR_ATNODE_TTL;
+        }
+
+        // 每次发送都会追加路由记录，发下一跳前恢复
+        bus_id_t to = fwd.to;
+        size_t router_size = fwd.router.size();
+        uint32_t hop_count = fwd.hop_count;
+        int flags = fwd.flags;
+
+        // 支持广播的下一跳收到的内容完全相同，只打包一次，io_stream连接上直接引用同一块数据
+        // 定长路由记录按下一跳的能力决定是否开启或展开，这时每个下一跳单独打包
+        bool share_packed = !fwd.check_flag(atbus::protocol::forward_data::FLAG_BOUNDED_ROUTER) &&
+                            (fwd.from != get_id() || !conf_.flags.test(conf_flag_t::EN_CONF_BOUNDED_ROUTER));
+        detail::shared_buffer_ptr packed;
+
+        int ret = EN_ATBUS_ERR_SUCCESS;
+        for (size_t i = 0; i < next_hops.size(); ++i) {
+            endpoint *ep = next_hops[i];
+            connection *conn = self_->get_data_connection(ep);
+            int res;
+            if (NULL == conn) {
+                res = EN_ATBUS_ERR_ATNODE_NO_CONNECTION;
+            } else if (ep->check_capability(protocol::reg_data::EN_CAP_BROADCAST)) {
+                res = send_msg_to_next_hop(ep, *conn, m, share_packed ? &packed : NULL);
+            } else if (ep->get_id() >= min_id && ep->get_id() <= max_id) {
+                // 下一跳不支持广播时只能发给它自己，它的子树收不到
+                fwd.to = ep->get_id();
+                fwd.unset_flag(atbus::protocol::forward_data::FLAG_BROADCAST);
+                res = send_msg_to_next_hop(ep, *conn, m);
+            } else {
+                res = EN_ATBUS_ERR_NOT_SUPPORT;
+            }
+
+            if (res < 0 && EN_ATBUS_ERR_SUCCESS == ret) {
+                ret = res;
+            }
+
+            fwd.to = to;
+            fwd.router.resize(router_size);
+            fwd.hop_count = hop_count;
+            fwd.flags = flags;
+        }
+
+        return ret;
+    }
+
     int node::send_data_msg(bus_id_t tid, atbus::protocol::msg &mb) { return send_data_msg(tid, mb, NULL, NULL); }
 
     int node::send_data_msg(bus_id_t tid, atbus::protocol::msg &mb, endpoint **ep_out, connection **conn_out) {
@@ -628,13 +1209,27 @@ namespace atbus {
 
             const size_t msg_head_len = sizeof(::atbus::protocol::msg_head);
             // self data msg
-            if (ATBUS_CMD_DATA_TRANSFORM_REQ == m.head.cmd && m.body.forward) {
-                self_data_msgs_.push_back(bin_data_block_t());
-                bin_data_block_t &bin_data = self_data_msgs_.back();
-                bin_data.resize(sizeof(int) + msg_head_len + m.body.forward->content.size);
-                memcpy(&bin_data[0], &m.head, msg_head_len);
-                memcpy(&bin_data[msg_head_len], &m.body.forward->flags, sizeof(int));
-                memcpy(&bin_data[sizeof(int) + msg_head_len], m.body.forward->content.ptr, m.body.forward->content.size);
+            if (ATBUS_CMD_DATA_TRANSFORM_REQ == m.head.cmd && m.body.forward && self_data_msgs_.empty() &&
+                !check(flag_t::EN_FT_RECV_SELF_MSG) && !check(flag_t::EN_FT_IN_CALLBACK)) {
+                // 没有积压且不在回调中，可以直接分发，数据区引用调用方的数据块，不需要复制
+                {
+                    flag_guard_t fgd(this, flag_t::EN_FT_RECV_SELF_MSG);
+                    dispatch_self_data_msg(m.head, m.body.forward->flags, m.body.forward->content.ptr, m.body.forward->content.size);
+                }
+            } else if (ATBUS_CMD_DATA_TRANSFORM_REQ == m.head.cmd && m.body.forward) {
+                // 回调中发给自己的消息要等当前回调返回，只能复制一份排队
+                const void *bufs[1] = {m.body.forward->content.ptr};
+                size_t lens[1] = {m.body.forward->content.size};
+                detail::shared_buffer_ptr content(detail::shared_buffer::create(bufs, lens, 1));
+                if (!content) {
+                    return EN_ATBUS_ERR_MALLOC;
+                }
+
+                self_data_msgs_.push_back(self_data_msg_t());
+                self_data_msg_t &self_msg = self_data_msgs_.back();
+                self_msg.head = m.head;
+                self_msg.flags = m.body.forward->flags;
+                self_msg.content.swap(content);
             }
 
             // self command msg
@@ -660,30 +1255,81 @@ namespace atbus {
             return EN_ATBUS_ERR_SUCCESS;
         }
 
-#define ASSIGN_EPCONN(tar_var)                  \
-    {                                           \
-        if (NULL != ep_out) *ep_out = tar_var;  \
-        if (NULL != conn_out) *conn_out = conn; \
-    }
-
         connection *conn = NULL;
-        do {
-            // 父节点单独判定，防止父节点被判定为兄弟节点
-            if (node_father_.node_ && is_parent_node(tid)) {
-                endpoint *target = node_father_.node_.get();
-                conn = (self_.get()->*fn)(target);
+        endpoint *to_ep = NULL;
+        int res = find_next_hop(tid, fn, &to_ep, &conn);
+        if (res < 0) {
+            return res;
+        }
 
-                ASSIGN_EPCONN(target);
-                break;
-            }
+        if (NULL != ep_out) {
+            *ep_out = to_ep;
+        }
+        if (NULL != conn_out) {
+            *conn_out = conn;
+        }
 
-            // 兄弟节点(父节点会被判为可能是兄弟节点)
+        if (NULL == conn) {
+            return EN_ATBUS_ERR_ATNODE_NO_CONNECTION;
+        }
+
+        // 统计本节点经由中转发往跨子树节点的数据，用于判定是否需要建立直连
+        if (conf_.peer_connect_threshold > 0 && NULL != to_ep && to_ep->get_id() != tid && ATBUS_CMD_DATA_TRANSFORM_REQ == m.head.cmd &&
+            NULL != m.body.forward && m.body.forward->from == get_id() && !is_child_node(tid) && !is_brother_node(tid)) {
+            ++peer_traffic_[tid];
+        }
+
+        return send_msg_to_next_hop(to_ep, *conn, m);
+    }
+
+    int node::find_next_hop(bus_id_t tid, endpoint::get_connection_fn_t fn, endpoint **ep_out, connection **conn_out) {
+        // 连续发往同一目标时直接命中缓存，连接的状态仍要检查一次
+        route_cache_entry_t &cache = route_cache_[static_cast<size_t>(tid ^ (tid >> 16)) % ROUTE_CACHE_SIZE];
+        if (cache.generation == route_cache_generation_ && cache.tid == tid && cache.fn == fn &&
+            connection::state_t::CONNECTED == cache.conn->get_status()) {
+            ++stat_.route_cache_hit_times;
+            if (NULL != ep_out) {
+                *ep_out = cache.ep;
+            }
+            if (NULL != conn_out) {
+                *conn_out = cache.conn;
+            }
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        endpoint *target = NULL;
+        do {
+            // 跨子树直连节点
+            if (!node_peers_.empty()) {
+                endpoint_collection_t::iterator iter = node_peers_.find(tid);
+                if (iter != node_peers_.end() && NULL != (self_.get()->*fn)(iter->second.get())) {
+                    target = iter->second.get();
+                    break;
+                }
+            }
+
+            // 全局路由表里有跨子树的路由时优先使用，直连节点仍然走下面的判定
+            if (!route_table_.empty()) {
+                route_table_t::const_iterator iter = route_table_.find(tid);
+                if (iter != route_table_.end() && iter->second.distance > 1) {
+                    endpoint *next_hop = get_endpoint(iter->second.next_hop);
+                    if (NULL != next_hop && NULL != (self_.get()->*fn)(next_hop)) {
+                        target = next_hop;
+                        break;
+                    }
+                }
+            }
+
+            // 父节点单独判定，防止父节点被判定为兄弟节点
+            if (node_father_.node_ && is_parent_node(tid)) {
+                target = node_father_.node_.get();
+                break;
+            }
+
+            // 兄弟节点(父节点会被判为可能是兄弟节点)
             if (is_brother_node(tid)) {
-                endpoint *target = find_child(node_brother_, tid);
+                target = detail::find_child(node_brother_index_, tid);
                 if (NULL != target && target->is_child_node(tid)) {
-                    conn = (self_.get()->*fn)(target);
-
-                    ASSIGN_EPCONN(target);
                     break;
                 } else if (false == get_self_endpoint()->get_flag(endpoint::flag_t::GLOBAL_ROUTER) && node_father_.node_) {
                     // 如果没有全量表则发给父节点
@@ -693,10 +1339,7 @@ namespace atbus {
                     //    C11  C12
                     // 当C11发往C12时触发这种情况
                     */
-                    endpoint *target = node_father_.node_.get();
-                    conn = (self_.get()->*fn)(target);
-
-                    ASSIGN_EPCONN(target);
+                    target = node_father_.node_.get();
                     break;
                 }
                 return EN_ATBUS_ERR_ATNODE_INVALID_ID;
@@ -704,11 +1347,8 @@ namespace atbus {
 
             // 子节点
             if (is_child_node(tid)) {
-                endpoint *target = find_child(node_children_, tid);
+                target = detail::find_child(node_children_index_, tid);
                 if (NULL != target && target->is_child_node(tid)) {
-                    conn = (self_.get()->*fn)(target);
-
-                    ASSIGN_EPCONN(target);
                     break;
                 }
                 return EN_ATBUS_ERR_ATNODE_INVALID_ID;
@@ -722,27 +1362,95 @@ namespace atbus {
             // 当C11发往C21或C22时触发这种情况
             */
             if (node_father_.node_ && false == get_self_endpoint()->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
-                endpoint *target = node_father_.node_.get();
-                conn = (self_.get()->*fn)(target);
-
-                ASSIGN_EPCONN(target);
+                target = node_father_.node_.get();
                 break;
             }
         } while (false);
 
-        if (NULL == conn) {
-            return EN_ATBUS_ERR_ATNODE_NO_CONNECTION;
+        connection *conn = NULL;
+        if (NULL != target) {
+            conn = (self_.get()->*fn)(target);
+        }
+
+        // 只缓存可用的连接，失败的查找每次都重新走完整流程
+        if (NULL != conn) {
+            cache.tid = tid;
+            cache.fn = fn;
+            cache.ep = target;
+            cache.conn = conn;
+            cache.generation = route_cache_generation_;
+        }
+
+        if (NULL != ep_out) {
+            *ep_out = target;
+        }
+        if (NULL != conn_out) {
+            *conn_out = conn;
+        }
+
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    int node::send_msg_to_next_hop(endpoint *to_ep, connection &conn, atbus::protocol::msg &m, detail::shared_buffer_ptr *shared_packed) {
+        // 流控窗口只限制本节点发起的数据消息，转发的消息不阻塞
+        bool take_credit = NULL != to_ep && ATBUS_CMD_DATA_TRANSFORM_REQ == m.head.cmd && NULL != m.body.forward &&
+                           m.body.forward->from == get_id();
+        // 合并包里的每条数据都占用一个窗口
+        uint32_t credit_count = 1;
+        if (take_credit && m.body.forward->check_flag(atbus::protocol::forward_data::FLAG_BATCH)) {
+            credit_count = static_cast<uint32_t>(protocol::batch_data::count(m.body.forward->content.ptr, m.body.forward->content.size));
+            if (0 == credit_count) {
+                credit_count = 1;
+            }
+        }
+        if (take_credit && !to_ep->take_flow_credit(credit_count)) {
+            // 第一次阻塞时通知对端尽快归还窗口
+            if (!to_ep->check_flow_blocked()) {
+                to_ep->set_flow_blocked(true);
+
+                connection *ctrl_conn = self_->get_ctrl_connection(to_ep);
+                if (NULL != ctrl_conn) {
+                    int res = msg_handler::send_credit(ATBUS_CMD_NODE_CREDIT_REQ, *this, *ctrl_conn, 0, false);
+                    if (res < 0) {
+                        ATBUS_FUNC_NODE_ERROR(*this, to_ep, ctrl_conn, res, 0);
+                    }
+                }
+            }
+
+            return EN_ATBUS_ERR_ATNODE_WOULD_BLOCK;
         }
 
         if (NULL != m.body.forward) {
-            m.body.forward->router.push_back(get_id());
+            // 下一跳支持时本节点发起的消息才使用定长的路由记录
+            if (m.body.forward->from == get_id() && m.body.forward->router.empty() && 0 == m.body.forward->hop_count &&
+                conf_.flags.test(conf_flag_t::EN_CONF_BOUNDED_ROUTER) && NULL != to_ep &&
+                to_ep->check_capability(protocol::reg_data::EN_CAP_BOUNDED_ROUTER)) {
+                m.body.forward->set_flag(atbus::protocol::forward_data::FLAG_BOUNDED_ROUTER);
+            }
+
+            // 中转给不支持的节点时展开成完整的router
+            if (m.body.forward->check_flag(atbus::protocol::forward_data::FLAG_BOUNDED_ROUTER) && NULL != to_ep &&
+                !to_ep->check_capability(protocol::reg_data::EN_CAP_BOUNDED_ROUTER)) {
+                m.body.forward->expand_router();
+            }
+            m.body.forward->push_router(get_id(), NULL != on_debug);
         }
 
         // head 里永远是发起方bus_id
         m.head.src_bus_id = get_id();
 
-#undef ASSIGN_EPCONN
-        return msg_handler::send_msg(*this, *conn, m);
+        int ret;
+        if (NULL != shared_packed) {
+            ret = msg_handler::send_msg_shared(*this, conn, m, *shared_packed);
+        } else {
+            ret = msg_handler::send_msg(*this, conn, m);
+        }
+        if (ret < 0 && take_credit) {
+            // 发送失败则归还窗口
+            to_ep->add_flow_credits(credit_count, false);
+        }
+
+        return ret;
     }
 
     endpoint *node::get_endpoint(bus_id_t tid) {
@@ -750,9 +1458,17 @@ namespace atbus {
             return node_father_.node_.get();
         }
 
+        // 跨子树直连节点，ID可能落在兄弟节点的范围内，要先查找
+        if (!node_peers_.empty()) {
+            endpoint_collection_t::iterator iter = node_peers_.find(tid);
+            if (iter != node_peers_.end()) {
+                return iter->second.get();
+            }
+        }
+
         // 直连兄弟节点
         if (0 == get_id() || is_brother_node(tid)) {
-            endpoint *res = find_child(node_brother_, tid);
+            endpoint *res = detail::find_child(node_brother_index_, tid);
             if (NULL != res && res->get_id() == tid) {
                 return res;
             }
@@ -761,7 +1477,7 @@ namespace atbus {
 
         // 直连子节点
         if (is_child_node(tid)) {
-            endpoint *res = find_child(node_children_, tid);
+            endpoint *res = detail::find_child(node_children_index_, tid);
             if (NULL != res && res->get_id() == tid) {
                 return res;
             }
@@ -787,11 +1503,13 @@ namespace atbus {
             if (!node_father_.node_) {
                 node_father_.node_ = ep;
                 add_ping_timer(ep);
+                invalidate_route_cache();
 
                 if ((state_t::LOST_PARENT == get_state() || state_t::CONNECTING_PARENT == get_state()) &&
                     check(flag_t::EN_FT_PARENT_REG_DONE)) {
                     on_actived();
                 }
+                route_table_add_direct(*ep);
 
                 // event
                 if (event_msg_.on_endpoint_added) {
@@ -809,8 +1527,9 @@ namespace atbus {
         // 兄弟节点(父节点会被判为可能是兄弟节点)
         if (0 == get_id() || is_brother_node(ep->get_id())) {
             // event will be triggered in insert_child()
-            if (insert_child(node_brother_, ep)) {
+            if (insert_child(node_brother_, node_brother_index_, ep)) {
                 add_ping_timer(ep);
+                route_table_add_direct(*ep);
 
                 return EN_ATBUS_ERR_SUCCESS;
             } else {
@@ -821,16 +1540,35 @@ namespace atbus {
         // 子节点
         if (is_child_node(ep->get_id())) {
             // event will be triggered in insert_child()
-            if (insert_child(node_children_, ep)) {
+            if (insert_child(node_children_, node_children_index_, ep)) {
                 add_ping_timer(ep);
-
-                // TODO 子节点上线上报
+                route_table_add_direct(*ep);
                 return EN_ATBUS_ERR_SUCCESS;
             } else {
                 return EN_ATBUS_ERR_ATNODE_MASK_CONFLICT;
             }
         }
 
+        // 跨子树直连节点，只用于直接收发数据，不参与路由表同步
+        if (conf_.peer_connect_threshold > 0 && 0 != get_id() && 0 != ep->get_id() && get_id() != ep->get_id()) {
+            if (node_peers_.end() != node_peers_.find(ep->get_id())) {
+                return EN_ATBUS_ERR_ATNODE_ID_CONFLICT;
+            }
+
+            node_peers_[ep->get_id()] = ep;
+            peer_connect_pending_.erase(ep->get_id());
+            add_ping_timer(ep);
+            invalidate_route_cache();
+
+            // event
+            if (event_msg_.on_endpoint_added) {
+                flag_guard_t fgd(this, flag_t::EN_FT_IN_CALLBACK);
+                event_msg_.on_endpoint_added(std::cref(*this), ep.get(), EN_ATBUS_ERR_SUCCESS);
+            }
+
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
         return EN_ATBUS_ERR_ATNODE_INVALID_ID;
     }
 
@@ -841,6 +1579,8 @@ namespace atbus {
 
             node_father_.node_.reset();
             state_ = state_t::LOST_PARENT;
+            route_table_remove_next_hop(tid);
+            invalidate_route_cache();
 
             // set reconnect to father into retry interval
             event_timer_.father_opr_time_point = get_timer_sec() + conf_.retry_interval;
@@ -861,7 +1601,8 @@ namespace atbus {
         // 兄弟节点(父节点会被判为可能是兄弟节点)
         if (0 == get_id() || is_brother_node(tid)) {
             // event will be triggered in remove_child()
-            if (remove_child(node_brother_, tid)) {
+            if (remove_child(node_brother_, node_brother_index_, tid)) {
+                route_table_remove_next_hop(tid);
                 return EN_ATBUS_ERR_SUCCESS;
             } else {
                 return EN_ATBUS_ERR_ATNODE_NOT_FOUND;
@@ -871,14 +1612,29 @@ namespace atbus {
         // 子节点
         if (is_child_node(tid)) {
             // event will be triggered in remove_child()
-            if (remove_child(node_children_, tid)) {
-                // TODO 子节点下线上报
+            if (remove_child(node_children_, node_children_index_, tid)) {
+                route_table_remove_next_hop(tid);
                 return EN_ATBUS_ERR_SUCCESS;
             } else {
                 return EN_ATBUS_ERR_ATNODE_NOT_FOUND;
             }
         }
 
+        // 跨子树直连节点
+        endpoint_collection_t::iterator iter = node_peers_.find(tid);
+        if (iter != node_peers_.end()) {
+            endpoint::ptr_t ep = iter->second;
+            node_peers_.erase(iter);
+            invalidate_route_cache();
+
+            // event
+            if (event_msg_.on_endpoint_removed) {
+                flag_guard_t fgd(this, flag_t::EN_FT_IN_CALLBACK);
+                event_msg_.on_endpoint_removed(std::cref(*this), ep.get(), EN_ATBUS_ERR_SUCCESS);
+            }
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
         return EN_ATBUS_ERR_ATNODE_INVALID_ID;
     }
 
@@ -1086,17 +1842,143 @@ namespace atbus {
         }
     }
 
+    bool node::forward_fast_data(connection &conn, const protocol::fast_data_view &view) {
+        if (!view.is_valid() || ATBUS_CMD_DATA_TRANSFORM_REQ != view.get_cmd() || state_t::CREATED == state_) {
+            return false;
+        }
+
+        // 发给本节点、需要回包、多目标和广播的消息走完整流程
+        bus_id_t to = view.get_to();
+        if (to == get_id() || view.get_from() == get_id() || view.check_flag(protocol::forward_data::FLAG_REQUIRE_RSP) ||
+            view.check_flag(protocol::forward_data::FLAG_MULTICAST) || view.check_flag(protocol::forward_data::FLAG_BROADCAST)) {
+            return false;
+        }
+
+        // 超出ttl要回包，调试时定长路由记录还要展开完整的router，也走完整流程
+        bool bounded = view.check_flag(protocol::forward_data::FLAG_BOUNDED_ROUTER);
+        if (view.get_passed_hops() >= static_cast<size_t>(conf_.ttl) || (bounded && NULL != on_debug)) {
+            return false;
+        }
+
+        // 子节点之间的转发需要通知建立直连
+        if (is_child_node(to) && is_child_node(view.get_src_bus_id())) {
+            return false;
+        }
+
+        endpoint *to_ep = NULL;
+        connection *to_conn = NULL;
+        if (find_next_hop(to, &endpoint::get_data_connection, &to_ep, &to_conn) < 0 || NULL == to_ep || NULL == to_conn) {
+            return false;
+        }
+
+        // 下一跳也要支持定长头，数据段直接从接收缓冲区发送
+        if (!to_ep->get_flag(endpoint::flag_t::FAST_DATA_HEAD) || !to_conn->is_push_v_supported() ||
+            (bounded && !to_ep->check_capability(protocol::reg_data::EN_CAP_BOUNDED_ROUTER))) {
+            return false;
+        }
+
+        flag_guard_t pack_guard(this, flag_t::EN_FT_PACKING_MSG);
+        if (!pack_guard || NULL == pack_buffer_ || pack_buffer_->size() < conf_.msg_size) {
+            return false;
+        }
+
+        size_t head_size = protocol::fast_data_head::pack_relay_head(view, get_id(), pack_buffer_->data(), conf_.msg_size);
+        size_t content_size = view.get_content_size();
+        if (0 == head_size || head_size + content_size >= conf_.msg_size) {
+            return false;
+        }
+
+        ATBUS_FUNC_NODE_DEBUG(*this, to_ep, to_conn, NULL, "node forward fast data(type=%d, sequence=%u, to=0x%llx, length=%llu)",
+                              view.get_type(), view.get_sequence(), static_cast<unsigned long long>(to),
+                              static_cast<unsigned long long>(head_size + content_size));
+
+        const void *bufs[2] = {pack_buffer_->data(), view.get_content()};
+        size_t lens[2] = {head_size, content_size};
+        if (to_conn->push_v(bufs, lens, 2) < 0) {
+            return false;
+        }
+
+        ++stat_.fast_forward_times;
+
+        // 和on_recv_data_transfer_req一样，只有对端自己发起的消息占用流控窗口
+        endpoint *from_ep = conn.get_binding();
+        if (NULL != from_ep) {
+            if (conf_.flow_credit_window > 0 && from_ep->check_capability(protocol::reg_data::EN_CAP_FLOW_CREDIT) &&
+                view.get_from() == from_ep->get_id()) {
+                msg_handler::add_flow_consumed(*this, *from_ep, 1);
+            }
+
+            from_ep->clear_stat_fault();
+        }
+
+        return true;
+    }
+
     void node::on_recv_data(const endpoint *ep, connection *conn, const protocol::msg &m, const void *buffer, size_t s) const {
         if (NULL == ep && NULL != conn) {
             ep = conn->get_binding();
         }
 
-        if (event_msg_.on_recv_msg) {
-            flag_guard_t fgd(this, flag_t::EN_FT_IN_CALLBACK);
-            event_msg_.on_recv_msg(std::cref(*this), ep, conn, std::cref(m), buffer, s);
+        if (!event_msg_.on_recv_msg) {
+            return;
+        }
+
+        // 按来源分发到工作线程，同一个来源的消息保证时序
+        if (recv_dispatcher_ && NULL != m.body.forward) {
+            if (recv_dispatcher_->push(m.body.forward->from, m.head, m.body.forward->flags, m.body.forward->from, m.body.forward->to,
+                                       buffer, s) >= 0) {
+                return;
+            }
+        }
+
+        flag_guard_t fgd(this, flag_t::EN_FT_IN_CALLBACK);
+        event_msg_.on_recv_msg(std::cref(*this), ep, conn, std::cref(m), buffer, s);
+    }
+
+    detail::buffer_block *node::alloc_nested_pack_buffer() {
+        if (!nested_pack_buffers_.empty()) {
+            detail::buffer_block *ret = nested_pack_buffers_.back();
+            nested_pack_buffers_.pop_back();
+            return ret;
+        }
+
+        return detail::buffer_block::malloc(conf_.msg_size);
+    }
+
+    void node::free_nested_pack_buffer(detail::buffer_block *block) {
+        if (NULL == block) {
+            return;
+        }
+
+        // reset以后或者配置的消息长度变化后不再复用
+        if (NULL == pack_buffer_ || block->size() < conf_.msg_size) {
+            detail::buffer_block::free(block);
+            return;
+        }
+
+        nested_pack_buffers_.push_back(block);
+    }
+
+    void node::on_flow_consumed(bus_id_t ep_id, size_t dispatch_pushed, uint32_t count) {
+        // 期间有消息投递到分发线程时，等分发线程处理完再归还，这样积压才能反馈给发送方
+        if (recv_dispatcher_ && recv_dispatcher_->get_pushed() != dispatch_pushed && recv_dispatcher_->push_credit(ep_id, count) >= 0) {
+            return;
+        }
+
+        endpoint *ep = get_endpoint(ep_id);
+        if (NULL != ep && ep->get_id() == ep_id) {
+            msg_handler::add_flow_consumed(*this, *ep, count);
         }
     }
 
+    size_t node::get_dispatch_pushed() const {
+        if (!recv_dispatcher_) {
+            return 0;
+        }
+
+        return recv_dispatcher_->get_pushed();
+    }
+
     void node::on_send_data_failed(const endpoint *ep, const connection *conn, const protocol::msg *m) {
         if (event_msg_.on_send_data_failed) {
             flag_guard_t fgd(this, flag_t::EN_FT_IN_CALLBACK);
@@ -1143,6 +2025,9 @@ namespace atbus {
             return EN_ATBUS_ERR_PARAMS;
         }
 
+        // 已绑定端点的连接建立完成后可能比缓存中的连接更优
+        invalidate_route_cache();
+
         // 如果ID有效，则发送注册协议
         // ID为0则是临时节点，不需要注册
         if (get_id()) {
@@ -1211,6 +2096,33 @@ namespace atbus {
         return EN_ATBUS_ERR_SUCCESS;
     }
 
+    int node::on_writable(const endpoint *ep, const connection *conn) {
+        if (event_msg_.on_writable) {
+            flag_guard_t fgd(this, flag_t::EN_FT_IN_CALLBACK);
+            event_msg_.on_writable(std::cref(*this), ep, conn);
+        }
+
+        return 0;
+    }
+
+    int node::on_endpoint_congested(const endpoint *ep, const connection *conn, size_t pending_size) {
+        if (event_msg_.on_endpoint_congested) {
+            flag_guard_t fgd(this, flag_t::EN_FT_IN_CALLBACK);
+            event_msg_.on_endpoint_congested(std::cref(*this), ep, conn, pending_size);
+        }
+
+        return 0;
+    }
+
+    int node::on_endpoint_drained(const endpoint *ep, const connection *conn, size_t pending_size) {
+        if (event_msg_.on_endpoint_drained) {
+            flag_guard_t fgd(this, flag_t::EN_FT_IN_CALLBACK);
+            event_msg_.on_endpoint_drained(std::cref(*this), ep, conn, pending_size);
+        }
+
+        return 0;
+    }
+
     int node::shutdown(int reason) {
         if (flags_.test(flag_t::EN_FT_SHUTDOWN)) {
             return 0;
@@ -1230,6 +2142,31 @@ namespace atbus {
         return 0;
     }
 
+    void node::dispatch_self_data_msg(const atbus::protocol::msg_head &head, int flags, const void *buffer, size_t s) {
+        atbus::protocol::msg m;
+        m.head = head;
+
+        // fake body
+        protocol::forward_data data;
+        m.body.forward = &data;
+        m.body.forward->from = get_id();
+        m.body.forward->to = get_id();
+        m.body.forward->content.ptr = buffer;
+        m.body.forward->content.size = s;
+        m.body.forward->flags = flags;
+
+        on_recv_data(get_self_endpoint(), NULL, m, m.body.forward->content.ptr, m.body.forward->content.size);
+
+        // fake response
+        if (NULL != m.body.forward && m.body.forward->check_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP)) {
+            m.init(get_id(), ATBUS_CMD_DATA_TRANSFORM_RSP, m.head.type, 0, m.head.sequence);
+            on_send_data_failed(get_self_endpoint(), NULL, &m);
+        }
+
+        // remove reference
+        m.body.forward = NULL;
+    }
+
     int node::dispatch_all_self_msgs() {
         int ret = 0;
 
@@ -1247,32 +2184,10 @@ namespace atbus {
 
         typedef std::vector<unsigned char> bin_data_block_t;
         while (loop_left-- > 0 && !self_data_msgs_.empty()) {
-            bin_data_block_t &bin_data = self_data_msgs_.front();
-            atbus::protocol::msg m;
-            // copy head
-            memcpy(&m.head, &bin_data[0], msg_head_len);
-
-            // fake body
-            protocol::forward_data data;
-            m.body.forward = &data;
-            m.body.forward->from = get_id();
-            m.body.forward->to = get_id();
-            m.body.forward->content.ptr = &bin_data[sizeof(int) + msg_head_len];
-            m.body.forward->content.size = bin_data.size() - sizeof(int) - msg_head_len;
-            memcpy(&m.body.forward->flags, &bin_data[msg_head_len], sizeof(int));
-
-            on_recv_data(get_self_endpoint(), NULL, m, m.body.forward->content.ptr, m.body.forward->content.size);
+            self_data_msg_t &self_msg = self_data_msgs_.front();
+            dispatch_self_data_msg(self_msg.head, self_msg.flags, self_msg.content->data(), self_msg.content->size());
             ++ret;
 
-            // fake response
-            if (NULL != m.body.forward && m.body.forward->check_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP)) {
-                m.init(get_id(), ATBUS_CMD_DATA_TRANSFORM_RSP, m.head.type, 0, m.head.sequence);
-                on_send_data_failed(get_self_endpoint(), NULL, &m);
-            }
-
-            // remove reference
-            m.body.forward = NULL;
-
             // pop front msg
             self_data_msgs_.pop_front();
         }
@@ -1346,14 +2261,346 @@ namespace atbus {
     }
 
     int node::push_node_sync() {
-        // TODO 防止短时间内批量上报注册协议，所以合并上报数据包
+        if (!self_ || false == self_->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+            route_changed_.clear();
+            route_full_sync_.clear();
+            route_pull_pending_ = false;
+            return EN_ATBUS_ERR_SUCCESS;
+        }
 
-        // TODO 给所有需要全局路由表的子节点下发数据
-        return EN_ATBUS_ERR_SUCCESS;
+        // 直连节点的距离都是1，先复制出来，发送过程中可能会移除节点
+        std::vector<bus_id_t> peers;
+        for (route_table_t::const_iterator iter = route_table_.begin(); iter != route_table_.end(); ++iter) {
+            if (1 == iter->second.distance) {
+                peers.push_back(iter->first);
+            }
+        }
+
+        std::set<bus_id_t> full_sync;
+        full_sync.swap(route_full_sync_);
+
+        int ret = EN_ATBUS_ERR_SUCCESS;
+        for (size_t i = 0; i < peers.size(); ++i) {
+            endpoint *ep = get_endpoint(peers[i]);
+            if (NULL == ep || false == ep->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+                continue;
+            }
+
+            bool full = full_sync.end() != full_sync.find(peers[i]);
+            if (!full && route_changed_.empty()) {
+                continue;
+            }
+
+            int res = send_node_sync(*ep, full);
+            if (res < 0) {
+                // 发送失败的节点下一次推送全量表，增量数据就不用保留了
+                // 超出消息长度限制的重试也不会成功，直接放弃
+                if (EN_ATBUS_ERR_BUFF_LIMIT != res) {
+                    route_full_sync_.insert(peers[i]);
+                    ret = res;
+                }
+                ATBUS_FUNC_NODE_ERROR(*this, ep, NULL, res, 0);
+            }
+        }
+
+        route_changed_.clear();
+
+        // 撤销的路由可能还有经由其他直连节点的更长路由，之前只保留了最短的，需要重新拉取
+        if (route_pull_pending_) {
+            route_pull_pending_ = false;
+            int res = pull_node_sync();
+            if (res < 0) {
+                route_pull_pending_ = true;
+                ret = res;
+            }
+        }
+
+        return ret;
     }
 
     int node::pull_node_sync() {
-        // TODO 拉取全局节点信息表
+        if (!self_ || false == self_->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        std::vector<bus_id_t> peers;
+        for (route_table_t::const_iterator iter = route_table_.begin(); iter != route_table_.end(); ++iter) {
+            if (1 == iter->second.distance) {
+                peers.push_back(iter->first);
+            }
+        }
+
+        int ret = EN_ATBUS_ERR_SUCCESS;
+        for (size_t i = 0; i < peers.size(); ++i) {
+            endpoint *ep = get_endpoint(peers[i]);
+            if (NULL == ep || false == ep->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+                continue;
+            }
+
+            connection *ctl_conn = self_->get_ctrl_connection(ep);
+            if (NULL == ctl_conn) {
+                ret = EN_ATBUS_ERR_ATNODE_NO_CONNECTION;
+                continue;
+            }
+
+            int res = msg_handler::send_node_sync(ATBUS_CMD_NODE_SYNC_REQ, *this, *ctl_conn, NULL);
+            if (res < 0) {
+                ATBUS_FUNC_NODE_ERROR(*this, ep, ctl_conn, res, 0);
+                ret = res;
+            }
+        }
+
+        return ret;
+    }
+
+    int node::on_node_sync_req(const endpoint *ep) {
+        if (NULL == ep) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        if (!self_ || false == self_->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        route_full_sync_.insert(ep->get_id());
+        schedule_node_sync_push();
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    int node::on_node_sync_rsp(const endpoint *ep, const protocol::node_tree &tree) {
+        if (NULL == ep) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        if (!self_ || false == self_->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        bus_id_t from = ep->get_id();
+        // 已经在待推送集合里的ID再次变化时集合大小不变，所以单独记录
+        bool changed = false;
+        std::vector<bus_id_t> withdrawn;
+
+        // 全量表替换掉之前经由对端学习到的所有路由
+        if (tree.full) {
+            for (route_table_t::iterator iter = route_table_.begin(); iter != route_table_.end();) {
+                if (iter->second.next_hop == from && iter->second.distance > 1) {
+                    route_changed_.insert(iter->first);
+                    withdrawn.push_back(iter->first);
+                    route_table_.erase(iter++);
+                    changed = true;
+                } else {
+                    ++iter;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < tree.nodes.size(); ++i) {
+            const protocol::node_data &nd = tree.nodes[i];
+            if (nd.bus_id == get_id() || nd.bus_id == from) {
+                continue;
+            }
+
+            uint32_t distance = (nd.distance > 0 ? nd.distance : 1) + 1;
+            route_table_t::iterator iter = route_table_.find(nd.bus_id);
+
+            // 超出跳数限制的路由视为不可达
+            if (nd.overwrite && distance < static_cast<uint32_t>(conf_.ttl)) {
+                if (iter == route_table_.end()) {
+                    route_entry_t &ent = route_table_[nd.bus_id];
+                    ent.bus_id = nd.bus_id;
+                    ent.children_mask = static_cast<uint32_t>(nd.children_id_mask);
+                    ent.next_hop = from;
+                    ent.distance = distance;
+                    route_changed_.insert(nd.bus_id);
+                    changed = true;
+                    continue;
+                }
+
+                // 直连节点不会被替换；原来就经由对端的路由直接更新，否则只接受更短的路由
+                if (iter->second.distance > 1 && (iter->second.next_hop == from || distance < iter->second.distance)) {
+                    if (iter->second.next_hop != from || iter->second.distance != distance ||
+                        iter->second.children_mask != static_cast<uint32_t>(nd.children_id_mask)) {
+                        iter->second.children_mask = static_cast<uint32_t>(nd.children_id_mask);
+                        iter->second.next_hop = from;
+                        iter->second.distance = distance;
+                        route_changed_.insert(nd.bus_id);
+                        changed = true;
+                    }
+                }
+            } else if (iter != route_table_.end() && iter->second.next_hop == from && iter->second.distance > 1) {
+                route_changed_.insert(nd.bus_id);
+                withdrawn.push_back(nd.bus_id);
+                route_table_.erase(iter);
+                changed = true;
+            }
+        }
+
+        // 对端撤销而且没有重新加回来的路由，向其他直连节点请求全量表
+        for (size_t i = 0; i < withdrawn.size() && !route_pull_pending_; ++i) {
+            if (route_table_.end() == route_table_.find(withdrawn[i])) {
+                route_pull_pending_ = true;
+            }
+        }
+
+        if (changed) {
+            invalidate_route_cache();
+            schedule_node_sync_push();
+        }
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    void node::route_table_add_direct(const endpoint &ep) {
+        if (!self_ || false == self_->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+            return;
+        }
+
+        route_entry_t &ent = route_table_[ep.get_id()];
+        ent.bus_id = ep.get_id();
+        ent.children_mask = ep.get_children_mask();
+        ent.next_hop = ep.get_id();
+        ent.distance = 1;
+
+        route_changed_.insert(ep.get_id());
+        invalidate_route_cache();
+        // 新的直连节点需要全量表，对端是否开启全局路由表要等注册完成才知道，推送时再判定
+        route_full_sync_.insert(ep.get_id());
+        schedule_node_sync_push();
+    }
+
+    void node::route_table_remove_next_hop(bus_id_t next_hop) {
+        route_full_sync_.erase(next_hop);
+
+        bool changed = false;
+        for (route_table_t::iterator iter = route_table_.begin(); iter != route_table_.end();) {
+            if (iter->second.next_hop == next_hop) {
+                route_changed_.insert(iter->first);
+                route_table_.erase(iter++);
+                changed = true;
+            } else {
+                ++iter;
+            }
+        }
+
+        if (changed) {
+            // 经由这个节点的路由可能还能经由其他直连节点到达
+            route_pull_pending_ = true;
+            invalidate_route_cache();
+            schedule_node_sync_push();
+        }
+    }
+
+    void node::check_peer_traffic(time_t sec) {
+        // 过期的请求允许重试
+        for (std::map<bus_id_t, time_t>::iterator iter = peer_connect_pending_.begin(); iter != peer_connect_pending_.end();) {
+            if (iter->second < sec) {
+                peer_connect_pending_.erase(iter++);
+            } else {
+                ++iter;
+            }
+        }
+
+        peer_traffic_map_t traffic;
+        traffic.swap(peer_traffic_);
+        for (peer_traffic_map_t::const_iterator iter = traffic.begin(); iter != traffic.end(); ++iter) {
+            if (iter->second < conf_.peer_connect_threshold) {
+                continue;
+            }
+
+            if (NULL != get_endpoint(iter->first) || peer_connect_pending_.end() != peer_connect_pending_.find(iter->first)) {
+                continue;
+            }
+
+            ATBUS_FUNC_NODE_DEBUG(*this, NULL, NULL, NULL, "traffic to 0x%llx reach %llu, request peer connection",
+                                  static_cast<unsigned long long>(iter->first), static_cast<unsigned long long>(iter->second));
+            int res = msg_handler::send_peer_conn_syn(*this, iter->first, NULL);
+            if (res < 0) {
+                ATBUS_FUNC_NODE_ERROR(*this, NULL, NULL, res, 0);
+                continue;
+            }
+
+            peer_connect_pending_[iter->first] = sec + conf_.retry_interval;
+        }
+    }
+
+    void node::schedule_node_sync_push() {
+        // 已经在等待推送则合并到下一次推送
+        if (0 == event_timer_.node_sync_push) {
+            event_timer_.node_sync_push = get_timer_sec() > 0 ? get_timer_sec() : 1;
+        }
+    }
+
+    int node::send_node_sync(endpoint &ep, bool full) {
+        connection *ctl_conn = self_->get_ctrl_connection(&ep);
+        if (NULL == ctl_conn) {
+            return EN_ATBUS_ERR_ATNODE_NO_CONNECTION;
+        }
+
+        protocol::node_tree tree;
+        tree.full = full;
+        if (full) {
+            tree.nodes.reserve(route_table_.size());
+            for (route_table_t::const_iterator iter = route_table_.begin(); iter != route_table_.end(); ++iter) {
+                // 水平分割，经由对端学习到的路由不发回给对端
+                if (iter->second.next_hop == ep.get_id()) {
+                    continue;
+                }
+
+                tree.nodes.push_back(protocol::node_data());
+                protocol::node_data &nd = tree.nodes.back();
+                nd.bus_id = iter->first;
+                nd.overwrite = true;
+                nd.children_id_mask = iter->second.children_mask;
+                nd.distance = iter->second.distance;
+            }
+        } else {
+            for (std::set<bus_id_t>::const_iterator iter = route_changed_.begin(); iter != route_changed_.end(); ++iter) {
+                if (*iter == ep.get_id()) {
+                    continue;
+                }
+
+                tree.nodes.push_back(protocol::node_data());
+                protocol::node_data &nd = tree.nodes.back();
+                nd.bus_id = *iter;
+
+                // 已删除或者经由对端的路由都通知对端删除(毒性逆转)
+                route_table_t::const_iterator route_iter = route_table_.find(*iter);
+                if (route_iter != route_table_.end() && route_iter->second.next_hop != ep.get_id()) {
+                    nd.overwrite = true;
+                    nd.children_id_mask = route_iter->second.children_mask;
+                    nd.distance = route_iter->second.distance;
+                }
+            }
+
+            if (tree.nodes.empty()) {
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+        }
+
+        size_t max_nodes = 1;
+        if (conf_.msg_size > static_cast<size_t>(detail::NODE_SYNC_HEAD_RESERVE_SIZE + detail::NODE_SYNC_NODE_PACK_SIZE)) {
+            max_nodes = (conf_.msg_size - detail::NODE_SYNC_HEAD_RESERVE_SIZE) / detail::NODE_SYNC_NODE_PACK_SIZE;
+        }
+
+        if (tree.nodes.size() <= max_nodes) {
+            return msg_handler::send_node_sync(ATBUS_CMD_NODE_SYNC_RSP, *this, *ctl_conn, &tree);
+        }
+
+        // 一条消息放不下时拆成多条，只有第一条是全量表，后面的按增量覆盖
+        std::vector<protocol::node_data> all_nodes;
+        all_nodes.swap(tree.nodes);
+        for (size_t begin = 0; begin < all_nodes.size(); begin += max_nodes) {
+            size_t end = begin + max_nodes < all_nodes.size() ? begin + max_nodes : all_nodes.size();
+            protocol::node_tree part;
+            part.full = full && 0 == begin;
+            part.nodes.assign(all_nodes.begin() + begin, all_nodes.begin() + end);
+
+            int res = msg_handler::send_node_sync(ATBUS_CMD_NODE_SYNC_RSP, *this, *ctl_conn, &part);
+            if (res < 0) {
+                return res;
+            }
+        }
+
         return EN_ATBUS_ERR_SUCCESS;
     }
 
@@ -1377,7 +2624,10 @@ namespace atbus {
         }
     }
 
-    void node::set_on_recv_handle(evt_msg_t::on_recv_msg_fn_t fn) { event_msg_.on_recv_msg = fn; }
+    void node::set_on_recv_handle(evt_msg_t::on_recv_msg_fn_t fn) {
+        event_msg_.on_recv_msg = fn;
+        update_dispatch_recv_handle();
+    }
     node::evt_msg_t::on_recv_msg_fn_t node::get_on_recv_handle() const { return event_msg_.on_recv_msg; }
 
     void node::set_on_send_data_failed_handle(evt_msg_t::on_send_data_failed_fn_t fn) { event_msg_.on_send_data_failed = fn; }
@@ -1407,6 +2657,17 @@ namespace atbus {
     void node::set_on_remove_endpoint_handle(evt_msg_t::on_remove_endpoint_fn_t fn) { event_msg_.on_endpoint_removed = fn; }
     node::evt_msg_t::on_remove_endpoint_fn_t node::get_on_remove_endpoint_handle() const { return event_msg_.on_endpoint_removed; }
 
+    void node::set_on_writable_handle(evt_msg_t::on_writable_fn_t fn) { event_msg_.on_writable = fn; }
+    node::evt_msg_t::on_writable_fn_t node::get_on_writable_handle() const { return event_msg_.on_writable; }
+
+    void node::set_on_endpoint_congested_handle(evt_msg_t::on_endpoint_congested_fn_t fn) { event_msg_.on_endpoint_congested = fn; }
+    node::evt_msg_t::on_endpoint_congested_fn_t node::get_on_endpoint_congested_handle() const {
+        return event_msg_.on_endpoint_congested;
+    }
+
+    void node::set_on_endpoint_drained_handle(evt_msg_t::on_endpoint_drained_fn_t fn) { event_msg_.on_endpoint_drained = fn; }
+    node::evt_msg_t::on_endpoint_drained_fn_t node::get_on_endpoint_drained_handle() const { return event_msg_.on_endpoint_drained; }
+
     void node::ref_object(void *obj) {
         if (NULL == obj) {
             return;
@@ -1417,26 +2678,7 @@ namespace atbus {
 
     void node::unref_object(void *obj) { ref_objs_.erase(obj); }
 
-    endpoint *node::find_child(endpoint_collection_t &coll, bus_id_t id) {
-        // key 保存为子域上界，所以第一个查找的节点要么直接是value，要么是value的子节点
-        endpoint_collection_t::iterator iter = coll.lower_bound(id);
-        if (iter == coll.end()) {
-            return NULL;
-        }
-
-        if (iter->second->get_id() == id) {
-            return iter->second.get();
-        }
-
-        // 不能直接发送到间接子节点，所以直接发给直接子节点由其转发即可
-        if (iter->second->is_child_node(id)) {
-            return iter->second.get();
-        }
-
-        return NULL;
-    }
-
-    bool node::insert_child(endpoint_collection_t &coll, endpoint::ptr_t ep) {
+    bool node::insert_child(endpoint_collection_t &coll, endpoint_index_t &index, endpoint::ptr_t ep) {
         if (!ep) {
             return false;
         }
@@ -1454,6 +2696,8 @@ namespace atbus {
             }
 
             coll[maskv] = ep;
+            detail::rebuild_endpoint_index(coll, index);
+            invalidate_route_cache();
 
             // event
             if (event_msg_.on_endpoint_added) {
@@ -1482,6 +2726,8 @@ namespace atbus {
         }
 
         coll[maskv] = ep;
+        detail::rebuild_endpoint_index(coll, index);
+        invalidate_route_cache();
 
         // event
         if (event_msg_.on_endpoint_added) {
@@ -1491,7 +2737,7 @@ namespace atbus {
         return true;
     }
 
-    bool node::remove_child(endpoint_collection_t &coll, bus_id_t id) {
+    bool node::remove_child(endpoint_collection_t &coll, endpoint_index_t &index, bus_id_t id) {
         endpoint_collection_t::iterator iter = coll.lower_bound(id);
         if (iter == coll.end()) {
             return false;
@@ -1503,6 +2749,8 @@ namespace atbus {
 
         endpoint::ptr_t ep = iter->second;
         coll.erase(iter);
+        detail::rebuild_endpoint_index(coll, index);
+        invalidate_route_cache();
 
         // event
         if (event_msg_.on_endpoint_removed) {
@@ -1515,6 +2763,7 @@ namespace atbus {
     bool node::remove_collection(endpoint_collection_t &coll) {
         endpoint_collection_t ec;
         ec.swap(coll);
+        invalidate_route_cache();
 
         if (event_msg_.on_endpoint_removed) {
             flag_guard_t fgd(this, flag_t::EN_FT_IN_CALLBACK);
@@ -1548,8 +2797,60 @@ namespace atbus {
         event_timer_.ping_list.push_back(std::make_pair(event_timer_.sec + conf_.ping_interval, ep));
     }
 
+    void node::on_dispatch_recv_data(void *priv_data, detail::recv_dispatcher::job_t &job) {
+        const node *self = reinterpret_cast<const node *>(priv_data);
+        if (NULL == self) {
+            return;
+        }
+
+        // 不能直接读取event_msg_，主线程可能同时在修改
+        std::shared_ptr<evt_msg_t::on_recv_msg_fn_t> handle = std::atomic_load(&self->dispatch_recv_handle_);
+        if (!handle || !(*handle)) {
+            return;
+        }
+
+        atbus::protocol::msg m;
+        m.head = job.head;
+
+        // fake body
+        protocol::forward_data data;
+        m.body.forward = &data;
+        m.body.forward->from = job.from;
+        m.body.forward->to = job.to;
+        m.body.forward->flags = job.flags;
+        m.body.forward->content.ptr = job.data.empty() ? NULL : &job.data[0];
+        m.body.forward->content.size = job.data.size();
+
+        // 工作线程中endpoint和connection可能已被释放，所以不传递，来源节点ID在forward->from里
+        (*handle)(std::cref(*self), NULL, NULL, std::cref(m), m.body.forward->content.ptr, m.body.forward->content.size);
+
+        // remove reference
+        m.body.forward = NULL;
+    }
+
+    void node::update_dispatch_recv_handle() {
+        // 整体替换副本，分发线程持有的旧副本在用完后释放
+        std::shared_ptr<evt_msg_t::on_recv_msg_fn_t> handle;
+        if (recv_dispatcher_ && event_msg_.on_recv_msg) {
+            handle = std::make_shared<evt_msg_t::on_recv_msg_fn_t>(event_msg_.on_recv_msg);
+        }
+
+        std::atomic_store(&dispatch_recv_handle_, handle);
+    }
+
     void node::stat_add_dispatch_times() { ++stat_.dispatch_times; }
 
+    void node::invalidate_route_cache() {
+        // 代数回绕到0(包括初始化)时清空所有缓存项，防止很久以前的缓存项被误判为有效
+        if (0 == ++route_cache_generation_ || 1 == route_cache_generation_) {
+            for (size_t i = 0; i < ROUTE_CACHE_SIZE; ++i) {
+                route_cache_[i].generation = 0;
+                route_cache_[i].conn = NULL;
+            }
+            route_cache_generation_ = 1;
+        }
+    }
+
     channel::io_stream_channel *node::get_iostream_channel() {
         if (iostream_channel_) {
             return iostream_channel_.get();
@@ -1565,6 +2866,8 @@ namespace atbus {
         iostream_channel_->evt.callbacks[channel::io_stream_callback_evt_t::EN_FN_DISCONNECTED] = connection::iostream_on_disconnected;
         iostream_channel_->evt.callbacks[channel::io_stream_callback_evt_t::EN_FN_RECVED] = connection::iostream_on_recv_cb;
         iostream_channel_->evt.callbacks[channel::io_stream_callback_evt_t::EN_FN_WRITEN] = connection::iostream_on_written;
+        iostream_channel_->evt.callbacks[channel::io_stream_callback_evt_t::EN_FN_CONGESTED] = connection::iostream_on_congested;
+        iostream_channel_->evt.callbacks[channel::io_stream_callback_evt_t::EN_FN_DRAINED] = connection::iostream_on_drained;
 
         return iostream_channel_.get();
     }
@@ -1585,12 +2888,17 @@ namespace atbus {
 
         iostream_conf_->send_buffer_static = conf_.send_buffer_number;
         iostream_conf_->send_buffer_max_size = conf_.send_buffer_size;
+        iostream_conf_->send_buffer_overflow_size = conf_.send_buffer_overflow_size;
         iostream_conf_->send_buffer_limit_size = conf_.msg_size;
+        iostream_conf_->send_buffer_high_watermark = conf_.send_buffer_high_watermark;
+        iostream_conf_->send_buffer_low_watermark = conf_.send_buffer_low_watermark;
+        iostream_conf_->buffer_pool_idle_size = conf_.buffer_pool_idle_size;
+        iostream_conf_->compress_threshold = conf_.compress_threshold;
         iostream_conf_->confirm_timeout = conf_.first_idle_timeout;
         iostream_conf_->backlog = conf_.backlog;
 
         return iostream_conf_.get();
     }
 
-    node::stat_info_t::stat_info_t() : dispatch_times(0) {}
+    node::stat_info_t::stat_info_t() : dispatch_times(0), route_cache_hit_times(0), fast_forward_times(0) {}
 }
@@ -29,6 +29,7 @@
 #include "detail/buffer.h"
 #include "detail/libatbus_channel_export.h"
 #include "detail/libatbus_error.h"
+#include "detail/lz_codec.h"
 
 
 #ifdef ATBUS_MACRO_ENABLE_STATIC_ASSERT
@@ -51,6 +52,14 @@
 
 #define ATBUS_MACRO_TLS_MERGE_BUFFER_LEN (ATBUS_MACRO_MSG_LIMIT - sizeof(ATBUS_MACRO_DATA_ALIGN_TYPE) - sizeof(uv_write_t))
 
+// 压缩帧头: 1字节算法ID + 最长10字节的varint原始长度
+#define ATBUS_MACRO_IOS_CODEC_HEAD_LEN 11
+// 压缩帧的32位hash和这个标记异或后写入帧头，接收端只需要计算一次hash就能区分是否压缩
+#define ATBUS_MACRO_IOS_CODEC_HASH_MARK 0x61746263
+// 可信传输上跳过校验和时，hash字段填充的标记
+#define ATBUS_MACRO_IOS_NO_CHECKSUM_MAGIC 0x6174626E
+#define ATBUS_MACRO_IOS_NO_CHECKSUM_CODEC_MAGIC 0x6174627A
+
 #if defined(UTIL_CONFIG_THREAD_LOCAL)
 namespace atbus {
     namespace channel {
@@ -178,10 +187,16 @@ namespace atbus {
 
             conf->send_buffer_max_size = 0;
             conf->send_buffer_limit_size = ATBUS_MACRO_MSG_LIMIT;
+            conf->send_buffer_overflow_size = 0;
 
             conf->recv_buffer_max_size = ATBUS_MACRO_MSG_LIMIT * conf->recv_buffer_static;
             conf->recv_buffer_limit_size = ATBUS_MACRO_MSG_LIMIT;
 
+            conf->send_buffer_high_watermark = 0;
+            conf->send_buffer_low_watermark = 0;
+            conf->buffer_pool_idle_size = ATBUS_MACRO_MSG_LIMIT * 16;
+            conf->compress_threshold = 512; // 小包(比如ping)压缩收益很低
+
             conf->backlog = ATBUS_MACRO_CONNECTION_BACKLOG;
         }
 
@@ -215,6 +230,13 @@ namespace atbus {
 
             channel->conf = *conf;
             channel->ev_loop = ev_loop;
+            channel->block_pool.set_max_idle_size(conf->buffer_pool_idle_size);
+
+            // 低水位不低于高水位时每次写入都会在拥塞和恢复之间切换，修正为高水位的一半
+            if (channel->conf.send_buffer_high_watermark > 0 &&
+                channel->conf.send_buffer_low_watermark >= channel->conf.send_buffer_high_watermark) {
+                channel->conf.send_buffer_low_watermark = channel->conf.send_buffer_high_watermark / 2;
+            }
             ATBUS_CHANNEL_IOS_CLEAR_FLAG(channel->flags);
 
             memset(channel->evt.callbacks, 0, sizeof(channel->evt.callbacks));
@@ -297,6 +319,182 @@ namespace atbus {
         }
 
 
+        static const io_stream_codec *g_io_stream_custom_codecs[io_stream_codec::EN_CT_MAX] = {NULL};
+
+        static size_t io_stream_lz_compress_bound(size_t in_len) { return ::atbus::detail::lz::compress_bound(in_len); }
+
+        static size_t io_stream_lz_compress(const void *in, size_t in_len, void *out, size_t out_len) {
+            return ::atbus::detail::lz::compress(in, in_len, out, out_len);
+        }
+
+        static int io_stream_lz_decompress(const void *in, size_t in_len, void *out, size_t out_len) {
+            return ::atbus::detail::lz::decompress(in, in_len, out, out_len);
+        }
+
+        static const io_stream_codec g_io_stream_lz_codec = {io_stream_codec::EN_CT_LZ, "lz", io_stream_lz_compress_bound,
+                                                             io_stream_lz_compress, io_stream_lz_decompress};
+
+        int io_stream_register_codec(const io_stream_codec *codec) {
+            if (NULL == codec || NULL == codec->compress_bound || NULL == codec->compress || NULL == codec->decompress) {
+                return EN_ATBUS_ERR_PARAMS;
+            }
+
+            // 内置算法不允许覆盖
+            if (io_stream_codec::EN_CT_NONE == codec->id || io_stream_codec::EN_CT_LZ == codec->id) {
+                return EN_ATBUS_ERR_PARAMS;
+            }
+
+            g_io_stream_custom_codecs[codec->id] = codec;
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        const io_stream_codec *io_stream_get_codec(uint8_t id) {
+            if (io_stream_codec::EN_CT_LZ == id) {
+                return &g_io_stream_lz_codec;
+            }
+
+            return g_io_stream_custom_codecs[id];
+        }
+
+        int io_stream_set_codec(io_stream_connection *connection, uint8_t id) {
+            if (NULL == connection) {
+                return EN_ATBUS_ERR_PARAMS;
+            }
+
+            if (io_stream_codec::EN_CT_NONE == id) {
+                connection->codec = NULL;
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            const io_stream_codec *codec = io_stream_get_codec(id);
+            if (NULL == codec) {
+                return EN_ATBUS_ERR_NOT_SUPPORT;
+            }
+
+            connection->codec = codec;
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        /**
+         * @brief 根据连接地址设置可信传输标记，只在accept或connect完成时调用一次，接收时直接检查标记
+         */
+        static void io_stream_update_trusted_flag(io_stream_connection *connection) {
+            const channel_address_t &addr = connection->addr;
+            bool trusted = false;
+            if (0 == UTIL_STRFUNC_STRNCASE_CMP("unix", addr.scheme.c_str(), 4)) {
+                trusted = true;
+            } else if (0 == UTIL_STRFUNC_STRNCASE_CMP("ipv4", addr.scheme.c_str(), 4)) {
+                // 本机回环地址
+                trusted = 0 == addr.host.compare(0, 4, "127.");
+            } else if (0 == UTIL_STRFUNC_STRNCASE_CMP("ipv6", addr.scheme.c_str(), 4)) {
+                trusted = addr.host == "::1";
+            }
+
+            if (trusted) {
+                ATBUS_CHANNEL_IOS_SET_FLAG(connection->flags, io_stream_connection::EN_CF_TRUSTED);
+            } else {
+                ATBUS_CHANNEL_IOS_UNSET_FLAG(connection->flags, io_stream_connection::EN_CF_TRUSTED);
+            }
+        }
+
+        bool io_stream_is_trusted_transport(const io_stream_connection *connection) {
+            if (NULL == connection) {
+                return false;
+            }
+
+            return ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_TRUSTED);
+        }
+
+        int io_stream_set_skip_checksum(io_stream_connection *connection, bool skip) {
+            if (NULL == connection) {
+                return EN_ATBUS_ERR_PARAMS;
+            }
+
+            if (!skip) {
+                ATBUS_CHANNEL_IOS_UNSET_FLAG(connection->flags, io_stream_connection::EN_CF_NO_CHECKSUM);
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            if (!io_stream_is_trusted_transport(connection)) {
+                return EN_ATBUS_ERR_NOT_SUPPORT;
+            }
+
+            ATBUS_CHANNEL_IOS_SET_FLAG(connection->flags, io_stream_connection::EN_CF_NO_CHECKSUM);
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        /**
+         * @brief 校验并解码一个完整的帧，然后回调给上层
+         * @param expect_hash_buf 帧头的32位hash（可能未对齐）
+         * @note 压缩帧的hash异或了压缩标记，所以接收端不需要知道对端是否开启了压缩
+         * @note 可信传输上的校验和标记同理，只有可信传输才接受跳过校验和的帧
+         */
+        static void io_stream_dispatch_recv(io_stream_channel *channel, io_stream_connection *conn_raw_ptr, const char *expect_hash_buf,
+                                            char *data, size_t msg_len) {
+            channel->error_code = 0;
+            uint32_t expect_hash;
+            memcpy(&expect_hash, expect_hash_buf, sizeof(uint32_t));
+
+            int errcode = EN_ATBUS_ERR_SUCCESS;
+            bool is_compressed = false;
+            if ((ATBUS_MACRO_IOS_NO_CHECKSUM_MAGIC == expect_hash || ATBUS_MACRO_IOS_NO_CHECKSUM_CODEC_MAGIC == expect_hash) &&
+                io_stream_is_trusted_transport(conn_raw_ptr)) {
+                is_compressed = ATBUS_MACRO_IOS_NO_CHECKSUM_CODEC_MAGIC == expect_hash;
+            } else {
+                uint32_t real_hash = util::hash::murmur_hash3_x86_32(data, static_cast<int>(msg_len), 0);
+                if (expect_hash == real_hash) {
+                    is_compressed = false;
+                } else if (expect_hash == (real_hash ^ ATBUS_MACRO_IOS_CODEC_HASH_MARK)) {
+                    is_compressed = true;
+                } else {
+                    errcode = EN_ATBUS_ERR_BAD_DATA;
+                }
+            }
+
+            if (EN_ATBUS_ERR_SUCCESS != errcode) {
+                // 校验失败，原样回调
+            } else if (!is_compressed) {
+                if (channel->conf.recv_buffer_limit_size > 0 && msg_len > channel->conf.recv_buffer_limit_size) {
+                    errcode = EN_ATBUS_ERR_INVALID_SIZE;
+                }
+            } else {
+                // 压缩帧: 1字节算法ID + varint原始长度 + 压缩数据
+                // 原始长度来自对端，未配置接收限制时也按默认的消息长度上限限制，防止错误的帧申请过大的内存
+                size_t origin_limit = ATBUS_MACRO_MSG_LIMIT;
+                if (channel->conf.recv_buffer_limit_size > 0) {
+                    origin_limit = channel->conf.recv_buffer_limit_size;
+                }
+                uint64_t origin_len = 0;
+                size_t vint_len = 0;
+                const io_stream_codec *codec = NULL;
+                if (msg_len > 1) {
+                    codec = io_stream_get_codec(static_cast<uint8_t>(data[0]));
+                    vint_len = ::atbus::detail::fn::read_vint(origin_len, data + 1, msg_len - 1);
+                }
+
+                if (NULL == codec || 0 == vint_len) {
+                    errcode = EN_ATBUS_ERR_BAD_DATA;
+                } else if (origin_len > origin_limit) {
+                    errcode = EN_ATBUS_ERR_INVALID_SIZE;
+                } else {
+                    if (channel->decompress_buffer.size() < origin_len) {
+                        channel->decompress_buffer.resize(static_cast<size_t>(origin_len));
+                    }
+
+                    char *out = channel->decompress_buffer.empty() ? NULL : &channel->decompress_buffer[0];
+                    if (EN_ATBUS_ERR_SUCCESS ==
+                        codec->decompress(data + 1 + vint_len, msg_len - 1 - vint_len, out, static_cast<size_t>(origin_len))) {
+                        data = out;
+                        msg_len = static_cast<size_t>(origin_len);
+                    } else {
+                        errcode = EN_ATBUS_ERR_BAD_DATA;
+                    }
+                }
+            }
+
+            io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_RECVED, channel, conn_raw_ptr, 0, errcode, data, msg_len);
+        }
+
         static void io_stream_on_recv_alloc_fn(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf) {
             assert(handle && handle->data);
             if (NULL == handle || NULL == handle->data) {
@@ -400,22 +598,9 @@ namespace atbus {
 
                     // 如果读取vint成功，判定是否有小数据包。并对小数据包直接回调
                     if (buff_left_len >= sizeof(uint32_t) + vint_len + msg_len) {
-                        channel->error_code = 0;
-                        uint32_t check_hash =
-                            util::hash::murmur_hash3_x86_32(buff_start + sizeof(uint32_t) + vint_len, static_cast<int>(msg_len), 0);
-                        uint32_t expect_hash;
-                        memcpy(&expect_hash, buff_start, sizeof(uint32_t));
-                        int errcode = EN_ATBUS_ERR_SUCCESS;
-                        if (check_hash != expect_hash) {
-                            errcode = EN_ATBUS_ERR_BAD_DATA;
-                        } else if (channel->conf.recv_buffer_limit_size > 0 && msg_len > channel->conf.recv_buffer_limit_size) {
-                            errcode = EN_ATBUS_ERR_INVALID_SIZE;
-                        }
-
-                        io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_RECVED, channel, conn_raw_ptr, 0, errcode,
-                                                   buff_start + sizeof(uint32_t) + vint_len,
-                                                   // 这里的地址未对齐，所以buffer不能直接保存内存数据
-                                                   msg_len);
+                        // 这里的地址未对齐，所以buffer不能直接保存内存数据
+                        io_stream_dispatch_recv(channel, conn_raw_ptr, buff_start, buff_start + sizeof(uint32_t) + vint_len,
+                                                static_cast<size_t>(msg_len));
 
                         // 32bits hash+vint+buffer
                         buff_start += sizeof(uint32_t) + vint_len + msg_len;
@@ -458,27 +643,12 @@ namespace atbus {
             // 如果在大内存块缓冲区，判定回调
             conn_raw_ptr->read_buffers.front(data, sread, swrite);
             if (NULL != data && 0 == swrite) {
-                channel->error_code = 0;
                 data = ::atbus::detail::fn::buffer_prev(data, sread);
 
-                // 32位Hash校验和
-                uint32_t check_hash = util::hash::murmur_hash3_x86_32(reinterpret_cast<char *>(data) + sizeof(uint32_t),
-                                                                      static_cast<int>(sread - sizeof(uint32_t)), 0);
-                uint32_t expect_hash;
-                memcpy(&expect_hash, data, sizeof(uint32_t));
-                size_t msg_len = sread - sizeof(uint32_t); // - hash32 header
-
-                int errcode = EN_ATBUS_ERR_SUCCESS;
-                if (check_hash != expect_hash) {
-                    errcode = EN_ATBUS_ERR_BAD_DATA;
-                } else if (channel->conf.recv_buffer_limit_size > 0 && msg_len > channel->conf.recv_buffer_limit_size) {
-                    errcode = EN_ATBUS_ERR_INVALID_SIZE;
-                }
-
-                io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_RECVED, channel, conn_raw_ptr, 0, errcode,
-                                           reinterpret_cast<char *>(data) + sizeof(uint32_t), // + hash32 header
-                                           // 由于buffer_block内取出的数据已经保证了字节对齐，所以这里一定是4字节对齐
-                                           msg_len);
+                // 32位Hash校验和 + 数据
+                // 由于buffer_block内取出的数据已经保证了字节对齐，所以这里一定是4字节对齐
+                io_stream_dispatch_recv(channel, conn_raw_ptr, reinterpret_cast<char *>(data),
+                                        reinterpret_cast<char *>(data) + sizeof(uint32_t), sread - sizeof(uint32_t));
 
                 // 回调并释放缓冲区
                 conn_raw_ptr->read_buffers.pop_front(0, true);
@@ -591,6 +761,19 @@ namespace atbus {
                 conn_raw_ptr->act_disc_cbk(channel, conn_raw_ptr, EN_ATBUS_ERR_SUCCESS, NULL, 0);
             }
 
+            // 连接对象可能被外部持有而晚于channel释放，这里先把缓冲区还给内存池
+            conn_raw_ptr->read_buffers.reset();
+            conn_raw_ptr->write_buffers.reset();
+            for (size_t i = 0; i < conn_raw_ptr->write_frames.size(); ++i) {
+                if (NULL != conn_raw_ptr->write_frames[i].shared) {
+                    conn_raw_ptr->write_frames[i].shared->release();
+                }
+            }
+            conn_raw_ptr->write_frames.clear();
+            conn_raw_ptr->write_shared_size = 0;
+            conn_raw_ptr->read_buffers.set_block_pool(NULL);
+            conn_raw_ptr->write_buffers.set_block_pool(NULL);
+
             channel->conn_gc_pool.erase(iter);
         }
 
@@ -691,18 +874,26 @@ namespace atbus {
 
             memset(ret->evt.callbacks, 0, sizeof(ret->evt.callbacks));
             ret->act_disc_cbk = NULL;
+            ret->codec = NULL;
             ret->status = io_stream_connection::EN_ST_CREATED;
 
 
+            if (channel->conf.buffer_pool_idle_size > 0) {
+                ret->read_buffers.set_block_pool(&channel->block_pool);
+                ret->write_buffers.set_block_pool(&channel->block_pool);
+            }
+
             ret->read_buffers.set_limit(channel->conf.recv_buffer_max_size, 0);
             if (channel->conf.recv_buffer_max_size > 0 && channel->conf.recv_buffer_static > 0) {
                 ret->read_buffers.set_mode(channel->conf.recv_buffer_max_size, channel->conf.recv_buffer_static);
             }
             ret->read_head.len = 0;
+            ret->write_shared_size = 0;
 
             ret->write_buffers.set_limit(channel->conf.send_buffer_max_size, 0);
             if (channel->conf.send_buffer_max_size > 0 && channel->conf.send_buffer_static > 0) {
-                ret->write_buffers.set_mode(channel->conf.send_buffer_max_size, channel->conf.send_buffer_static);
+                ret->write_buffers.set_mode(channel->conf.send_buffer_max_size, channel->conf.send_buffer_static,
+                                            channel->conf.send_buffer_overflow_size);
             }
 
             channel->conn_pool[ret->fd] = ret;
@@ -818,6 +1009,7 @@ namespace atbus {
                     uv_ip4_name(&sock_addr.ipv4, ip, sizeof(ip));
                     make_address("ipv4", ip, sock_addr.ipv4.sin_port, conn->addr);
                 }
+                io_stream_update_trusted_flag(conn.get());
             } while (false);
 
             // 回调函数，如果发起连接接口调用成功一定要调用回调函数
@@ -886,6 +1078,7 @@ namespace atbus {
                 size_t path_len = sizeof(pipe_path);
                 uv_pipe_getpeername(pipe_conn, pipe_path, &path_len);
                 make_address("unix", pipe_path, 0, conn->addr);
+                io_stream_update_trusted_flag(conn.get());
 
             } while (false);
 
@@ -1160,6 +1353,7 @@ namespace atbus {
                     break;
                 }
                 conn->addr = async_data->addr;
+                io_stream_update_trusted_flag(conn.get());
 
                 if (async_data->pipe) {
                     io_stream_pipe_init(async_data->channel, conn.get(), reinterpret_cast<adapter::pipe_t *>(req->handle));
@@ -1435,6 +1629,106 @@ namespace atbus {
             return io_stream_disconnect(channel, iter->second.get(), callback);
         }
 
+        /**
+         * @brief 检查发送缓冲区水位，跨越高水位时通知拥塞，拥塞后回落到低水位时通知恢复
+         */
+        static void io_stream_check_watermark(io_stream_connection *connection) {
+            io_stream_channel *channel = connection->channel;
+            if (NULL == channel || 0 == channel->conf.send_buffer_high_watermark) {
+                return;
+            }
+
+            size_t cost_size = connection->write_buffers.limit().cost_size_ + connection->write_shared_size;
+            if (!ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_CONGESTED)) {
+                if (cost_size >= channel->conf.send_buffer_high_watermark) {
+                    ATBUS_CHANNEL_IOS_SET_FLAG(connection->flags, io_stream_connection::EN_CF_CONGESTED);
+                    io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_CONGESTED, channel, connection, 0, EN_ATBUS_ERR_SUCCESS,
+                                               NULL, cost_size);
+                }
+            } else if (cost_size <= channel->conf.send_buffer_low_watermark) {
+                ATBUS_CHANNEL_IOS_UNSET_FLAG(connection->flags, io_stream_connection::EN_CF_CONGESTED);
+                io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_DRAINED, channel, connection, 0, EN_ATBUS_ERR_SUCCESS, NULL,
+                                           cost_size);
+            }
+        }
+
+        /**
+         * @brief 帧在发送块里占用的长度，引用共享数据块的帧只有帧头
+         */
+        static inline size_t io_stream_frame_block_len(const io_stream_connection::write_frame_t &frame) {
+            return NULL == frame.shared ? frame.head_len + frame.data_len : frame.head_len;
+        }
+
+        /**
+         * @brief 计算发送块里包含的帧数量
+         * @param first_frame 发送块里第一帧在帧索引里的下标
+         * @param left_length 发送块里所有帧的总长度
+         * @param has_shared 输出是否包含引用共享数据块的帧
+         */
+        static size_t io_stream_block_frame_count(io_stream_connection *connection, size_t first_frame, size_t left_length,
+                                                  bool &has_shared) {
+            size_t ret = 0;
+            has_shared = false;
+            while (left_length > 0 && first_frame + ret < connection->write_frames.size()) {
+                const io_stream_connection::write_frame_t &frame = connection->write_frames[first_frame + ret];
+                size_t frame_len = io_stream_frame_block_len(frame);
+                if (left_length < frame_len) {
+                    assert(false);
+                    break;
+                }
+
+                has_shared = has_shared || NULL != frame.shared;
+                left_length -= frame_len;
+                ++ret;
+            }
+
+            return ret;
+        }
+
+        /**
+         * @brief 按帧索引回调发送块里的所有帧
+         * @param buff_start 发送块里第一帧的起始地址(跳过uv_write_t)
+         * @param left_length 发送块里所有帧的总长度
+         */
+        static void io_stream_notify_written_frames(io_stream_connection *connection, char *buff_start, size_t left_length, int status,
+                                                    int errcode) {
+            while (left_length > 0) {
+                if (connection->write_frames.empty()) {
+                    assert(false);
+                    break;
+                }
+
+                // 回调里可能会继续发送数据，所以先出队
+                io_stream_connection::write_frame_t frame = connection->write_frames.front();
+                connection->write_frames.pop_front();
+
+                // data length should be enough to hold all data
+                size_t frame_len = io_stream_frame_block_len(frame);
+                if (left_length < frame_len) {
+                    assert(false);
+                    break;
+                }
+
+                void *frame_data = buff_start + frame.head_len;
+                if (NULL != frame.shared) {
+                    frame_data = const_cast<void *>(frame.shared->data());
+                    connection->write_shared_size -= connection->write_shared_size >= frame.data_len ? frame.data_len
+                                                                                                       : connection->write_shared_size;
+                }
+
+                io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_WRITEN, connection->channel, connection, status, errcode,
+                                           frame_data, frame.data_len);
+
+                // 最后一个写队列完成后释放共享数据块
+                if (NULL != frame.shared) {
+                    frame.shared->release();
+                }
+
+                buff_start += frame_len;
+                left_length -= frame_len;
+            }
+        }
+
         static void io_stream_on_written_fn(uv_write_t *req, int status) {
             // req is at the begin of the data block, and will not be used any more, we can delete it here
             // if uv_write2 return 0, this will always be called, so free all data here
@@ -1468,29 +1762,8 @@ namespace atbus {
                 // nwrite = sizeof(uv_write_t) + [data block...]
                 // data block = 32bits hash+vint+data length
                 char *buff_start = reinterpret_cast<char *>(data) + sizeof(uv_write_t);
-                size_t left_length = nwrite - sizeof(uv_write_t);
-                while (left_length > 0) {
-                    // skip 32bits hash
-                    buff_start += sizeof(uint32_t);
-                    uint64_t out;
-                    size_t vint_len = ::atbus::detail::fn::read_vint(out, buff_start, left_length - sizeof(uint32_t));
-                    // skip varint
-                    buff_start += vint_len;
-
-                    // data length should be enough to hold all data
-                    if (left_length < sizeof(uint32_t) + vint_len + static_cast<size_t>(out)) {
-                        assert(false);
-                        left_length = 0;
-                    }
-
-                    io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_WRITEN, connection->channel, connection, status,
-                                               req == data ? EN_ATBUS_ERR_SUCCESS : EN_ATBUS_ERR_NODE_TIMEOUT, buff_start, out);
-
-                    buff_start += static_cast<size_t>(out);
-
-                    // 32bits hash+vint+data length
-                    left_length -= sizeof(uint32_t) + vint_len + static_cast<size_t>(out);
-                }
+                io_stream_notify_written_frames(connection, buff_start, nwrite - sizeof(uv_write_t), status,
+                                                req == data ? EN_ATBUS_ERR_SUCCESS : EN_ATBUS_ERR_NODE_TIMEOUT);
 
                 // remove all cache buffer
                 connection->write_buffers.pop_front(nwrite, true);
@@ -1504,6 +1777,11 @@ namespace atbus {
             // unset writing mode
             ATBUS_CHANNEL_IOS_UNSET_FLAG(connection->flags, io_stream_connection::EN_CF_WRITING);
 
+            // 关闭中的连接不再通知水位变化
+            if (!ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_CLOSING)) {
+                io_stream_check_watermark(connection);
+            }
+
             // write left data
             io_stream_try_write(connection);
 
@@ -1537,29 +1815,8 @@ namespace atbus {
                     size_t nwrite = bb->raw_size();
                     // nwrite = sizeof(uv_write_t) + [data block...]
                     // data block = 32bits hash+vint+data length
-                    char *buff_start = reinterpret_cast<char *>(bb->raw_data()) + sizeof(uv_write_t);
-                    size_t left_length = nwrite - sizeof(uv_write_t);
-                    while (left_length > 0) {
-                        // skip 32bits hash
-                        buff_start += sizeof(uint32_t);
-                        uint64_t out;
-                        size_t vint_len = ::atbus::detail::fn::read_vint(out, buff_start, left_length - sizeof(uint32_t));
-                        // skip varint
-                        buff_start += vint_len;
-
-                        // data length should be enough to hold all data
-                        if (left_length < sizeof(uint32_t) + vint_len + static_cast<size_t>(out)) {
-                            assert(false);
-                            left_length = 0;
-                        }
-                        io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_WRITEN, connection->channel, connection, UV_ECANCELED,
-                                                   EN_ATBUS_ERR_CLOSING, buff_start, out);
-
-                        buff_start += static_cast<size_t>(out);
-
-                        // 32bits hash+vint+data length
-                        left_length -= sizeof(uint32_t) + vint_len + static_cast<size_t>(out);
-                    }
+                    io_stream_notify_written_frames(connection, reinterpret_cast<char *>(bb->raw_data()) + sizeof(uv_write_t),
+                                                    nwrite - sizeof(uv_write_t), UV_ECANCELED, EN_ATBUS_ERR_CLOSING);
 
                     // remove all cache buffer
                     connection->write_buffers.pop_front(nwrite, true);
@@ -1570,19 +1827,28 @@ namespace atbus {
 
             // if not in writing mode, try to merge and write data
             // merge only if message is smaller than read buffer
-            if (connection->write_buffers.limit().cost_number_ > 1 &&
+            // 引用共享数据块的帧单独占用一个发送块，不参与合并
+            bool front_shared = !connection->write_frames.empty() && NULL != connection->write_frames.front().shared;
+            if (!front_shared && connection->write_buffers.limit().cost_number_ > 1 &&
                 connection->write_buffers.front()->raw_size() <= ATBUS_MACRO_DATA_SMALL_SIZE) {
                 size_t available_bytes = ATBUS_MACRO_TLS_MERGE_BUFFER_LEN;
                 char *buffer_start = ::atbus::channel::detail::io_stream_get_msg_buffer();
                 char *free_buffer = buffer_start;
 
                 ::atbus::detail::buffer_block *preview_bb = NULL;
+                size_t frame_index = 0;
                 while (!connection->write_buffers.empty() && available_bytes > 0) {
                     ::atbus::detail::buffer_block *bb = connection->write_buffers.front();
                     if (NULL == bb || bb->raw_size() > available_bytes) {
                         break;
                     }
 
+                    bool has_shared = false;
+                    frame_index += io_stream_block_frame_count(connection, frame_index, bb->raw_size() - sizeof(uv_write_t), has_shared);
+                    if (has_shared) {
+                        break;
+                    }
+
                     // if connection->write_buffers is a static circle buffer, can not merge the bound blocks
                     if (connection->write_buffers.is_static_mode() && NULL != preview_bb && preview_bb > bb) {
                         break;
@@ -1636,10 +1902,20 @@ namespace atbus {
             buff_start += sizeof(uv_write_t);
 
             // call write ，bufs[] will be copied in libuv, but the real data will not
-            uv_buf_t bufs[1] = {uv_buf_init(buff_start, static_cast<unsigned int>(writing_block->raw_size() - sizeof(uv_write_t)))};
+            uv_buf_t bufs[2];
+            unsigned int buf_count = 1;
+            bufs[0] = uv_buf_init(buff_start, static_cast<unsigned int>(writing_block->raw_size() - sizeof(uv_write_t)));
+
+            // 引用共享数据块的帧，发送块里只有帧头，数据直接从共享数据块发送
+            if (!connection->write_frames.empty() && NULL != connection->write_frames.front().shared) {
+                const ::atbus::detail::shared_buffer *shared = connection->write_frames.front().shared;
+                bufs[1] = uv_buf_init(const_cast<char *>(reinterpret_cast<const char *>(shared->data())),
+                                      static_cast<unsigned int>(shared->size()));
+                buf_count = 2;
+            }
 
             ATBUS_CHANNEL_IOS_SET_FLAG(connection->flags, io_stream_connection::EN_CF_WRITING);
-            int res = uv_write(req, connection->handle.get(), bufs, 1, io_stream_on_written_fn);
+            int res = uv_write(req, connection->handle.get(), bufs, buf_count, io_stream_on_written_fn);
             if (0 != res) {
                 connection->channel->error_code = res;
                 ATBUS_CHANNEL_IOS_UNSET_FLAG(connection->flags, io_stream_connection::EN_CF_WRITING);
@@ -1650,6 +1926,127 @@ namespace atbus {
             return ret;
         }
 
+        /**
+         * @brief 把一帧数据写入发送缓冲区
+         * @param codec_head 压缩头，未压缩时长度为0
+         * @param bufs 数据段，依次复制到帧内
+         */
+        static int io_stream_push_frame(io_stream_connection *connection, const char *codec_head, size_t codec_head_len,
+                                        const void *const bufs[], const size_t lens[], size_t count, size_t len) {
+            size_t frame_len = codec_head_len + len;
+            char vint[16];
+            size_t vint_len = ::atbus::detail::fn::write_vint(frame_len, vint, sizeof(vint));
+            // 计算需要的内存块大小（uv_write_t的大小+32bits hash+vint的大小+压缩头+len）
+            size_t total_buffer_size = sizeof(uv_write_t) + sizeof(uint32_t) + vint_len + frame_len;
+
+            // 判定内存限制，写队列里引用的共享数据块也要计入
+            const ::atbus::detail::buffer_manager::limit_t &limit = connection->write_buffers.limit();
+            if (limit.limit_size_ > 0 && limit.cost_size_ + connection->write_shared_size + total_buffer_size > limit.limit_size_) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            void *data;
+            int res = connection->write_buffers.push_back(data, total_buffer_size);
+            if (res < 0) {
+                return res;
+            }
+
+            // 初始化req，填充vint，复制数据区
+            uv_write_t *req = reinterpret_cast<uv_write_t *>(data);
+            req->data = connection;
+            char *buff_start = reinterpret_cast<char *>(data);
+            // req
+            buff_start += sizeof(uv_write_t);
+
+            // vint
+            memcpy(buff_start + sizeof(uint32_t), vint, vint_len);
+            // 压缩头+buffer
+            char *frame_start = buff_start + sizeof(uint32_t) + vint_len;
+            if (codec_head_len > 0) {
+                memcpy(frame_start, codec_head, codec_head_len);
+            }
+
+            char *seg_start = frame_start + codec_head_len;
+            for (size_t i = 0; i < count; ++i) {
+                if (NULL != bufs[i] && lens[i] > 0) {
+                    memcpy(seg_start, bufs[i], lens[i]);
+                    seg_start += lens[i];
+                }
+            }
+
+            // 32bits hash，可信传输上可以只填充标记
+            uint32_t hash32;
+            if (ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_NO_CHECKSUM)) {
+                hash32 = codec_head_len > 0 ? ATBUS_MACRO_IOS_NO_CHECKSUM_CODEC_MAGIC : ATBUS_MACRO_IOS_NO_CHECKSUM_MAGIC;
+            } else {
+                hash32 = util::hash::murmur_hash3_x86_32(frame_start, static_cast<int>(frame_len), 0);
+                if (codec_head_len > 0) {
+                    hash32 ^= ATBUS_MACRO_IOS_CODEC_HASH_MARK;
+                }
+            }
+            memcpy(buff_start, &hash32, sizeof(uint32_t));
+
+            io_stream_connection::write_frame_t frame;
+            frame.head_len = sizeof(uint32_t) + vint_len;
+            frame.data_len = frame_len;
+            frame.shared = NULL;
+            connection->write_frames.push_back(frame);
+
+            io_stream_check_watermark(connection);
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        /**
+         * @brief 把引用共享数据块的一帧写入发送缓冲区，发送块里只保存帧头
+         */
+        static int io_stream_push_shared_frame(io_stream_connection *connection, ::atbus::detail::shared_buffer *buf) {
+            size_t frame_len = buf->size();
+
+            // 共享数据块也计入发送缓冲区的限制
+            const ::atbus::detail::buffer_manager::limit_t &limit = connection->write_buffers.limit();
+            if (limit.limit_size_ > 0 && limit.cost_size_ + connection->write_shared_size + frame_len > limit.limit_size_) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            char vint[16];
+            size_t vint_len = ::atbus::detail::fn::write_vint(frame_len, vint, sizeof(vint));
+            // 计算需要的内存块大小（uv_write_t的大小+32bits hash+vint的大小）
+            size_t total_buffer_size = sizeof(uv_write_t) + sizeof(uint32_t) + vint_len;
+
+            void *data;
+            int res = connection->write_buffers.push_back(data, total_buffer_size);
+            if (res < 0) {
+                return res;
+            }
+
+            // 初始化req，填充vint
+            uv_write_t *req = reinterpret_cast<uv_write_t *>(data);
+            req->data = connection;
+            char *buff_start = reinterpret_cast<char *>(data) + sizeof(uv_write_t);
+            memcpy(buff_start + sizeof(uint32_t), vint, vint_len);
+
+            // 32bits hash，共享数据块不压缩
+            uint32_t hash32;
+            if (ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_NO_CHECKSUM)) {
+                hash32 = ATBUS_MACRO_IOS_NO_CHECKSUM_MAGIC;
+            } else {
+                hash32 = util::hash::murmur_hash3_x86_32(buf->data(), static_cast<int>(frame_len), 0);
+            }
+            memcpy(buff_start, &hash32, sizeof(uint32_t));
+
+            io_stream_connection::write_frame_t frame;
+            frame.head_len = sizeof(uint32_t) + vint_len;
+            frame.data_len = frame_len;
+            frame.shared = buf;
+            connection->write_frames.push_back(frame);
+
+            buf->add_ref();
+            connection->write_shared_size += frame_len;
+
+            io_stream_check_watermark(connection);
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
         int io_stream_send(io_stream_connection *connection, const void *buf, size_t len) {
             if (NULL == connection) {
                 return EN_ATBUS_ERR_PARAMS;
@@ -1665,33 +2062,88 @@ namespace atbus {
 
             // push back message
             if (NULL != buf && len > 0) {
-                char vint[16];
-                size_t vint_len = ::atbus::detail::fn::write_vint(len, vint, sizeof(vint));
-                // 计算需要的内存块大小（uv_write_t的大小+32bits hash+vint的大小+len）
-                size_t total_buffer_size = sizeof(uv_write_t) + sizeof(uint32_t) + vint_len + len;
-
-                // 判定内存限制
-                void *data;
-                int res = connection->write_buffers.push_back(data, total_buffer_size);
+                // 协商了压缩的连接，数据较大时尝试压缩，压缩收益不足时仍然发送原始数据
+                char codec_head[ATBUS_MACRO_IOS_CODEC_HEAD_LEN];
+                size_t codec_head_len = 0;
+                const io_stream_codec *codec = connection->codec;
+                if (NULL != codec && len >= connection->channel->conf.compress_threshold &&
+                    codec->compress_bound(len) <= ATBUS_MACRO_TLS_MERGE_BUFFER_LEN) {
+                    char *compress_buffer = ::atbus::channel::detail::io_stream_get_msg_buffer();
+                    size_t compress_len = codec->compress(buf, len, compress_buffer, ATBUS_MACRO_TLS_MERGE_BUFFER_LEN);
+                    size_t origin_vint_len = ::atbus::detail::fn::write_vint(len, codec_head + 1, sizeof(codec_head) - 1);
+                    if (compress_len > 0 && 1 + origin_vint_len + compress_len < len) {
+                        codec_head[0] = static_cast<char>(codec->id);
+                        codec_head_len = 1 + origin_vint_len;
+                        buf = compress_buffer;
+                        len = compress_len;
+                    }
+                }
+
+                const void *bufs[1] = {buf};
+                size_t lens[1] = {len};
+                int res = io_stream_push_frame(connection, codec_head, codec_head_len, bufs, lens, 1, len);
                 if (res < 0) {
                     return res;
                 }
+            }
+
+            return io_stream_try_write(connection);
+        }
+
+        int io_stream_send_v(io_stream_connection *connection, const void *const bufs[], const size_t lens[], size_t count) {
+            if (NULL == connection || (count > 0 && (NULL == bufs || NULL == lens))) {
+                return EN_ATBUS_ERR_PARAMS;
+            }
 
-                // 初始化req，填充vint，复制数据区
-                uv_write_t *req = reinterpret_cast<uv_write_t *>(data);
-                req->data = connection;
-                char *buff_start = reinterpret_cast<char *>(data);
-                // req
-                buff_start += sizeof(uv_write_t);
+            // 只有一段时走普通发送流程，可以压缩
+            if (1 == count) {
+                return io_stream_send(connection, bufs[0], lens[0]);
+            }
 
-                // 32bits hash
-                uint32_t hash32 = util::hash::murmur_hash3_x86_32(reinterpret_cast<const char *>(buf), static_cast<int>(len), 0);
-                memcpy(buff_start, &hash32, sizeof(uint32_t));
+            size_t len = 0;
+            for (size_t i = 0; i < count; ++i) {
+                if (NULL != bufs[i]) {
+                    len += lens[i];
+                }
+            }
 
-                // vint
-                memcpy(buff_start + sizeof(uint32_t), vint, vint_len);
-                // buffer
-                memcpy(buff_start + sizeof(uint32_t) + vint_len, buf, len);
+            if (connection->channel->conf.send_buffer_limit_size > 0 && len > connection->channel->conf.send_buffer_limit_size) {
+                return EN_ATBUS_ERR_INVALID_SIZE;
+            }
+
+            if (io_stream_connection::EN_ST_CONNECTED != connection->status) {
+                return EN_ATBUS_ERR_CLOSING;
+            }
+
+            // 多段数据直接复制到同一帧里，不压缩
+            if (len > 0) {
+                int res = io_stream_push_frame(connection, NULL, 0, bufs, lens, count, len);
+                if (res < 0) {
+                    return res;
+                }
+            }
+
+            return io_stream_try_write(connection);
+        }
+
+        int io_stream_send_shared(io_stream_connection *connection, ::atbus::detail::shared_buffer *buf) {
+            if (NULL == connection || NULL == buf) {
+                return EN_ATBUS_ERR_PARAMS;
+            }
+
+            if (connection->channel->conf.send_buffer_limit_size > 0 && buf->size() > connection->channel->conf.send_buffer_limit_size) {
+                return EN_ATBUS_ERR_INVALID_SIZE;
+            }
+
+            if (io_stream_connection::EN_ST_CONNECTED != connection->status) {
+                return EN_ATBUS_ERR_CLOSING;
+            }
+
+            if (buf->size() > 0) {
+                int res = io_stream_push_shared_frame(connection, buf);
+                if (res < 0) {
+                    return res;
+                }
             }
 
             return io_stream_try_write(connection);
@@ -1715,16 +2167,38 @@ namespace atbus {
                 << "\tsend_buffer_limit_size(Bytes): " << channel->conf.send_buffer_limit_size << std::endl
                 << "\tsend_buffer_max_size(Bytes): " << channel->conf.send_buffer_max_size << std::endl
                 << "\tsend_buffer_static_max_number: " << channel->conf.send_buffer_static << std::endl
+                << "\tsend_buffer_overflow_size(Bytes): " << channel->conf.send_buffer_overflow_size << std::endl
+                << "\tsend_buffer_high_watermark(Bytes): " << channel->conf.send_buffer_high_watermark << std::endl
+                << "\tsend_buffer_low_watermark(Bytes): " << channel->conf.send_buffer_low_watermark << std::endl
+                << "\tcompress_threshold(Bytes): " << channel->conf.compress_threshold << std::endl
+                << "\tbuffer_pool_idle_size(Bytes): " << channel->conf.buffer_pool_idle_size << std::endl
+                << std::endl;
+
+            const ::atbus::detail::buffer_block_pool::stat_t &pool_stat = channel->block_pool.get_stat();
+            out << "Buffer pool:" << std::endl
+                << "\talloc_count: " << pool_stat.alloc_count << std::endl
+                << "\thit_count: " << pool_stat.hit_count << std::endl
+                << "\thit_rate: " << channel->block_pool.get_hit_rate() << std::endl
+                << "\toversize_count: " << pool_stat.oversize_count << std::endl
+                << "\ttrim_count: " << pool_stat.trim_count << std::endl
+                << "\tused_number: " << pool_stat.used_number << std::endl
+                << "\theld_number: " << pool_stat.held_number << std::endl
+                << "\theld_size(Bytes): " << pool_stat.held_size << std::endl
                 << std::endl;
 
             out << "All connections:" << std::endl;
             for (io_stream_channel::conn_pool_t::iterator iter = channel->conn_pool.begin(); iter != channel->conn_pool.end(); ++iter) {
                 out << "\t" << iter->second->addr.address << ":(status = " << iter->second->status << ")" << std::endl;
 
+                out << "\t\tcodec: " << (NULL == iter->second->codec ? "none" : iter->second->codec->name) << std::endl;
+                out << "\t\tskip_checksum: "
+                    << ATBUS_CHANNEL_IOS_CHECK_FLAG(iter->second->flags, io_stream_connection::EN_CF_NO_CHECKSUM) << std::endl;
+
                 out << "\t\twrite_buffers.cost_number: " << iter->second->write_buffers.limit().cost_number_ << std::endl;
                 out << "\t\twrite_buffers.cost_size: " << iter->second->write_buffers.limit().cost_size_ << std::endl;
                 out << "\t\twrite_buffers.limit_number: " << iter->second->write_buffers.limit().limit_number_ << std::endl;
                 out << "\t\twrite_buffers.limit_size: " << iter->second->write_buffers.limit().limit_size_ << std::endl;
+                out << "\t\twrite_buffers.overflowed: " << iter->second->write_buffers.is_overflowed() << std::endl;
 
                 out << "\t\tread_buffers.cost_number: " << iter->second->read_buffers.limit().cost_number_ << std::endl;
                 out << "\t\tread_buffers.cost_size: " << iter->second->read_buffers.limit().cost_size_ << std::endl;
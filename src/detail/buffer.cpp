@@ -39,8 +39,28 @@ namespace atbus {
                     return 0;
                 }
 
+                const unsigned char *d = reinterpret_cast<const unsigned char *>(pointer);
+
+                // io_stream的帧长度绝大多数是1-3字节，展开这几种情况
+                if (0 == (0x80 & d[0])) {
+                    out = d[0];
+                    return 1;
+                }
+
+                if (s >= 3) {
+                    if (0 == (0x80 & d[1])) {
+                        out = (static_cast<uint64_t>(d[0] & 0x7F) << 7) | d[1];
+                        return 2;
+                    }
+
+                    if (0 == (0x80 & d[2])) {
+                        out = (static_cast<uint64_t>(d[0] & 0x7F) << 14) | (static_cast<uint64_t>(d[1] & 0x7F) << 7) | d[2];
+                        return 3;
+                    }
+                }
+
                 size_t left = s;
-                for (const char *d = reinterpret_cast<const char *>(pointer); left > 0; ++d) {
+                for (; left > 0; ++d) {
                     --left;
 
                     out <<= 7;
@@ -61,39 +81,36 @@ namespace atbus {
                     return 0;
                 }
 
+                // 先算出长度，再从后往前直接写入，不需要再翻转
                 size_t used = 1;
-                char *d = reinterpret_cast<char *>(pointer);
-                *d = 0x7F & in;
-                in >>= 7;
-
-                while (in && used + 1 <= s) {
+                for (uint64_t left = in >> 7; 0 != left; left >>= 7) {
                     ++used;
-                    ++d;
-
-                    *d = 0x80 | (in & 0x7F);
-                    in >>= 7;
                 }
 
-                if (in) {
+                if (used > s) {
                     return 0;
                 }
 
-                char *ss = reinterpret_cast<char *>(pointer);
-                if (ss < d) {
-                    std::reverse(ss, d + 1);
+                unsigned char *d = reinterpret_cast<unsigned char *>(pointer) + used - 1;
+                *d = static_cast<unsigned char>(0x7F & in);
+                in >>= 7;
+                while (0 != in) {
+                    --d;
+                    *d = static_cast<unsigned char>(0x80 | (in & 0x7F));
+                    in >>= 7;
                 }
 
                 return used;
             }
         }
 
-        void *buffer_block::data() { return fn::buffer_next(pointer_, used_); }
+        void *buffer_block::data() { return fn::buffer_next(raw_data(), used_); }
 
-        const void *buffer_block::data() const { return fn::buffer_next(pointer_, used_); }
+        const void *buffer_block::data() const { return fn::buffer_next(raw_data(), used_); }
 
-        void *buffer_block::raw_data() { return pointer_; }
+        void *buffer_block::raw_data() { return fn::buffer_next(this, head_size(size_)); }
 
-        const void *buffer_block::raw_data() const { return pointer_; }
+        const void *buffer_block::raw_data() const { return fn::buffer_next(this, head_size(size_)); }
 
         size_t buffer_block::size() const { return size_ - used_; }
 
@@ -141,17 +158,17 @@ namespace atbus {
             }
 
             size_t fs = full_size(bs);
-            size_t hs = head_size(bs);
             if (fs > s) {
                 return NULL;
             }
 
             buffer_block *res = reinterpret_cast<buffer_block *>(pointer);
             res->size_ = bs;
-            res->pointer_ = fn::buffer_next(pointer, hs);
             res->used_ = 0;
+            res->prev_ = NULL;
+            res->next_ = NULL;
 
-            assert(fn::buffer_next(pointer, fs) >= fn::buffer_next(res->pointer_, res->size_));
+            assert(fn::buffer_next(pointer, fs) >= fn::buffer_next(res->raw_data(), res->size_));
             return fn::buffer_next(pointer, fs);
         }
 
@@ -161,12 +178,14 @@ namespace atbus {
                 return NULL;
             }
 
+            void *ret = fn::buffer_next(p->raw_data(), p->size_);
+
 // debug 版本做内存填充，方便调试
 #if !defined(NDEBUG) || defined(_DEBUG)
             memset(p, 0x5e5e5e5e, full_size(p->size_));
 #endif
 
-            return fn::buffer_next(p->pointer_, p->size_);
+            return ret;
         }
 
         size_t buffer_block::padding_size(size_t s) {
@@ -182,9 +201,213 @@ namespace atbus {
 
         size_t buffer_block::full_size(size_t s) { return head_size(s) + padding_size(s); }
 
+        // ================= shared buffer =================
+        void shared_buffer::add_ref() { ++ref_count_; }
+
+        void shared_buffer::release() {
+            assert(ref_count_ > 0);
+            if (--ref_count_ > 0) {
+                return;
+            }
+
+// debug 版本做内存填充，方便调试
+#if !defined(NDEBUG) || defined(_DEBUG)
+            memset(this, 0x5e5e5e5e, head_size() + size_);
+#endif
+            ::free(this);
+        }
+
+        shared_buffer *shared_buffer::malloc(size_t s) {
+            void *ret = ::malloc(head_size() + s);
+            if (NULL == ret) {
+                return NULL;
+            }
+
+            shared_buffer *res = reinterpret_cast<shared_buffer *>(ret);
+            res->ref_count_ = 1;
+            res->size_ = s;
+            return res;
+        }
+
+        shared_buffer *shared_buffer::create(const void *const bufs[], const size_t lens[], size_t count) {
+            size_t s = 0;
+            for (size_t i = 0; i < count; ++i) {
+                if (NULL != bufs[i]) {
+                    s += lens[i];
+                }
+            }
+
+            shared_buffer *res = malloc(s);
+            if (NULL == res) {
+                return NULL;
+            }
+
+            char *d = reinterpret_cast<char *>(res->mutable_data());
+            for (size_t i = 0; i < count; ++i) {
+                if (NULL != bufs[i] && lens[i] > 0) {
+                    memcpy(d, bufs[i], lens[i]);
+                    d += lens[i];
+                }
+            }
+
+            return res;
+        }
+
+        size_t shared_buffer::head_size() { return buffer_block::padding_size(sizeof(shared_buffer)); }
+
+        // ================= buffer block pool =================
+        buffer_block_pool::buffer_block_pool() : max_idle_size_(static_cast<size_t>(1) << 20) {
+            memset(&stat_, 0, sizeof(stat_));
+
+            // 默认规格从128字节到128KB按2倍递增
+            size_t default_sizes[11];
+            for (size_t i = 0; i < sizeof(default_sizes) / sizeof(default_sizes[0]); ++i) {
+                default_sizes[i] = static_cast<size_t>(128) << i;
+            }
+            set_size_classes(default_sizes, sizeof(default_sizes) / sizeof(default_sizes[0]));
+        }
+
+        buffer_block_pool::~buffer_block_pool() {
+            trim(0);
+            assert(0 == stat_.used_number);
+        }
+
+        bool buffer_block_pool::set_size_classes(const size_t *sizes, size_t count) {
+            // 使用中的内存块需要按原来的规格回收
+            if (stat_.used_number > 0) {
+                return false;
+            }
+
+            trim(0);
+
+            class_sizes_.clear();
+            if (NULL != sizes) {
+                for (size_t i = 0; i < count; ++i) {
+                    if (sizes[i] > 0) {
+                        class_sizes_.push_back(buffer_block::padding_size(sizes[i]));
+                    }
+                }
+            }
+            std::sort(class_sizes_.begin(), class_sizes_.end());
+            class_sizes_.erase(std::unique(class_sizes_.begin(), class_sizes_.end()), class_sizes_.end());
+
+            free_lists_.assign(class_sizes_.size(), NULL);
+            return true;
+        }
+
+        void buffer_block_pool::set_max_idle_size(size_t max_size) {
+            max_idle_size_ = max_size;
+            if (stat_.held_size > max_idle_size_) {
+                trim(max_idle_size_);
+            }
+        }
+
+        buffer_block *buffer_block_pool::malloc(size_t s) {
+            ++stat_.alloc_count;
+
+            size_t idx = find_class(s);
+            if (idx >= class_sizes_.size()) {
+                ++stat_.oversize_count;
+                return buffer_block::malloc(s);
+            }
+
+            size_t fs = buffer_block::full_size(class_sizes_[idx]);
+            void *ret = free_lists_[idx];
+            if (NULL != ret) {
+                // 空闲块的头部存放下一个空闲块的地址
+                free_lists_[idx] = *reinterpret_cast<void **>(ret);
+                ++stat_.hit_count;
+                --stat_.held_number;
+                stat_.held_size -= fs;
+            } else {
+                ret = ::malloc(fs);
+                if (NULL == ret) {
+                    return NULL;
+                }
+            }
+
+            if (NULL == buffer_block::create(ret, fs, s)) {
+                ::free(ret);
+                return NULL;
+            }
+
+            ++stat_.used_number;
+            return reinterpret_cast<buffer_block *>(ret);
+        }
+
+        void buffer_block_pool::free(buffer_block *p) {
+            if (NULL == p) {
+                return;
+            }
+
+            size_t idx = find_class(p->raw_size());
+            if (idx >= class_sizes_.size()) {
+                buffer_block::free(p);
+                return;
+            }
+
+            assert(stat_.used_number > 0);
+            --stat_.used_number;
+
+            buffer_block::destroy(p);
+            size_t fs = buffer_block::full_size(class_sizes_[idx]);
+            if (stat_.held_size + fs > max_idle_size_) {
+                ++stat_.trim_count;
+                ::free(p);
+                return;
+            }
+
+            *reinterpret_cast<void **>(p) = free_lists_[idx];
+            free_lists_[idx] = p;
+            ++stat_.held_number;
+            stat_.held_size += fs;
+        }
+
+        void buffer_block_pool::trim(size_t keep_size) {
+            for (size_t i = free_lists_.size(); i > 0 && stat_.held_size > keep_size; --i) {
+                size_t fs = buffer_block::full_size(class_sizes_[i - 1]);
+                while (NULL != free_lists_[i - 1] && stat_.held_size > keep_size) {
+                    void *p = free_lists_[i - 1];
+                    free_lists_[i - 1] = *reinterpret_cast<void **>(p);
+                    ::free(p);
+
+                    ++stat_.trim_count;
+                    --stat_.held_number;
+                    stat_.held_size -= fs;
+                }
+            }
+        }
+
+        double buffer_block_pool::get_hit_rate() const {
+            if (0 == stat_.alloc_count) {
+                return 0.0;
+            }
+
+            return static_cast<double>(stat_.hit_count) / static_cast<double>(stat_.alloc_count);
+        }
+
+        size_t buffer_block_pool::find_class(size_t s) const {
+            return static_cast<size_t>(std::lower_bound(class_sizes_.begin(), class_sizes_.end(), s) - class_sizes_.begin());
+        }
+
+        // ================= fixed buffer stream =================
+        fixed_buffer_stream::fixed_buffer_stream(void *pointer, size_t s) : pointer_(pointer), capacity_(NULL == pointer ? 0 : s), used_(0) {}
+
+        void fixed_buffer_stream::write(const char *buf, size_t s) {
+            if (used_ + s <= capacity_ && s > 0) {
+                memcpy(fn::buffer_next(pointer_, used_), buf, s);
+            }
+
+            used_ += s;
+        }
+
+        void fixed_buffer_stream::reset() { used_ = 0; }
+
         // ================= buffer manager =================
-        buffer_manager::buffer_manager() {
+        buffer_manager::buffer_manager() : block_pool_(NULL) {
             static_buffer_.buffer_ = NULL;
+            dynamic_buffer_.head_ = NULL;
+            dynamic_buffer_.tail_ = NULL;
 
             reset();
         }
@@ -203,7 +426,8 @@ namespace atbus {
             return false;
         }
 
-        buffer_block *buffer_manager::front() { return is_dynamic_mode() ? dynamic_front() : static_front(); }
+        // 静态模式下溢出的动态块总是排在环形缓冲区的所有数据之后
+        buffer_block *buffer_manager::front() { return static_empty() ? dynamic_front() : static_front(); }
 
         int buffer_manager::front(void *&pointer, size_t &nread, size_t &nwrite) {
             buffer_block *res = front();
@@ -220,7 +444,7 @@ namespace atbus {
             return EN_ATBUS_ERR_SUCCESS;
         }
 
-        buffer_block *buffer_manager::back() { return is_dynamic_mode() ? dynamic_back() : static_back(); }
+        buffer_block *buffer_manager::back() { return dynamic_empty() ? static_back() : dynamic_back(); }
 
         int buffer_manager::back(void *&pointer, size_t &nread, size_t &nwrite) {
             buffer_block *res = back();
@@ -247,7 +471,17 @@ namespace atbus {
                 return EN_ATBUS_ERR_BUFF_LIMIT;
             }
 
-            int res = is_dynamic_mode() ? dynamic_push_back(pointer, s) : static_push_back(pointer, s);
+            int res;
+            if (is_dynamic_mode() || !dynamic_empty()) {
+                res = dynamic_push_back(pointer, s);
+            } else {
+                res = static_push_back(pointer, s);
+                // 环形缓冲区满了，溢出到动态块
+                if (EN_ATBUS_ERR_BUFF_LIMIT == res && is_overflow_enabled()) {
+                    res = dynamic_push_back(pointer, s);
+                }
+            }
+
             if (res >= 0) {
                 ++limit_.cost_number_;
                 limit_.cost_size_ += s;
@@ -266,7 +500,17 @@ namespace atbus {
                 return EN_ATBUS_ERR_BUFF_LIMIT;
             }
 
-            int res = is_dynamic_mode() ? dynamic_push_front(pointer, s) : static_push_front(pointer, s);
+            int res;
+            if (is_dynamic_mode()) {
+                res = dynamic_push_front(pointer, s);
+            } else {
+                res = static_push_front(pointer, s);
+                // 只有环形缓冲区为空时才能放到溢出块的最前面，否则会打乱顺序
+                if (EN_ATBUS_ERR_BUFF_LIMIT == res && is_overflow_enabled() && static_empty()) {
+                    res = dynamic_push_front(pointer, s);
+                }
+            }
+
             if (res >= 0) {
                 ++limit_.cost_number_;
                 limit_.cost_size_ += s;
@@ -276,11 +520,11 @@ namespace atbus {
         }
 
         int buffer_manager::pop_back(size_t s, bool free_unwritable) {
-            return is_dynamic_mode() ? dynamic_pop_back(s, free_unwritable) : static_pop_back(s, free_unwritable);
+            return dynamic_empty() ? static_pop_back(s, free_unwritable) : dynamic_pop_back(s, free_unwritable);
         }
 
         int buffer_manager::pop_front(size_t s, bool free_unwritable) {
-            return is_dynamic_mode() ? dynamic_pop_front(s, free_unwritable) : static_pop_front(s, free_unwritable);
+            return static_empty() ? dynamic_pop_front(s, free_unwritable) : static_pop_front(s, free_unwritable);
         }
 
         int buffer_manager::merge_back(void *&pointer, size_t s) {
@@ -293,7 +537,7 @@ namespace atbus {
                 return EN_ATBUS_ERR_BUFF_LIMIT;
             }
 
-            int res = is_dynamic_mode() ? dynamic_merge_back(pointer, s) : static_merge_back(pointer, s);
+            int res = dynamic_empty() ? static_merge_back(pointer, s) : dynamic_merge_back(pointer, s);
             if (res >= 0) {
                 limit_.cost_size_ += s;
             }
@@ -311,7 +555,7 @@ namespace atbus {
                 return EN_ATBUS_ERR_BUFF_LIMIT;
             }
 
-            int res = is_dynamic_mode() ? dynamic_merge_front(pointer, s) : static_merge_front(pointer, s);
+            int res = static_empty() ? dynamic_merge_front(pointer, s) : static_merge_front(pointer, s);
             if (res >= 0) {
                 limit_.cost_size_ += s;
             }
@@ -319,7 +563,7 @@ namespace atbus {
             return res;
         }
 
-        bool buffer_manager::empty() const { return is_dynamic_mode() ? dynamic_empty() : static_empty(); }
+        bool buffer_manager::empty() const { return static_empty() && dynamic_empty(); }
 
         buffer_block *buffer_manager::static_front() {
             if (static_empty()) {
@@ -534,7 +778,9 @@ namespace atbus {
                 static_buffer_.head_ = 0;
                 static_buffer_.tail_ = 0;
                 static_buffer_.circle_index_[static_buffer_.tail_] = reinterpret_cast<buffer_block *>(static_buffer_.buffer_);
+            }
 
+            if (static_empty() && dynamic_empty()) {
                 limit_.cost_size_ = 0;
                 limit_.cost_number_ = 0;
             } else {
@@ -578,7 +824,9 @@ namespace atbus {
                 static_buffer_.head_ = 0;
                 static_buffer_.tail_ = 0;
                 static_buffer_.circle_index_[static_buffer_.tail_] = reinterpret_cast<buffer_block *>(static_buffer_.buffer_);
+            }
 
+            if (static_empty() && dynamic_empty()) {
                 limit_.cost_size_ = 0;
                 limit_.cost_number_ = 0;
             } else {
@@ -613,7 +861,7 @@ namespace atbus {
                 assert(static_buffer_.size_ == free_len || fn::buffer_next(last_block->raw_data(), last_block->raw_size()) == tail);
 
                 if (free_len >= fs && tail >= head) { // .... head NNNNNN tail NN old_bound NN new_bound ....
-                    pointer = fn::buffer_next(last_block->pointer_, last_block->size_);
+                    pointer = fn::buffer_next(last_block->raw_data(), last_block->size_);
                     last_block->size_ += s;
 
                     assert(fn::buffer_next(static_buffer_.buffer_, static_buffer_.size_) >=
@@ -657,7 +905,7 @@ namespace atbus {
                     return EN_ATBUS_ERR_BUFF_LIMIT;
                 }
 
-                pointer = fn::buffer_next(last_block->pointer_, last_block->size_);
+                pointer = fn::buffer_next(last_block->raw_data(), last_block->size_);
                 // NNN tail NN old_bound NN new_bound ....  head NNNNNN ....
                 last_block->size_ += s;
 
@@ -689,6 +937,7 @@ namespace atbus {
 
             // in case of cover buffer when relocate the header of head block
             buffer_block old_head = *head;
+            const void *old_head_data = head->raw_data();
             size_t new_head_s = s + old_head.raw_size();
             size_t new_head_fs = buffer_block::full_size(new_head_s);
 
@@ -745,7 +994,7 @@ namespace atbus {
             // memory move
             {
                 pointer = fn::buffer_next(head->data(), old_head.raw_size());
-                memmove(head->data(), old_head.raw_data(), old_head.raw_size());
+                memmove(head->data(), old_head_data, old_head.raw_size());
                 head->pop(old_head.raw_size() - old_head.size());
                 assign_head(head);
             }
@@ -762,7 +1011,7 @@ namespace atbus {
                 return NULL;
             }
 
-            return dynamic_buffer_.front();
+            return dynamic_buffer_.head_;
         }
 
         buffer_block *buffer_manager::dynamic_back() {
@@ -770,30 +1019,30 @@ namespace atbus {
                 return NULL;
             }
 
-            return dynamic_buffer_.back();
+            return dynamic_buffer_.tail_;
         }
 
         int buffer_manager::dynamic_push_back(void *&pointer, size_t s) {
-            buffer_block *res = buffer_block::malloc(s);
+            buffer_block *res = dynamic_malloc(s);
             if (NULL == res) {
                 pointer = NULL;
                 return EN_ATBUS_ERR_MALLOC;
             }
 
-            dynamic_buffer_.push_back(res);
+            dynamic_link_back(res);
             pointer = res->data();
 
             return EN_ATBUS_ERR_SUCCESS;
         }
 
         int buffer_manager::dynamic_push_front(void *&pointer, size_t s) {
-            buffer_block *res = buffer_block::malloc(s);
+            buffer_block *res = dynamic_malloc(s);
             if (NULL == res) {
                 pointer = NULL;
                 return EN_ATBUS_ERR_MALLOC;
             }
 
-            dynamic_buffer_.push_front(res);
+            dynamic_link_front(res);
             pointer = res->data();
 
             return EN_ATBUS_ERR_SUCCESS;
@@ -804,15 +1053,15 @@ namespace atbus {
                 return EN_ATBUS_ERR_NO_DATA;
             }
 
-            buffer_block *t = dynamic_buffer_.back();
+            buffer_block *t = dynamic_buffer_.tail_;
             if (s > t->size()) {
                 s = t->size();
             }
 
             t->pop(s);
             if (free_unwritable && t->size() <= 0) {
-                buffer_block::free(t);
-                dynamic_buffer_.pop_back();
+                dynamic_unlink(t);
+                dynamic_free(t);
 
                 if (limit_.cost_number_ > 0) {
                     --limit_.cost_number_;
@@ -820,7 +1069,7 @@ namespace atbus {
             }
 
             // fix limit
-            if (dynamic_empty()) {
+            if (dynamic_empty() && static_empty()) {
                 limit_.cost_size_ = 0;
                 limit_.cost_number_ = 0;
             } else {
@@ -835,15 +1084,15 @@ namespace atbus {
                 return EN_ATBUS_ERR_NO_DATA;
             }
 
-            buffer_block *t = dynamic_buffer_.front();
+            buffer_block *t = dynamic_buffer_.head_;
             if (s > t->size()) {
                 s = t->size();
             }
 
             t->pop(s);
             if (free_unwritable && t->size() <= 0) {
-                buffer_block::free(t);
-                dynamic_buffer_.pop_front();
+                dynamic_unlink(t);
+                dynamic_free(t);
 
                 if (limit_.cost_number_ > 0) {
                     --limit_.cost_number_;
@@ -851,7 +1100,7 @@ namespace atbus {
             }
 
             // fix limit
-            if (dynamic_empty()) {
+            if (dynamic_empty() && static_empty()) {
                 limit_.cost_size_ = 0;
                 limit_.cost_number_ = 0;
             } else {
@@ -871,22 +1120,22 @@ namespace atbus {
                 return EN_ATBUS_ERR_NO_DATA;
             }
 
-            buffer_block *res = buffer_block::malloc(s + block->raw_size());
+            buffer_block *res = dynamic_malloc(s + block->raw_size());
             if (NULL == res) {
                 return EN_ATBUS_ERR_MALLOC;
             }
 
             // reset pointer
             pointer = fn::buffer_next(res->data(), block->raw_size());
-            assert(dynamic_buffer_.back() == block);
-            dynamic_buffer_.back() = res;
+            assert(dynamic_buffer_.tail_ == block);
+            dynamic_replace(block, res);
 
             // move data
             memcpy(res->data(), block->raw_data(), block->raw_size());
             res->pop(block->raw_size() - block->size());
 
             // remove old block
-            buffer_block::free(block);
+            dynamic_free(block);
             return EN_ATBUS_ERR_SUCCESS;
         }
 
@@ -900,31 +1149,118 @@ namespace atbus {
                 return EN_ATBUS_ERR_NO_DATA;
             }
 
-            buffer_block *res = buffer_block::malloc(s + block->raw_size());
+            buffer_block *res = dynamic_malloc(s + block->raw_size());
             if (NULL == res) {
                 return EN_ATBUS_ERR_MALLOC;
             }
 
             // reset pointer
             pointer = fn::buffer_next(res->data(), block->raw_size());
-            assert(dynamic_buffer_.front() == block);
-            dynamic_buffer_.front() = res;
+            assert(dynamic_buffer_.head_ == block);
+            dynamic_replace(block, res);
 
             // move data
             memcpy(res->data(), block->raw_data(), block->raw_size());
             res->pop(block->raw_size() - block->size());
 
             // remove old block
-            buffer_block::free(block);
+            dynamic_free(block);
             return EN_ATBUS_ERR_SUCCESS;
         }
 
-        bool buffer_manager::dynamic_empty() const { return dynamic_buffer_.empty(); }
+        bool buffer_manager::dynamic_empty() const { return NULL == dynamic_buffer_.head_; }
+
+        buffer_block *buffer_manager::dynamic_malloc(size_t s) {
+            if (NULL != block_pool_) {
+                return block_pool_->malloc(s);
+            }
+
+            return buffer_block::malloc(s);
+        }
+
+        void buffer_manager::dynamic_free(buffer_block *p) {
+            if (NULL != block_pool_) {
+                block_pool_->free(p);
+            } else {
+                buffer_block::free(p);
+            }
+        }
+
+        void buffer_manager::dynamic_link_back(buffer_block *p) {
+            p->prev_ = dynamic_buffer_.tail_;
+            p->next_ = NULL;
+            if (NULL == dynamic_buffer_.tail_) {
+                dynamic_buffer_.head_ = p;
+            } else {
+                dynamic_buffer_.tail_->next_ = p;
+            }
+            dynamic_buffer_.tail_ = p;
+        }
+
+        void buffer_manager::dynamic_link_front(buffer_block *p) {
+            p->prev_ = NULL;
+            p->next_ = dynamic_buffer_.head_;
+            if (NULL == dynamic_buffer_.head_) {
+                dynamic_buffer_.tail_ = p;
+            } else {
+                dynamic_buffer_.head_->prev_ = p;
+            }
+            dynamic_buffer_.head_ = p;
+        }
+
+        void buffer_manager::dynamic_unlink(buffer_block *p) {
+            if (NULL == p->prev_) {
+                assert(dynamic_buffer_.head_ == p);
+                dynamic_buffer_.head_ = p->next_;
+            } else {
+                p->prev_->next_ = p->next_;
+            }
+
+            if (NULL == p->next_) {
+                assert(dynamic_buffer_.tail_ == p);
+                dynamic_buffer_.tail_ = p->prev_;
+            } else {
+                p->next_->prev_ = p->prev_;
+            }
+
+            p->prev_ = NULL;
+            p->next_ = NULL;
+        }
+
+        void buffer_manager::dynamic_replace(buffer_block *old_block, buffer_block *new_block) {
+            new_block->prev_ = old_block->prev_;
+            new_block->next_ = old_block->next_;
+
+            if (NULL == old_block->prev_) {
+                dynamic_buffer_.head_ = new_block;
+            } else {
+                old_block->prev_->next_ = new_block;
+            }
+
+            if (NULL == old_block->next_) {
+                dynamic_buffer_.tail_ = new_block;
+            } else {
+                old_block->next_->prev_ = new_block;
+            }
+
+            old_block->prev_ = NULL;
+            old_block->next_ = NULL;
+        }
+
+        bool buffer_manager::set_block_pool(buffer_block_pool *pool) {
+            if (!dynamic_empty()) {
+                return false;
+            }
+
+            block_pool_ = pool;
+            return true;
+        }
 
         void buffer_manager::reset() {
             static_buffer_.head_ = 0;
             static_buffer_.tail_ = 0;
             static_buffer_.size_ = 0;
+            static_buffer_.overflow_size_ = 0;
             static_buffer_.circle_index_.clear();
             if (NULL != static_buffer_.buffer_) {
                 ::free(static_buffer_.buffer_);
@@ -932,10 +1268,12 @@ namespace atbus {
             }
 
             // dynamic buffers
-            while (!dynamic_buffer_.empty()) {
-                buffer_block::free(dynamic_buffer_.front());
-                dynamic_buffer_.pop_front();
+            while (NULL != dynamic_buffer_.head_) {
+                buffer_block *t = dynamic_buffer_.head_;
+                dynamic_buffer_.head_ = t->next_;
+                dynamic_free(t);
             }
+            dynamic_buffer_.tail_ = NULL;
 
             limit_.cost_size_ = 0;
             limit_.cost_number_ = 0;
@@ -943,7 +1281,7 @@ namespace atbus {
             limit_.limit_size_ = 0;
         }
 
-        void buffer_manager::set_mode(size_t max_size, size_t max_number) {
+        void buffer_manager::set_mode(size_t max_size, size_t max_number, size_t overflow_size) {
             reset();
 
             if (0 != max_size && max_number > 0) {
@@ -956,6 +1294,13 @@ namespace atbus {
                     static_buffer_.circle_index_.resize(max_number + 1, NULL);
                     limit_.limit_size_ = max_size;
                     limit_.limit_number_ = max_number;
+
+                    // 溢出块的数量不限制，只限制总大小
+                    if (overflow_size > 0) {
+                        static_buffer_.overflow_size_ = overflow_size;
+                        limit_.limit_size_ += overflow_size;
+                        limit_.limit_number_ = 0;
+                    }
                 }
             }
         }
@@ -0,0 +1,46 @@
+#include "detail/endpoint_index.h"
+
+#include "atbus_endpoint.h"
+
+namespace atbus {
+    namespace detail {
+        endpoint *find_child(const endpoint_index_t &index, ATBUS_MACRO_BUSID_TYPE id) {
+            // key 保存为子域上界，所以第一个查找的节点要么直接是value，要么是value的子节点
+            // 二分查找第一个key不小于id的节点，等同于std::map::lower_bound
+            size_t left = 0;
+            size_t right = index.size();
+            while (left < right) {
+                size_t mid = left + (right - left) / 2;
+                if (index[mid].first < id) {
+                    left = mid + 1;
+                } else {
+                    right = mid;
+                }
+            }
+
+            if (left >= index.size()) {
+                return NULL;
+            }
+
+            endpoint *res = index[left].second;
+            if (res->get_id() == id) {
+                return res;
+            }
+
+            // 不能直接发送到间接子节点，所以直接发给直接子节点由其转发即可
+            if (res->is_child_node(id)) {
+                return res;
+            }
+
+            return NULL;
+        }
+
+        void rebuild_endpoint_index(const endpoint_collection_t &coll, endpoint_index_t &index) {
+            index.clear();
+            index.reserve(coll.size());
+            for (endpoint_collection_t::const_iterator iter = coll.begin(); iter != coll.end(); ++iter) {
+                index.push_back(std::make_pair(iter->first, iter->second.get()));
+            }
+        }
+    }
+}
@@ -0,0 +1,220 @@
+#include <cstring>
+
+#include "detail/libatbus_error.h"
+#include "detail/lz_codec.h"
+
+namespace atbus {
+    namespace detail {
+        namespace lz {
+            // 最短匹配长度
+#define ATBUS_LZ_MIN_MATCH 4
+            // 末尾至少保留的字面量长度
+#define ATBUS_LZ_LAST_LITERALS 5
+            // 最后一个匹配的起始位置离结尾的最小距离
+#define ATBUS_LZ_MF_LIMIT 12
+#define ATBUS_LZ_MAX_DISTANCE 65535
+#define ATBUS_LZ_HASH_LOG 12
+#define ATBUS_LZ_SKIP_TRIGGER 6
+
+            static inline uint32_t read_u32(const unsigned char *p) {
+                uint32_t ret;
+                memcpy(&ret, p, sizeof(ret));
+                return ret;
+            }
+
+            static inline uint32_t hash_u32(uint32_t seq) { return (seq * 2654435761U) >> (32 - ATBUS_LZ_HASH_LOG); }
+
+            static inline unsigned char *write_len(unsigned char *op, size_t len) {
+                while (len >= 255) {
+                    *op++ = 255;
+                    len -= 255;
+                }
+                *op++ = static_cast<unsigned char>(len);
+                return op;
+            }
+
+            static inline bool read_len(const unsigned char *&ip, const unsigned char *iend, size_t &len) {
+                unsigned char c;
+                do {
+                    if (ip >= iend) {
+                        return false;
+                    }
+                    c = *ip++;
+                    len += c;
+                } while (255 == c);
+
+                return true;
+            }
+
+            // 输出一个序列，match_len为0时表示最后的纯字面量序列
+            static unsigned char *write_sequence(unsigned char *op, unsigned char *oend, const unsigned char *literal, size_t literal_len,
+                                                 size_t offset, size_t match_len) {
+                // token + 字面量长度扩展 + 字面量 + offset + 匹配长度扩展
+                size_t need = 1 + literal_len / 255 + 1 + literal_len + 2 + match_len / 255 + 1;
+                if (static_cast<size_t>(oend - op) < need) {
+                    return NULL;
+                }
+
+                unsigned char *token = op++;
+                if (literal_len >= 15) {
+                    *token = 15 << 4;
+                    op = write_len(op, literal_len - 15);
+                } else {
+                    *token = static_cast<unsigned char>(literal_len << 4);
+                }
+
+                if (literal_len > 0) {
+                    memcpy(op, literal, literal_len);
+                    op += literal_len;
+                }
+
+                if (0 == match_len) {
+                    return op;
+                }
+
+                *op++ = static_cast<unsigned char>(offset & 0xFF);
+                *op++ = static_cast<unsigned char>((offset >> 8) & 0xFF);
+
+                match_len -= ATBUS_LZ_MIN_MATCH;
+                if (match_len >= 15) {
+                    *token |= 15;
+                    op = write_len(op, match_len - 15);
+                } else {
+                    *token |= static_cast<unsigned char>(match_len);
+                }
+
+                return op;
+            }
+
+            size_t compress_bound(size_t in_len) { return in_len + in_len / 255 + 16; }
+
+            size_t compress(const void *in, size_t in_len, void *out, size_t out_len) {
+                const unsigned char *src = reinterpret_cast<const unsigned char *>(in);
+                const unsigned char *ip = src;
+                const unsigned char *anchor = src;
+                const unsigned char *iend = src + in_len;
+                unsigned char *op = reinterpret_cast<unsigned char *>(out);
+                unsigned char *oend = op + out_len;
+
+                if ((NULL == in && in_len > 0) || NULL == out) {
+                    return 0;
+                }
+
+                if (in_len > ATBUS_LZ_MF_LIMIT) {
+                    const unsigned char *mflimit = iend - ATBUS_LZ_MF_LIMIT;
+                    const unsigned char *matchlimit = iend - ATBUS_LZ_LAST_LITERALS;
+                    uint32_t hash_table[1 << ATBUS_LZ_HASH_LOG];
+                    memset(hash_table, 0, sizeof(hash_table));
+
+                    while (ip < mflimit) {
+                        uint32_t seq = read_u32(ip);
+                        uint32_t h = hash_u32(seq);
+                        const unsigned char *ref = src + hash_table[h];
+                        hash_table[h] = static_cast<uint32_t>(ip - src);
+
+                        if (ref >= ip || static_cast<size_t>(ip - ref) > ATBUS_LZ_MAX_DISTANCE || read_u32(ref) != seq) {
+                            // 连续未命中时加快步进，不可压缩的数据可以更快地跳过
+                            ip += 1 + ((ip - anchor) >> ATBUS_LZ_SKIP_TRIGGER);
+                            continue;
+                        }
+
+                        size_t match_len = ATBUS_LZ_MIN_MATCH;
+                        while (ip + match_len < matchlimit && ref[match_len] == ip[match_len]) {
+                            ++match_len;
+                        }
+
+                        op = write_sequence(op, oend, anchor, static_cast<size_t>(ip - anchor), static_cast<size_t>(ip - ref), match_len);
+                        if (NULL == op) {
+                            return 0;
+                        }
+
+                        ip += match_len;
+                        anchor = ip;
+                    }
+                }
+
+                op = write_sequence(op, oend, anchor, static_cast<size_t>(iend - anchor), 0, 0);
+                if (NULL == op) {
+                    return 0;
+                }
+
+                return static_cast<size_t>(op - reinterpret_cast<unsigned char *>(out));
+            }
+
+            int decompress(const void *in, size_t in_len, void *out, size_t out_len) {
+                const unsigned char *ip = reinterpret_cast<const unsigned char *>(in);
+                const unsigned char *iend = ip + in_len;
+                unsigned char *dst = reinterpret_cast<unsigned char *>(out);
+                unsigned char *op = dst;
+                unsigned char *oend = dst + out_len;
+
+                if (NULL == in || (NULL == out && out_len > 0)) {
+                    return EN_ATBUS_ERR_PARAMS;
+                }
+
+                while (true) {
+                    if (ip >= iend) {
+                        return EN_ATBUS_ERR_BAD_DATA;
+                    }
+
+                    unsigned char token = *ip++;
+                    size_t literal_len = token >> 4;
+                    if (15 == literal_len && !read_len(ip, iend, literal_len)) {
+                        return EN_ATBUS_ERR_BAD_DATA;
+                    }
+
+                    if (literal_len > static_cast<size_t>(iend - ip) || literal_len > static_cast<size_t>(oend - op)) {
+                        return EN_ATBUS_ERR_BAD_DATA;
+                    }
+
+                    memcpy(op, ip, literal_len);
+                    op += literal_len;
+                    ip += literal_len;
+
+                    // 最后一个序列只有字面量
+                    if (ip == iend) {
+                        break;
+                    }
+
+                    if (iend - ip < 2) {
+                        return EN_ATBUS_ERR_BAD_DATA;
+                    }
+                    size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+                    ip += 2;
+                    if (0 == offset || offset > static_cast<size_t>(op - dst)) {
+                        return EN_ATBUS_ERR_BAD_DATA;
+                    }
+
+                    size_t match_len = token & 0x0F;
+                    if (15 == match_len && !read_len(ip, iend, match_len)) {
+                        return EN_ATBUS_ERR_BAD_DATA;
+                    }
+                    match_len += ATBUS_LZ_MIN_MATCH;
+
+                    if (match_len > static_cast<size_t>(oend - op)) {
+                        return EN_ATBUS_ERR_BAD_DATA;
+                    }
+
+                    // 匹配区域可能和输出区域重叠，必须逐字节复制
+                    const unsigned char *ref = op - offset;
+                    if (offset >= match_len) {
+                        memcpy(op, ref, match_len);
+                        op += match_len;
+                    } else {
+                        while (match_len-- > 0) {
+                            *op++ = *ref++;
+                        }
+                    }
+                }
+
+                return op == oend ? EN_ATBUS_ERR_SUCCESS : EN_ATBUS_ERR_BAD_DATA;
+            }
+#undef ATBUS_LZ_MIN_MATCH
+#undef ATBUS_LZ_LAST_LITERALS
+#undef ATBUS_LZ_MF_LIMIT
+#undef ATBUS_LZ_MAX_DISTANCE
+#undef ATBUS_LZ_HASH_LOG
+#undef ATBUS_LZ_SKIP_TRIGGER
+        }
+    }
+}
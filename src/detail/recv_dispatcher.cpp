@@ -0,0 +1,209 @@
+#include <cstring>
+
+#include "detail/libatbus_error.h"
+#include "detail/recv_dispatcher.h"
+
+#if defined(ATBUS_MACRO_ENABLE_STD_THREAD) && ATBUS_MACRO_ENABLE_STD_THREAD
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace atbus {
+    namespace detail {
+#if defined(ATBUS_MACRO_ENABLE_STD_THREAD) && ATBUS_MACRO_ENABLE_STD_THREAD
+        struct recv_dispatcher_worker {
+            std::thread thd;
+            std::mutex lock;
+            std::condition_variable cond;
+            std::list<recv_dispatcher::job_t> jobs;
+            recv_dispatcher::credit_list_t credits; // 已处理完可以归还的流控窗口
+            bool closing;
+
+            recv_dispatcher_worker() : closing(false) {}
+        };
+#else
+        struct recv_dispatcher_worker {};
+#endif
+
+        recv_dispatcher::recv_dispatcher() : handle_fn_(NULL), priv_data_(NULL), pushed_count_(0) { completed_count_.store(0); }
+
+        recv_dispatcher::~recv_dispatcher() { stop(); }
+
+        int recv_dispatcher::start(size_t worker_number, handle_fn_t fn, void *priv_data) {
+            if (0 == worker_number || NULL == fn) {
+                return EN_ATBUS_ERR_PARAMS;
+            }
+
+            if (is_running()) {
+                return EN_ATBUS_ERR_ALREADY_INITED;
+            }
+
+#if defined(ATBUS_MACRO_ENABLE_STD_THREAD) && ATBUS_MACRO_ENABLE_STD_THREAD
+            handle_fn_ = fn;
+            priv_data_ = priv_data;
+            pushed_count_ = 0;
+            completed_count_.store(0);
+
+            workers_.reserve(worker_number);
+            for (size_t i = 0; i < worker_number; ++i) {
+                recv_dispatcher_worker *worker = new recv_dispatcher_worker();
+                workers_.push_back(worker);
+                worker->thd = std::thread(worker_main, this, worker);
+            }
+
+            return EN_ATBUS_ERR_SUCCESS;
+#else
+            return EN_ATBUS_ERR_NOT_SUPPORT;
+#endif
+        }
+
+        void recv_dispatcher::stop() {
+#if defined(ATBUS_MACRO_ENABLE_STD_THREAD) && ATBUS_MACRO_ENABLE_STD_THREAD
+            for (size_t i = 0; i < workers_.size(); ++i) {
+                {
+                    std::lock_guard<std::mutex> lock_guard(workers_[i]->lock);
+                    workers_[i]->closing = true;
+                }
+                workers_[i]->cond.notify_all();
+            }
+
+            // 工作线程会先处理完剩余的消息再退出
+            for (size_t i = 0; i < workers_.size(); ++i) {
+                if (workers_[i]->thd.joinable()) {
+                    workers_[i]->thd.join();
+                }
+                delete workers_[i];
+            }
+#endif
+            workers_.clear();
+        }
+
+        int recv_dispatcher::push(ATBUS_MACRO_BUSID_TYPE key, const protocol::msg_head &head, int flags, ATBUS_MACRO_BUSID_TYPE from,
+                                  ATBUS_MACRO_BUSID_TYPE to, const void *buffer, size_t s) {
+#if defined(ATBUS_MACRO_ENABLE_STD_THREAD) && ATBUS_MACRO_ENABLE_STD_THREAD
+            if (workers_.empty()) {
+                return EN_ATBUS_ERR_NOT_INITED;
+            }
+
+            // 在锁外构造并复制数据，加锁时只做链表拼接
+            std::list<job_t> job_ls;
+            job_ls.push_back(job_t());
+            job_t &job = job_ls.back();
+            job.head = head;
+            job.flags = flags;
+            job.from = from;
+            job.to = to;
+            job.credit_only = false;
+            job.credit_count = 0;
+            if (NULL != buffer && s > 0) {
+                job.data.resize(s);
+                memcpy(&job.data[0], buffer, s);
+            }
+
+            recv_dispatcher_worker *worker = workers_[static_cast<size_t>(key % workers_.size())];
+            {
+                std::lock_guard<std::mutex> lock_guard(worker->lock);
+                worker->jobs.splice(worker->jobs.end(), job_ls);
+            }
+            worker->cond.notify_one();
+
+            ++pushed_count_;
+            return EN_ATBUS_ERR_SUCCESS;
+#else
+            return EN_ATBUS_ERR_NOT_SUPPORT;
+#endif
+        }
+
+        int recv_dispatcher::push_credit(ATBUS_MACRO_BUSID_TYPE key, uint32_t count) {
+#if defined(ATBUS_MACRO_ENABLE_STD_THREAD) && ATBUS_MACRO_ENABLE_STD_THREAD
+            if (workers_.empty()) {
+                return EN_ATBUS_ERR_NOT_INITED;
+            }
+
+            std::list<job_t> job_ls;
+            job_ls.push_back(job_t());
+            job_t &job = job_ls.back();
+            job.flags = 0;
+            job.from = key;
+            job.to = 0;
+            job.credit_only = true;
+            job.credit_count = count;
+
+            recv_dispatcher_worker *worker = workers_[static_cast<size_t>(key % workers_.size())];
+            {
+                std::lock_guard<std::mutex> lock_guard(worker->lock);
+                worker->jobs.splice(worker->jobs.end(), job_ls);
+            }
+            worker->cond.notify_one();
+            return EN_ATBUS_ERR_SUCCESS;
+#else
+            return EN_ATBUS_ERR_NOT_SUPPORT;
+#endif
+        }
+
+        void recv_dispatcher::pop_credits(credit_list_t &out) {
+#if defined(ATBUS_MACRO_ENABLE_STD_THREAD) && ATBUS_MACRO_ENABLE_STD_THREAD
+            for (size_t i = 0; i < workers_.size(); ++i) {
+                std::lock_guard<std::mutex> lock_guard(workers_[i]->lock);
+                if (workers_[i]->credits.empty()) {
+                    continue;
+                }
+
+                if (out.empty()) {
+                    out.swap(workers_[i]->credits);
+                } else {
+                    out.insert(out.end(), workers_[i]->credits.begin(), workers_[i]->credits.end());
+                    workers_[i]->credits.clear();
+                }
+            }
+#endif
+        }
+
+        size_t recv_dispatcher::get_pending() const {
+            size_t completed = completed_count_.load();
+            return pushed_count_ > completed ? pushed_count_ - completed : 0;
+        }
+
+        size_t recv_dispatcher::get_completed() const { return completed_count_.load(); }
+
+        void recv_dispatcher::worker_main(recv_dispatcher *self, recv_dispatcher_worker *worker) {
+#if defined(ATBUS_MACRO_ENABLE_STD_THREAD) && ATBUS_MACRO_ENABLE_STD_THREAD
+            std::list<job_t> job_ls;
+            credit_list_t credits;
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock_guard(worker->lock);
+                    while (worker->jobs.empty() && !worker->closing) {
+                        worker->cond.wait(lock_guard);
+                    }
+
+                    if (worker->jobs.empty()) {
+                        break;
+                    }
+
+                    job_ls.swap(worker->jobs);
+                }
+
+                for (std::list<job_t>::iterator iter = job_ls.begin(); iter != job_ls.end(); ++iter) {
+                    if (iter->credit_only) {
+                        credits.push_back(std::make_pair(iter->from, iter->credit_count));
+                        continue;
+                    }
+
+                    self->handle_fn_(self->priv_data_, *iter);
+                    ++self->completed_count_;
+                }
+                job_ls.clear();
+
+                // 这一批消息都处理完了才归还流控窗口
+                if (!credits.empty()) {
+                    std::lock_guard<std::mutex> lock_guard(worker->lock);
+                    worker->credits.insert(worker->credits.end(), credits.begin(), credits.end());
+                    credits.clear();
+                }
+            }
+#endif
+        }
+    }
+}
@@ -0,0 +1,176 @@
+﻿#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+#include "common/string_oprs.h"
+
+#ifdef max
+#undef max
+#endif
+
+#ifdef min
+#undef min
+#endif
+
+#include <atbus_node.h>
+
+#include "detail/libatbus_protocol.h"
+
+#include "frame/test_macros.h"
+
+// 统计堆内存分配次数，用于检查接收路径的内存复用
+// 替换全局operator new会影响整个可执行程序，所以这个文件单独编译成atbus_alloc_test
+static std::atomic<size_t> g_atbus_alloc_test_counter(0);
+
+void *operator new(std::size_t sz) {
+    ++g_atbus_alloc_test_counter;
+    void *ret = malloc(0 == sz ? 1 : sz);
+    if (NULL == ret) {
+        throw std::bad_alloc();
+    }
+    return ret;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+static std::string atbus_alloc_test_pack_data_msg(atbus::node::bus_id_t to, const char *data, size_t len) {
+    atbus::protocol::msg m;
+    m.init(0x12345679, ATBUS_CMD_DATA_TRANSFORM_REQ, 0, 0, 1);
+    m.body.make_forward(0x12345679, to, data, len);
+
+    std::stringstream ss;
+    msgpack::pack(ss, m);
+    return ss.str();
+}
+
+static size_t g_atbus_alloc_test_recv_count = 0;
+
+static int atbus_alloc_test_on_recv(const atbus::node &, const atbus::endpoint *, const atbus::connection *, const atbus::protocol::msg &,
+                                    const void *, size_t) {
+    ++g_atbus_alloc_test_recv_count;
+    return 0;
+}
+
+CASE_TEST(atbus_alloc, msg_unpacker) {
+    atbus::protocol::msg m_src;
+    std::string packed_buffer;
+    char test_buffer[] = "hello world!";
+
+    {
+        m_src.init(0x12345678, ATBUS_CMD_DATA_TRANSFORM_REQ, 123, 0, 13);
+        m_src.body.make_forward(456, 789, test_buffer, sizeof(test_buffer));
+        m_src.body.forward->router.push_back(210);
+        m_src.body.forward->router.push_back(211);
+
+        std::stringstream ss;
+        msgpack::pack(ss, m_src);
+        packed_buffer = ss.str();
+    }
+
+    const size_t loop_times = 128;
+    size_t success_times = 0;
+
+    // 每次都新建zone和消息对象
+    size_t alloc_before = g_atbus_alloc_test_counter.load();
+    for (size_t i = 0; i < loop_times; ++i) {
+        msgpack::unpacked result;
+        atbus::protocol::msg m;
+        msgpack::unpack(result, packed_buffer.data(), packed_buffer.size());
+        result.get().convert(m);
+        if (NULL != m.body.forward && 2 == m.body.forward->router.size()) {
+            ++success_times;
+        }
+    }
+    size_t alloc_once = g_atbus_alloc_test_counter.load() - alloc_before;
+    CASE_EXPECT_EQ(loop_times, success_times);
+
+    // 复用解包器，第一次之后不应该再分配内存
+    atbus::protocol::msg_unpacker unpacker;
+    CASE_EXPECT_NE(NULL, unpacker.unpack(packed_buffer.data(), packed_buffer.size()));
+
+    success_times = 0;
+    alloc_before = g_atbus_alloc_test_counter.load();
+    for (size_t i = 0; i < loop_times; ++i) {
+        atbus::protocol::msg *m = unpacker.unpack(packed_buffer.data(), packed_buffer.size());
+        if (NULL != m && NULL != m->body.forward && 2 == m->body.forward->router.size()) {
+            ++success_times;
+        }
+    }
+    size_t alloc_reuse = g_atbus_alloc_test_counter.load() - alloc_before;
+
+    CASE_EXPECT_EQ(loop_times, success_times);
+    CASE_EXPECT_EQ(0, alloc_reuse);
+    CASE_EXPECT_GT(alloc_once, alloc_reuse);
+    CASE_MSG_INFO() << "unpack " << loop_times << " messages, heap allocations: " << alloc_once << " without reuse, " << alloc_reuse
+                    << " with msg_unpacker" << std::endl;
+
+    unpacker.release();
+}
+
+// 经由内存通道的完整接收路径(connection::unpack_and_dispatch)不应该每条消息都分配内存
+CASE_TEST(atbus_alloc, recv_mem_channel) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.recv_buffer_size = 256 * 1024;
+
+    char *buffer = new char[conf.recv_buffer_size];
+    memset(buffer, 0, conf.recv_buffer_size);
+
+    char addr[32] = {0};
+    UTIL_STRFUNC_SNPRINTF(addr, sizeof(addr), "mem://0x%p", buffer);
+    if (addr[8] == '0' && addr[9] == 'x') {
+        memset(addr, 0, sizeof(addr));
+        UTIL_STRFUNC_SNPRINTF(addr, sizeof(addr), "mem://%p", buffer);
+    }
+
+    {
+        atbus::node::ptr_t node = atbus::node::create();
+        node->init(0x12345678, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node->listen(addr));
+        node->set_on_recv_handle(atbus_alloc_test_on_recv);
+
+        atbus::channel::mem_channel *channel = NULL;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, atbus::channel::mem_attach(buffer, conf.recv_buffer_size, &channel, NULL));
+        if (NULL == channel) {
+            delete[] buffer;
+            return;
+        }
+
+        char test_buffer[] = "recv through mem channel";
+        std::string packed_buffer = atbus_alloc_test_pack_data_msg(node->get_id(), test_buffer, sizeof(test_buffer));
+
+        const size_t loop_times = 64;
+        time_t proc_t = time(NULL);
+
+        // 第一轮让解包器和节点内部的缓冲区完成初始化
+        g_atbus_alloc_test_recv_count = 0;
+        for (size_t i = 0; i < loop_times; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, atbus::channel::mem_send(channel, packed_buffer.data(), packed_buffer.size()));
+        }
+        node->proc(proc_t, 0);
+        CASE_EXPECT_EQ(loop_times, g_atbus_alloc_test_recv_count);
+
+        g_atbus_alloc_test_recv_count = 0;
+        for (size_t i = 0; i < loop_times; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, atbus::channel::mem_send(channel, packed_buffer.data(), packed_buffer.size()));
+        }
+
+        size_t alloc_before = g_atbus_alloc_test_counter.load();
+        node->proc(proc_t, 0);
+        size_t alloc_recv = g_atbus_alloc_test_counter.load() - alloc_before;
+
+        // 预热后解包器的zone和消息体、节点的静态缓冲区都已经就绪，稳定状态下接收不应该再分配内存
+        CASE_EXPECT_EQ(loop_times, g_atbus_alloc_test_recv_count);
+        CASE_EXPECT_EQ(0, alloc_recv);
+        CASE_MSG_INFO() << "receive " << loop_times << " messages through mem channel, heap allocations: " << alloc_recv << std::endl;
+
+        node->reset();
+    }
+
+    delete[] buffer;
+}
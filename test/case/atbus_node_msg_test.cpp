@@ -2,7 +2,9 @@
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 #include "common/string_oprs.h"
 
@@ -418,6 +420,257 @@ CASE_TEST(atbus_node_msg, send_msg_to_self_and_need_rsp) {
     unit_test_setup_exit(&ev_loop);
 }
 
+// 内存通道收到的消息引用接收缓冲区，回调里调用proc不能覆盖正在处理的消息
+CASE_TEST(atbus_node_msg, mem_recv_proc_in_callback) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.recv_buffer_size = 64 * 1024;
+
+    char *buffer = new char[conf.recv_buffer_size];
+    memset(buffer, 0, conf.recv_buffer_size);
+
+    char addr[32] = {0};
+    UTIL_STRFUNC_SNPRINTF(addr, sizeof(addr), "mem://0x%p", buffer);
+    if (addr[8] == '0' && addr[9] == 'x') {
+        memset(addr, 0, sizeof(addr));
+        UTIL_STRFUNC_SNPRINTF(addr, sizeof(addr), "mem://%p", buffer);
+    }
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node1->set_on_error_handle(node_msg_test_on_error);
+        node1->init(0x12345678, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen(addr));
+
+        atbus::channel::mem_channel *channel = NULL;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, atbus::channel::mem_attach(buffer, conf.recv_buffer_size, &channel, NULL));
+
+        std::string send_data[2] = {"mem recv message 1", "mem recv message 2"};
+        for (int i = 0; NULL != channel && i < 2; ++i) {
+            atbus::protocol::msg m;
+            m.init(0x12345679, ATBUS_CMD_DATA_TRANSFORM_REQ, 0, 0, static_cast<uint32_t>(i + 1));
+            m.body.make_forward(0x12345679, node1->get_id(), send_data[i].data(), send_data[i].size());
+
+            std::stringstream ss;
+            msgpack::pack(ss, m);
+            std::string packed = ss.str();
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, atbus::channel::mem_send(channel, packed.data(), packed.size()));
+        }
+
+        time_t proc_t = time(NULL);
+        std::vector<std::string> recv_data;
+        int nested_proc_ret = -1;
+        node1->set_on_recv_handle([&node1, &recv_data, &nested_proc_ret, proc_t](const atbus::node &, const atbus::endpoint *,
+                                                                                  const atbus::connection *, const atbus::protocol::msg &,
+                                                                                  const void *buf, size_t len) {
+            std::string data(reinterpret_cast<const char *>(buf), len);
+            if (recv_data.empty()) {
+                nested_proc_ret = node1->proc(proc_t, 0);
+            }
+
+            // 嵌套的proc返回后，本条消息的数据仍然有效
+            CASE_EXPECT_EQ(data, std::string(reinterpret_cast<const char *>(buf), len));
+            recv_data.push_back(data);
+            return 0;
+        });
+
+        node1->proc(proc_t, 0);
+
+        // 第二条消息在外层的proc中收取
+        CASE_EXPECT_EQ(0, nested_proc_ret);
+        CASE_EXPECT_EQ(2, recv_data.size());
+        if (2 == recv_data.size()) {
+            CASE_EXPECT_EQ(send_data[0], recv_data[0]);
+            CASE_EXPECT_EQ(send_data[1], recv_data[1]);
+        }
+
+        node1->reset();
+    }
+
+    delete[] buffer;
+}
+
+#if defined(ATBUS_MACRO_ENABLE_STD_THREAD) && ATBUS_MACRO_ENABLE_STD_THREAD
+struct node_msg_test_dispatch_record_t {
+    std::mutex lock;
+    std::string data;
+    int count;
+    int io_thread_count;
+    int bad_param_count; // 工作线程里不能使用CASE_EXPECT_*，记录下来在主线程检查
+    bool blocked;        // 为true时工作线程在回调里等待
+    std::thread::id io_thread_id;
+};
+
+static node_msg_test_dispatch_record_t dispatch_msg_history;
+
+static void node_msg_test_dispatch_reset(bool blocked) {
+    std::lock_guard<std::mutex> lock_guard(dispatch_msg_history.lock);
+    dispatch_msg_history.data.clear();
+    dispatch_msg_history.count = 0;
+    dispatch_msg_history.io_thread_count = 0;
+    dispatch_msg_history.bad_param_count = 0;
+    dispatch_msg_history.blocked = blocked;
+    dispatch_msg_history.io_thread_id = std::this_thread::get_id();
+}
+
+static int node_msg_test_recv_msg_dispatch_fn(const atbus::node &, const atbus::endpoint *ep, const atbus::connection *conn,
+                                              const atbus::protocol::msg &m, const void *buffer, size_t len) {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock_guard(dispatch_msg_history.lock);
+            if (!dispatch_msg_history.blocked) {
+                break;
+            }
+        }
+        CASE_THREAD_SLEEP_MS(1);
+    }
+
+    std::lock_guard<std::mutex> lock_guard(dispatch_msg_history.lock);
+    ++dispatch_msg_history.count;
+    if (std::this_thread::get_id() == dispatch_msg_history.io_thread_id) {
+        ++dispatch_msg_history.io_thread_count;
+    }
+
+    // 分发线程中不传递endpoint和connection，来源节点ID从forward->from获取
+    if (NULL != ep || NULL != conn || ATBUS_CMD_DATA_TRANSFORM_REQ != m.head.cmd || NULL == m.body.forward ||
+        0x12345678 != m.body.forward->from) {
+        ++dispatch_msg_history.bad_param_count;
+    }
+    if (NULL != buffer && len > 0) {
+        dispatch_msg_history.data.append(reinterpret_cast<const char *>(buffer), len);
+    }
+    return 0;
+}
+
+// 分发线程池接收数据测试
+CASE_TEST(atbus_node_msg, dispatch_workers) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.dispatch_workers = 2;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node1->set_on_error_handle(node_msg_test_on_error);
+
+        node1->init(0x12345678, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->poll();
+        node1->proc(proc_t, 0);
+
+        node_msg_test_dispatch_reset(false);
+        node1->set_on_recv_handle(node_msg_test_recv_msg_dispatch_fn);
+
+        // 同一个来源的消息必须保证时序
+        std::string expect_data;
+        for (int i = 0; i < 16; ++i) {
+            std::stringstream ss;
+            ss << "dispatch-" << i << ";";
+            std::string send_data = ss.str();
+            expect_data += send_data;
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->send_data(node1->get_id(), 0, send_data.data(), send_data.size()));
+        }
+
+        for (int i = 0; i < 1000; ++i) {
+            {
+                std::lock_guard<std::mutex> lock_guard(dispatch_msg_history.lock);
+                if (dispatch_msg_history.count >= 16) {
+                    break;
+                }
+            }
+
+            CASE_THREAD_SLEEP_MS(4);
+            node1->proc(++proc_t, 0);
+        }
+
+        std::lock_guard<std::mutex> lock_guard(dispatch_msg_history.lock);
+        CASE_EXPECT_EQ(16, dispatch_msg_history.count);
+        CASE_EXPECT_EQ(0, dispatch_msg_history.io_thread_count);
+        CASE_EXPECT_EQ(0, dispatch_msg_history.bad_param_count);
+        CASE_EXPECT_EQ(expect_data, dispatch_msg_history.data);
+        CASE_EXPECT_GT(node1->get_recv_loop_times(), 0);
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 分发队列积压到上限时停止拉取网络数据，处理完后恢复
+CASE_TEST(atbus_node_msg, dispatch_pending_limit) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.dispatch_workers = 1;
+    conf.dispatch_pending_limit = 4;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node1->set_on_error_handle(node_msg_test_on_error);
+
+        node1->init(0x12345678, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->poll();
+        node1->proc(proc_t, 0);
+
+        // 工作线程阻塞在回调里，投递的消息全部积压
+        node_msg_test_dispatch_reset(true);
+        node1->set_on_recv_handle(node_msg_test_recv_msg_dispatch_fn);
+        CASE_EXPECT_EQ(conf.loop_times, node1->get_recv_loop_times());
+
+        std::string send_data = "pending;";
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->send_data(node1->get_id(), 0, send_data.data(), send_data.size()));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->send_data(node1->get_id(), 0, send_data.data(), send_data.size()));
+        node1->proc(++proc_t, 0);
+
+        // 积压一半时拉取次数减半
+        CASE_EXPECT_EQ(conf.loop_times / 2, node1->get_recv_loop_times());
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->send_data(node1->get_id(), 0, send_data.data(), send_data.size()));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->send_data(node1->get_id(), 0, send_data.data(), send_data.size()));
+        node1->proc(++proc_t, 0);
+
+        // 积压达到上限时不再拉取
+        CASE_EXPECT_EQ(0, node1->get_recv_loop_times());
+        CASE_EXPECT_EQ(0, node1->poll());
+
+        {
+            std::lock_guard<std::mutex> lock_guard(dispatch_msg_history.lock);
+            CASE_EXPECT_EQ(0, dispatch_msg_history.count);
+            dispatch_msg_history.blocked = false;
+        }
+
+        for (int i = 0; i < 1000 && node1->get_recv_loop_times() < conf.loop_times; ++i) {
+            CASE_THREAD_SLEEP_MS(4);
+            node1->proc(++proc_t, 0);
+        }
+
+        CASE_EXPECT_EQ(conf.loop_times, node1->get_recv_loop_times());
+
+        std::lock_guard<std::mutex> lock_guard(dispatch_msg_history.lock);
+        CASE_EXPECT_EQ(4, dispatch_msg_history.count);
+        CASE_EXPECT_EQ(0, dispatch_msg_history.io_thread_count);
+        CASE_EXPECT_EQ(0, dispatch_msg_history.bad_param_count);
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+#endif
+
 
 // 父子节点消息转发测试
 CASE_TEST(atbus_node_msg, parent_and_child) {
@@ -768,6 +1021,985 @@ CASE_TEST(atbus_node_msg, transfer_failed) {
     unit_test_setup_exit(&ev_loop);
 }
 
+static int node_msg_test_writable_count = 0;
+static int node_msg_test_on_writable_fn(const atbus::node &, const atbus::endpoint *, const atbus::connection *) {
+    ++node_msg_test_writable_count;
+    return 0;
+}
+
+// 流控窗口测试
+CASE_TEST(atbus_node_msg, flow_credit) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.flow_credit_window = 4;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node2->on_debug = node_msg_test_on_debug;
+        node1->set_on_error_handle(node_msg_test_on_error);
+        node2->set_on_error_handle(node_msg_test_on_error);
+
+        node1->init(0x12345678, &conf);
+        node2->init(0x12356789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->poll();
+        node2->poll();
+        node1->proc(proc_t, 0);
+        node2->proc(proc_t, 0);
+
+        node1->connect("ipv4://127.0.0.1:16388");
+
+        // 8s timeout
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node1->is_endpoint_available(node2->get_id()) && node2->is_endpoint_available(node1->get_id()) &&
+                                node1->get_endpoint(node2->get_id())->is_flow_credit_enabled(),
+                            8000, 0) {}
+
+        atbus::endpoint *ep = node1->get_endpoint(node2->get_id());
+        CASE_EXPECT_TRUE(ep->is_flow_credit_enabled());
+        CASE_EXPECT_EQ(4, ep->get_flow_credits());
+
+        node2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node1->set_on_writable_handle(node_msg_test_on_writable_fn);
+        node_msg_test_writable_count = 0;
+
+        std::string send_data;
+        send_data.assign("flow credit\n", sizeof("flow credit\n") - 1);
+
+        int count = recv_msg_history.count;
+        for (int i = 0; i < 4; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->send_data(node2->get_id(), 0, send_data.data(), send_data.size()));
+        }
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_ATNODE_WOULD_BLOCK, node1->send_data(node2->get_id(), 0, send_data.data(), send_data.size()));
+        CASE_EXPECT_TRUE(ep->check_flow_blocked());
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, count + 4 <= recv_msg_history.count && node_msg_test_writable_count > 0, 8000, 0) {}
+
+        CASE_EXPECT_EQ(count + 4, recv_msg_history.count);
+        CASE_EXPECT_EQ(1, node_msg_test_writable_count);
+        CASE_EXPECT_FALSE(ep->check_flow_blocked());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->send_data(node2->get_id(), 0, send_data.data(), send_data.size()));
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 转发的消息不占用中转链路的流控窗口，也不会被归还
+CASE_TEST(atbus_node_msg, flow_credit_relay) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.flow_credit_window = 4;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent_1 = atbus::node::create();
+        atbus::node::ptr_t node_parent_2 = atbus::node::create();
+        atbus::node::ptr_t node_child_1 = atbus::node::create();
+        atbus::node::ptr_t node_child_2 = atbus::node::create();
+        node_parent_1->on_debug = node_msg_test_on_debug;
+        node_parent_2->on_debug = node_msg_test_on_debug;
+        node_child_1->on_debug = node_msg_test_on_debug;
+        node_child_2->on_debug = node_msg_test_on_debug;
+        node_parent_1->set_on_error_handle(node_msg_test_on_error);
+        node_parent_2->set_on_error_handle(node_msg_test_on_error);
+        node_child_1->set_on_error_handle(node_msg_test_on_error);
+        node_child_2->set_on_error_handle(node_msg_test_on_error);
+
+        node_parent_1->init(0x12345678, &conf);
+        node_parent_2->init(0x12356789, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+        conf.father_address = "ipv4://127.0.0.1:16388";
+        node_child_2->init(0x12354678, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16390"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node_child_2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node_parent_1->connect("ipv4://127.0.0.1:16388");
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node_child_1->is_endpoint_available(node_parent_1->get_id()) &&
+                                node_parent_1->is_endpoint_available(node_child_1->get_id()) &&
+                                node_child_2->is_endpoint_available(node_parent_2->get_id()) &&
+                                node_parent_2->is_endpoint_available(node_child_2->get_id()) &&
+                                node_parent_1->is_endpoint_available(node_parent_2->get_id()) &&
+                                node_parent_2->is_endpoint_available(node_parent_1->get_id()) &&
+                                node_child_1->get_endpoint(node_parent_1->get_id())->is_flow_credit_enabled() &&
+                                node_parent_1->get_endpoint(node_parent_2->get_id())->is_flow_credit_enabled(),
+                            8000, 64) {
+            node_parent_1->proc(proc_t, 0);
+            node_parent_2->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+
+            ++proc_t;
+        }
+
+        atbus::endpoint *origin_ep = node_child_1->get_endpoint(node_parent_1->get_id());
+        atbus::endpoint *relay_ep = node_parent_1->get_endpoint(node_parent_2->get_id());
+        CASE_EXPECT_EQ(4, origin_ep->get_flow_credits());
+        CASE_EXPECT_EQ(4, relay_ep->get_flow_credits());
+
+        std::string send_data;
+        send_data.assign("flow credit relay\n", sizeof("flow credit relay\n") - 1);
+
+        // 每次发送半个窗口，等对端归还后再发送
+        int count = recv_msg_history.count;
+        for (int i = 0; i < 4; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size()));
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size()));
+            count += 2;
+
+            UNITTEST_WAIT_UNTIL(conf.ev_loop, count <= recv_msg_history.count && 4 == origin_ep->get_flow_credits(), 8000, 0) {}
+            CASE_EXPECT_EQ(count, recv_msg_history.count);
+            CASE_EXPECT_EQ(4, origin_ep->get_flow_credits());
+        }
+
+        for (int i = 0; i < 64; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(4);
+        }
+
+        // 中转节点之间没有扣减窗口，对端也不能归还
+        CASE_EXPECT_EQ(4, relay_ep->get_flow_credits());
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 数据消息使用定长二进制头
+CASE_TEST(atbus_node_msg, fast_data_head) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_FAST_DATA_HEAD, true);
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_child = atbus::node::create();
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_child->on_debug = node_msg_test_on_debug;
+        node_parent->set_on_error_handle(node_msg_test_on_error);
+        node_child->set_on_error_handle(node_msg_test_on_error);
+
+        node_parent->init(0x12345678, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child->init(0x12346789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->start());
+
+        time_t proc_t = time(NULL) + 1;
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node_child->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_child->get_id()) &&
+                                node_child->get_endpoint(node_parent->get_id())->get_flag(atbus::endpoint::flag_t::FAST_DATA_HEAD) &&
+                                node_parent->get_endpoint(node_child->get_id())->get_flag(atbus::endpoint::flag_t::FAST_DATA_HEAD),
+                            8000, 64) {
+            node_parent->proc(proc_t, 0);
+            node_child->proc(proc_t, 0);
+            ++proc_t;
+        }
+
+        CASE_EXPECT_TRUE(node_child->get_endpoint(node_parent->get_id())->get_flag(atbus::endpoint::flag_t::FAST_DATA_HEAD));
+        CASE_EXPECT_TRUE(node_parent->get_endpoint(node_child->get_id())->get_flag(atbus::endpoint::flag_t::FAST_DATA_HEAD));
+
+        node_child->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node_parent->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+
+        // parent to child
+        {
+            std::string send_data;
+            send_data.assign("parent to child\0fast head\n", sizeof("parent to child\0fast head\n") - 1);
+
+            int count = recv_msg_history.count;
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->send_data(node_child->get_id(), 123, send_data.data(), send_data.size()));
+            UNITTEST_WAIT_UNTIL(conf.ev_loop, count != recv_msg_history.count, 3000, 0) {}
+
+            CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        }
+
+        // child to parent, 需要回包
+        {
+            std::string send_data;
+            send_data.assign("child to parent\0fast head\n", sizeof("child to parent\0fast head\n") - 1);
+
+            int count = recv_msg_history.count;
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                           node_child->send_data(node_parent->get_id(), 123, send_data.data(), send_data.size(), true));
+            UNITTEST_WAIT_UNTIL(conf.ev_loop, count != recv_msg_history.count, 3000, 0) {}
+
+            CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        }
+
+        // 空数据
+        {
+            int count = recv_msg_history.count;
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->send_data(node_child->get_id(), 0, NULL, 0));
+            UNITTEST_WAIT_UNTIL(conf.ev_loop, count != recv_msg_history.count, 3000, 0) {}
+
+            CASE_EXPECT_TRUE(recv_msg_history.data.empty());
+        }
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 定长头的数据消息中转时不解包，直接转发
+CASE_TEST(atbus_node_msg, fast_data_relay) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.flow_credit_window = 4;
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_FAST_DATA_HEAD, true);
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent_1 = atbus::node::create();
+        atbus::node::ptr_t node_parent_2 = atbus::node::create();
+        atbus::node::ptr_t node_child_1 = atbus::node::create();
+        atbus::node::ptr_t node_child_2 = atbus::node::create();
+        node_parent_1->on_debug = node_msg_test_on_debug;
+        node_parent_2->on_debug = node_msg_test_on_debug;
+        node_child_1->on_debug = node_msg_test_on_debug;
+        node_child_2->on_debug = node_msg_test_on_debug;
+        node_parent_1->set_on_error_handle(node_msg_test_on_error);
+        node_parent_2->set_on_error_handle(node_msg_test_on_error);
+        node_child_1->set_on_error_handle(node_msg_test_on_error);
+        node_child_2->set_on_error_handle(node_msg_test_on_error);
+
+        node_parent_1->init(0x12345678, &conf);
+        node_parent_2->init(0x12356789, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+        conf.father_address = "ipv4://127.0.0.1:16388";
+        node_child_2->init(0x12354678, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16390"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node_child_2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node_parent_1->connect("ipv4://127.0.0.1:16388");
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node_child_1->is_endpoint_available(node_parent_1->get_id()) &&
+                                node_parent_1->is_endpoint_available(node_child_1->get_id()) &&
+                                node_child_2->is_endpoint_available(node_parent_2->get_id()) &&
+                                node_parent_2->is_endpoint_available(node_child_2->get_id()) &&
+                                node_parent_1->is_endpoint_available(node_parent_2->get_id()) &&
+                                node_parent_2->is_endpoint_available(node_parent_1->get_id()) &&
+                                node_child_1->get_endpoint(node_parent_1->get_id())->is_flow_credit_enabled() &&
+                                node_parent_1->get_endpoint(node_parent_2->get_id())->get_flag(atbus::endpoint::flag_t::FAST_DATA_HEAD) &&
+                                node_parent_2->get_endpoint(node_child_2->get_id())->get_flag(atbus::endpoint::flag_t::FAST_DATA_HEAD),
+                            8000, 64) {
+            node_parent_1->proc(proc_t, 0);
+            node_parent_2->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+
+            ++proc_t;
+        }
+
+        atbus::endpoint *origin_ep = node_child_1->get_endpoint(node_parent_1->get_id());
+        size_t fast_forward_times_1 = node_parent_1->get_stat_fast_forward_times();
+        size_t fast_forward_times_2 = node_parent_2->get_stat_fast_forward_times();
+
+        std::string send_data;
+        send_data.assign("fast data relay\0payload\n", sizeof("fast data relay\0payload\n") - 1);
+
+        int count = recv_msg_history.count;
+        for (int i = 0; i < 4; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size()));
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size()));
+            count += 2;
+
+            // 直接转发时也要归还来源的流控窗口
+            UNITTEST_WAIT_UNTIL(conf.ev_loop, count <= recv_msg_history.count && 4 == origin_ep->get_flow_credits(), 8000, 0) {}
+            CASE_EXPECT_EQ(count, recv_msg_history.count);
+            CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+            CASE_EXPECT_EQ(4, origin_ep->get_flow_credits());
+        }
+
+        // 两个中转节点都没有解包
+        CASE_EXPECT_EQ(fast_forward_times_1 + 8, node_parent_1->get_stat_fast_forward_times());
+        CASE_EXPECT_EQ(fast_forward_times_2 + 8, node_parent_2->get_stat_fast_forward_times());
+
+        // 需要回包的消息走完整流程
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                       node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size(), true));
+        ++count;
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, count <= recv_msg_history.count, 8000, 0) {}
+        CASE_EXPECT_EQ(count, recv_msg_history.count);
+        CASE_EXPECT_EQ(fast_forward_times_1 + 8, node_parent_1->get_stat_fast_forward_times());
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 注册时协商能力，只使用双方都支持的部分
+CASE_TEST(atbus_node_msg, capability_negotiation) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_FAST_DATA_HEAD, true);
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_child = atbus::node::create();
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_child->on_debug = node_msg_test_on_debug;
+        node_parent->set_on_error_handle(node_msg_test_on_error);
+        node_child->set_on_error_handle(node_msg_test_on_error);
+
+        node_parent->init(0x12345678, &conf);
+
+        // 子节点不开启定长二进制头
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        conf.flags.set(atbus::node::conf_flag_t::EN_CONF_FAST_DATA_HEAD, false);
+        node_child->init(0x12346789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->start());
+
+        time_t proc_t = time(NULL) + 1;
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node_child->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_child->get_id()) &&
+                                0 != node_child->get_endpoint(node_parent->get_id())->get_protocol_version() &&
+                                0 != node_parent->get_endpoint(node_child->get_id())->get_protocol_version(),
+                            8000, 64) {
+            node_parent->proc(proc_t, 0);
+            node_child->proc(proc_t, 0);
+            ++proc_t;
+        }
+
+        atbus::endpoint *parent_ep = node_child->get_endpoint(node_parent->get_id());
+        atbus::endpoint *child_ep = node_parent->get_endpoint(node_child->get_id());
+        CASE_EXPECT_TRUE(NULL != parent_ep && NULL != child_ep);
+        if (NULL != parent_ep && NULL != child_ep) {
+            CASE_EXPECT_EQ(atbus::protocol::reg_data::PROTOCOL_VERSION, parent_ep->get_protocol_version());
+            CASE_EXPECT_EQ(atbus::protocol::reg_data::PROTOCOL_VERSION, child_ep->get_protocol_version());
+
+            CASE_EXPECT_TRUE(parent_ep->check_capability(atbus::protocol::reg_data::EN_CAP_BOUNDED_ROUTER));
+            CASE_EXPECT_TRUE(child_ep->check_capability(atbus::protocol::reg_data::EN_CAP_FLOW_CREDIT));
+            CASE_EXPECT_FALSE(parent_ep->check_capability(atbus::protocol::reg_data::EN_CAP_FAST_DATA_HEAD));
+            CASE_EXPECT_FALSE(child_ep->check_capability(atbus::protocol::reg_data::EN_CAP_FAST_DATA_HEAD));
+            CASE_EXPECT_FALSE(parent_ep->get_flag(atbus::endpoint::flag_t::FAST_DATA_HEAD));
+            CASE_EXPECT_FALSE(child_ep->get_flag(atbus::endpoint::flag_t::FAST_DATA_HEAD));
+        }
+
+        node_child->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+
+        // 父节点开启了定长二进制头，但子节点不支持，所以还是使用msgpack
+        {
+            std::string send_data;
+            send_data.assign("parent to child\0capability\n", sizeof("parent to child\0capability\n") - 1);
+
+            int count = recv_msg_history.count;
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->send_data(node_child->get_id(), 123, send_data.data(), send_data.size()));
+            UNITTEST_WAIT_UNTIL(conf.ev_loop, count != recv_msg_history.count, 3000, 0) {}
+
+            CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        }
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 合并发送小数据
+CASE_TEST(atbus_node_msg, send_batch) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.send_batch_size = 4096;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_child = atbus::node::create();
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_child->on_debug = node_msg_test_on_debug;
+        node_parent->set_on_error_handle(node_msg_test_on_error);
+        node_child->set_on_error_handle(node_msg_test_on_error);
+
+        node_parent->init(0x12345678, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child->init(0x12346789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->start());
+
+        time_t proc_t = time(NULL) + 1;
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node_child->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_child->get_id()) &&
+                                0 != node_child->get_endpoint(node_parent->get_id())->get_protocol_version(),
+                            8000, 64) {
+            node_parent->proc(proc_t, 0);
+            node_child->proc(proc_t, 0);
+            ++proc_t;
+        }
+
+        std::vector<std::pair<int, std::string> > recv_data;
+        node_parent->set_on_recv_handle([&recv_data](const atbus::node &, const atbus::endpoint *, const atbus::connection *,
+                                                     const atbus::protocol::msg &m, const void *buffer, size_t len) {
+            recv_data.push_back(std::make_pair(m.head.type, std::string(reinterpret_cast<const char *>(buffer), len)));
+            return 0;
+        });
+
+        // 合并的数据在flush后才发送，接收端逐条回调
+        {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->send_data(node_parent->get_id(), 1, "batch 1", 7));
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->send_data(node_parent->get_id(), 2, "batch 22", 8));
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->send_data(node_parent->get_id(), 3, NULL, 0));
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->flush());
+
+            UNITTEST_WAIT_UNTIL(conf.ev_loop, recv_data.size() >= 3, 3000, 0) {}
+
+            CASE_EXPECT_EQ(3, recv_data.size());
+            if (3 == recv_data.size()) {
+                CASE_EXPECT_EQ(1, recv_data[0].first);
+                CASE_EXPECT_EQ("batch 1", recv_data[0].second);
+                CASE_EXPECT_EQ(2, recv_data[1].first);
+                CASE_EXPECT_EQ("batch 22", recv_data[1].second);
+                CASE_EXPECT_EQ(3, recv_data[2].first);
+                CASE_EXPECT_TRUE(recv_data[2].second.empty());
+            }
+        }
+
+        // 需要回包的数据不合并，但要排在之前合并的数据后面
+        {
+            recv_data.clear();
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->send_data(node_parent->get_id(), 4, "batch 4", 7));
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->send_data(node_parent->get_id(), 5, "direct 5", 8, true));
+
+            UNITTEST_WAIT_UNTIL(conf.ev_loop, recv_data.size() >= 2, 3000, 0) {}
+
+            CASE_EXPECT_EQ(2, recv_data.size());
+            if (2 == recv_data.size()) {
+                CASE_EXPECT_EQ(4, recv_data[0].first);
+                CASE_EXPECT_EQ(5, recv_data[1].first);
+                CASE_EXPECT_EQ("direct 5", recv_data[1].second);
+            }
+        }
+
+        // proc时自动发送
+        {
+            recv_data.clear();
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->send_data(node_parent->get_id(), 6, "batch 6", 7));
+            node_child->proc(proc_t, 0);
+
+            UNITTEST_WAIT_UNTIL(conf.ev_loop, recv_data.size() >= 1, 3000, 0) {}
+
+            CASE_EXPECT_EQ(1, recv_data.size());
+            if (1 == recv_data.size()) {
+                CASE_EXPECT_EQ(6, recv_data[0].first);
+                CASE_EXPECT_EQ("batch 6", recv_data[0].second);
+            }
+        }
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 多目标发送，下一跳相同的目标只发一次，由父节点继续拆分
+CASE_TEST(atbus_node_msg, send_data_multi) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_child_1 = atbus::node::create();
+        atbus::node::ptr_t node_child_2 = atbus::node::create();
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_child_1->on_debug = node_msg_test_on_debug;
+        node_child_2->on_debug = node_msg_test_on_debug;
+        node_parent->set_on_error_handle(node_msg_test_on_error);
+        node_child_1->set_on_error_handle(node_msg_test_on_error);
+        node_child_2->set_on_error_handle(node_msg_test_on_error);
+
+        node_parent->init(0x12345678, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+        node_child_2->init(0x12346890, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16389"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+
+        time_t proc_t = time(NULL) + 1;
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node_child_1->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_child_1->get_id()) &&
+                                node_child_2->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_child_2->get_id()) &&
+                                0 != node_child_1->get_endpoint(node_parent->get_id())->get_protocol_version() &&
+                                0 != node_parent->get_endpoint(node_child_2->get_id())->get_protocol_version(),
+                            8000, 64) {
+            node_parent->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+            ++proc_t;
+        }
+
+        std::map<atbus::node::bus_id_t, std::vector<std::string> > recv_data;
+        size_t recv_count = 0;
+        atbus::node::evt_msg_t::on_recv_msg_fn_t recv_fn = [&recv_data, &recv_count](
+                                                               const atbus::node &n, const atbus::endpoint *, const atbus::connection *,
+                                                               const atbus::protocol::msg &m, const void *buffer, size_t len) {
+            CASE_EXPECT_EQ(7, m.head.type);
+            recv_data[n.get_id()].push_back(std::string(reinterpret_cast<const char *>(buffer), len));
+            ++recv_count;
+            return 0;
+        };
+        node_parent->set_on_recv_handle(recv_fn);
+        node_child_1->set_on_recv_handle(recv_fn);
+        node_child_2->set_on_recv_handle(recv_fn);
+
+        // 重复的目标只收到一次，发给父节点和兄弟节点的部分合并成一条消息
+        atbus::node::bus_id_t targets[] = {node_parent->get_id(), node_child_2->get_id(), node_child_1->get_id(),
+                                           node_child_2->get_id()};
+        std::string send_data = "multicast to parent, brother and self";
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->send_data_multi(targets, sizeof(targets) / sizeof(targets[0]), 7,
+                                                                           send_data.data(), send_data.size()));
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, recv_count >= 3, 3000, 0) {}
+        for (int j = 0; j < 16; ++j) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(4);
+        }
+
+        CASE_EXPECT_EQ(3, recv_count);
+        CASE_EXPECT_EQ(1, recv_data[node_parent->get_id()].size());
+        CASE_EXPECT_EQ(1, recv_data[node_child_1->get_id()].size());
+        CASE_EXPECT_EQ(1, recv_data[node_child_2->get_id()].size());
+        if (1 == recv_data[node_child_2->get_id()].size()) {
+            CASE_EXPECT_EQ(send_data, recv_data[node_child_2->get_id()][0]);
+        }
+
+        // 没有目标
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->send_data_multi(NULL, 0, 7, send_data.data(), send_data.size()));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_PARAMS, node_child_1->send_data_multi(NULL, 1, 7, send_data.data(), send_data.size()));
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 子树广播，每个节点只收到一次，目标范围外的节点收不到
+CASE_TEST(atbus_node_msg, send_data_broadcast) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_child_1 = atbus::node::create();
+        atbus::node::ptr_t node_child_2 = atbus::node::create();
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_child_1->on_debug = node_msg_test_on_debug;
+        node_child_2->on_debug = node_msg_test_on_debug;
+        node_parent->set_on_error_handle(node_msg_test_on_error);
+        node_child_1->set_on_error_handle(node_msg_test_on_error);
+        node_child_2->set_on_error_handle(node_msg_test_on_error);
+
+        node_parent->init(0x12345678, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+        node_child_2->init(0x12346890, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16389"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+
+        time_t proc_t = time(NULL) + 1;
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node_child_1->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_child_1->get_id()) &&
+                                node_child_2->is_endpoint_available(node_parent->get_id()) &&
+                                node_parent->is_endpoint_available(node_child_2->get_id()) &&
+                                0 != node_child_1->get_endpoint(node_parent->get_id())->get_protocol_version() &&
+                                0 != node_parent->get_endpoint(node_child_2->get_id())->get_protocol_version(),
+                            8000, 64) {
+            node_parent->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+            ++proc_t;
+        }
+
+        std::map<atbus::node::bus_id_t, std::vector<std::string> > recv_data;
+        size_t recv_count = 0;
+        atbus::node::evt_msg_t::on_recv_msg_fn_t recv_fn = [&recv_data, &recv_count](
+                                                               const atbus::node &n, const atbus::endpoint *, const atbus::connection *,
+                                                               const atbus::protocol::msg &m, const void *buffer, size_t len) {
+            CASE_EXPECT_EQ(9, m.head.type);
+            CASE_EXPECT_TRUE(NULL != m.body.forward && m.body.forward->check_flag(atbus::protocol::forward_data::FLAG_BROADCAST));
+            recv_data[n.get_id()].push_back(std::string(reinterpret_cast<const char *>(buffer), len));
+            ++recv_count;
+            return 0;
+        };
+        node_parent->set_on_recv_handle(recv_fn);
+        node_child_1->set_on_recv_handle(recv_fn);
+        node_child_2->set_on_recv_handle(recv_fn);
+
+        // 广播给父节点的整个子树，包括发送者自己
+        {
+            std::string send_data = "broadcast to parent's subtree";
+            uint32_t mask = node_parent->get_self_endpoint()->get_children_mask();
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                           node_child_1->send_data_broadcast(node_parent->get_id(), mask, 9, send_data.data(), send_data.size()));
+
+            UNITTEST_WAIT_UNTIL(conf.ev_loop, recv_count >= 3, 3000, 0) {}
+            for (int j = 0; j < 16; ++j) {
+                uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+                CASE_THREAD_SLEEP_MS(4);
+            }
+
+            CASE_EXPECT_EQ(3, recv_count);
+            CASE_EXPECT_EQ(1, recv_data[node_parent->get_id()].size());
+            CASE_EXPECT_EQ(1, recv_data[node_child_1->get_id()].size());
+            CASE_EXPECT_EQ(1, recv_data[node_child_2->get_id()].size());
+            if (1 == recv_data[node_child_2->get_id()].size()) {
+                CASE_EXPECT_EQ(send_data, recv_data[node_child_2->get_id()][0]);
+            }
+        }
+
+        // 只广播给兄弟节点的子树，经过父节点转发但父节点不回调
+        {
+            recv_data.clear();
+            recv_count = 0;
+            std::string send_data = "broadcast to brother's subtree";
+            uint32_t mask = node_child_2->get_self_endpoint()->get_children_mask();
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                           node_child_1->send_data_broadcast(node_child_2->get_id(), mask, 9, send_data.data(), send_data.size()));
+
+            UNITTEST_WAIT_UNTIL(conf.ev_loop, recv_count >= 1, 3000, 0) {}
+            for (int j = 0; j < 16; ++j) {
+                uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+                CASE_THREAD_SLEEP_MS(4);
+            }
+
+            CASE_EXPECT_EQ(1, recv_count);
+            CASE_EXPECT_EQ(0, recv_data[node_parent->get_id()].size());
+            CASE_EXPECT_EQ(0, recv_data[node_child_1->get_id()].size());
+            CASE_EXPECT_EQ(1, recv_data[node_child_2->get_id()].size());
+        }
+
+        // 父节点发给多个子节点时共享同一份打包结果
+        {
+            recv_data.clear();
+            recv_count = 0;
+            std::string send_data = "broadcast from parent";
+            uint32_t mask = node_parent->get_self_endpoint()->get_children_mask();
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS,
+                           node_parent->send_data_broadcast(node_parent->get_id(), mask, 9, send_data.data(), send_data.size()));
+
+            UNITTEST_WAIT_UNTIL(conf.ev_loop, recv_count >= 3, 3000, 0) {}
+            for (int j = 0; j < 16; ++j) {
+                uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+                CASE_THREAD_SLEEP_MS(4);
+            }
+
+            CASE_EXPECT_EQ(3, recv_count);
+            CASE_EXPECT_EQ(1, recv_data[node_child_1->get_id()].size());
+            CASE_EXPECT_EQ(1, recv_data[node_child_2->get_id()].size());
+            if (1 == recv_data[node_child_1->get_id()].size() && 1 == recv_data[node_child_2->get_id()].size()) {
+                CASE_EXPECT_EQ(send_data, recv_data[node_child_1->get_id()][0]);
+                CASE_EXPECT_EQ(send_data, recv_data[node_child_2->get_id()][0]);
+            }
+        }
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 跨子树的热点流量超过阈值后建立直连，之后不再经过父节点中转
+/*
+//       F1 ------------ F2
+//      /                  \
+//    C11 ................ C21
+*/
+CASE_TEST(atbus_node_msg, peer_connect) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.peer_connect_threshold = 4;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent_1 = atbus::node::create();
+        atbus::node::ptr_t node_parent_2 = atbus::node::create();
+        atbus::node::ptr_t node_child_1 = atbus::node::create();
+        atbus::node::ptr_t node_child_2 = atbus::node::create();
+        node_parent_1->on_debug = node_msg_test_on_debug;
+        node_parent_2->on_debug = node_msg_test_on_debug;
+        node_child_1->on_debug = node_msg_test_on_debug;
+        node_child_2->on_debug = node_msg_test_on_debug;
+        node_parent_1->set_on_error_handle(node_msg_test_on_error);
+        node_parent_2->set_on_error_handle(node_msg_test_on_error);
+        node_child_1->set_on_error_handle(node_msg_test_on_error);
+        node_child_2->set_on_error_handle(node_msg_test_on_error);
+
+        node_parent_1->init(0x12345678, &conf);
+        node_parent_2->init(0x12356789, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+        conf.father_address = "ipv4://127.0.0.1:16388";
+        node_child_2->init(0x12354678, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16390"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node_parent_1->connect("ipv4://127.0.0.1:16388");
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node_child_1->is_endpoint_available(node_parent_1->get_id()) &&
+                                node_child_2->is_endpoint_available(node_parent_2->get_id()) &&
+                                node_parent_1->is_endpoint_available(node_parent_2->get_id()) &&
+                                node_parent_2->is_endpoint_available(node_parent_1->get_id()),
+                            8000, 64) {
+            node_parent_1->proc(proc_t, 0);
+            node_parent_2->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+
+            ++proc_t;
+        }
+
+        int recv_count = 0;
+        const atbus::endpoint *recv_from_ep = NULL;
+        node_child_2->set_on_recv_handle([&recv_count, &recv_from_ep](const atbus::node &, const atbus::endpoint *ep,
+                                                                      const atbus::connection *, const atbus::protocol::msg &,
+                                                                      const void *, size_t) {
+            recv_from_ep = ep;
+            ++recv_count;
+            return 0;
+        });
+
+        // 低于阈值时不建立直连
+        std::string send_data = "hot cross subtree flow";
+        for (int i = 0; i < 2; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size()));
+        }
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, recv_count >= 2, 8000, 0) {}
+        for (int i = 0; i < 4; ++i) {
+            node_parent_1->proc(proc_t, 0);
+            node_parent_2->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+            ++proc_t;
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(4);
+        }
+        CASE_EXPECT_TRUE(node_child_1->get_peers().empty());
+        CASE_EXPECT_EQ(NULL, node_child_1->get_endpoint(node_child_2->get_id()));
+
+        // 超过阈值后经由父节点请求对端地址并直连
+        for (int i = 0; i < 8; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size()));
+        }
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            recv_count >= 10 && node_child_1->is_endpoint_available(node_child_2->get_id()) &&
+                                node_child_2->is_endpoint_available(node_child_1->get_id()),
+                            8000, 64) {
+            node_parent_1->proc(proc_t, 0);
+            node_parent_2->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+
+            ++proc_t;
+        }
+
+        CASE_EXPECT_EQ(1, node_child_1->get_peers().size());
+        CASE_EXPECT_EQ(1, node_child_2->get_peers().size());
+        CASE_EXPECT_TRUE(node_child_1->is_endpoint_available(node_child_2->get_id()));
+
+        // 直连后的数据直接来自对端
+        recv_from_ep = NULL;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size()));
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, recv_count >= 11, 8000, 0) {}
+        CASE_EXPECT_EQ(11, recv_count);
+        CASE_EXPECT_NE(NULL, recv_from_ep);
+        if (NULL != recv_from_ep) {
+            CASE_EXPECT_EQ(node_child_1->get_id(), recv_from_ep->get_id());
+        }
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
+// 连续发往同一目标时命中下一跳缓存，节点移除后缓存失效
+CASE_TEST(atbus_node_msg, route_cache) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_child = atbus::node::create();
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_child->on_debug = node_msg_test_on_debug;
+        node_parent->set_on_error_handle(node_msg_test_on_error);
+        node_child->set_on_error_handle(node_msg_test_on_error);
+
+        node_parent->init(0x12345678, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child->init(0x12346789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->start());
+
+        time_t proc_t = time(NULL) + 1;
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, node_child->is_endpoint_available(node_parent->get_id()) &&
+                                              node_parent->is_endpoint_available(node_child->get_id()),
+                            8000, 64) {
+            node_parent->proc(proc_t, 0);
+            node_child->proc(proc_t, 0);
+            ++proc_t;
+        }
+
+        node_child->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+
+        std::string send_data;
+        send_data.assign("route cache\0hello world!\n", sizeof("route cache\0hello world!\n") - 1);
+
+        // 第一次发送填充缓存，之后的发送都命中
+        int count = recv_msg_history.count;
+        size_t hit_times = node_parent->get_stat_route_cache_hit_times();
+        for (int i = 0; i < 8; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->send_data(node_child->get_id(), 0, send_data.data(), send_data.size()));
+        }
+        CASE_EXPECT_GE(node_parent->get_stat_route_cache_hit_times(), hit_times + 7);
+
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, count + 8 <= recv_msg_history.count, 3000, 0) {}
+        CASE_EXPECT_EQ(count + 8, recv_msg_history.count);
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+
+        // 移除子节点后不能再使用缓存中的连接
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->disconnect(node_child->get_id()));
+        hit_times = node_parent->get_stat_route_cache_hit_times();
+        CASE_EXPECT_NE(EN_ATBUS_ERR_SUCCESS, node_parent->send_data(node_child->get_id(), 0, send_data.data(), send_data.size()));
+        CASE_EXPECT_EQ(hit_times, node_parent->get_stat_route_cache_hit_times());
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
+
 // TODO 发送给已下线兄弟节点并失败的回复通知测试（网络失败）
 
 
@@ -20,6 +20,8 @@
 
 #include "frame/test_macros.h"
 
+#include "atbus_test_utils.h"
+
 #include <stdarg.h>
 
 #if 0
@@ -83,3 +85,162 @@ static int node_nodesync_test_recv_msg_test_record_fn(const atbus::node& n, cons
 // TODO 全量表通知给父节点和子节点测试
 
 #endif
+
+static void node_sync_test_on_debug(const char *file_path, size_t line, const atbus::node &n, const atbus::endpoint *ep,
+                                    const atbus::connection *conn, const atbus::protocol::msg *, const char *fmt, ...) {
+    size_t offset = 0;
+    for (size_t i = 0; file_path[i]; ++i) {
+        if ('/' == file_path[i] || '\\' == file_path[i]) {
+            offset = i + 1;
+        }
+    }
+    file_path += offset;
+
+    std::streamsize w = std::cout.width();
+    CASE_MSG_INFO() << "[Log Debug][" << std::setw(24) << file_path << ":" << std::setw(4) << line << "] node=0x" << std::setfill('0')
+                    << std::hex << std::setw(8) << n.get_id() << ", ep=0x" << std::setw(8) << (NULL == ep ? 0 : ep->get_id())
+                    << ", c=" << conn << std::setfill(' ') << std::setw(w) << std::dec << "\t";
+
+    va_list ap;
+    va_start(ap, fmt);
+
+    vprintf(fmt, ap);
+
+    va_end(ap);
+
+    puts("");
+}
+
+static const atbus::node::route_entry_t *node_sync_test_find_route(const atbus::node &n, atbus::node::bus_id_t id) {
+    atbus::node::route_table_t::const_iterator iter = n.get_route_table().find(id);
+    if (iter == n.get_route_table().end()) {
+        return NULL;
+    }
+
+    return &iter->second;
+}
+
+// 全局路由表同步，跨子树的节点通过路由表转发
+/*
+//       F1 ------------ F2
+//      /                  \
+//    C11                  C21
+*/
+CASE_TEST(atbus_node_sync, global_router_table) {
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_GLOBAL_ROUTER);
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent_1 = atbus::node::create();
+        atbus::node::ptr_t node_parent_2 = atbus::node::create();
+        atbus::node::ptr_t node_child_1 = atbus::node::create();
+        atbus::node::ptr_t node_child_2 = atbus::node::create();
+        node_parent_1->on_debug = node_sync_test_on_debug;
+        node_parent_2->on_debug = node_sync_test_on_debug;
+        node_child_1->on_debug = node_sync_test_on_debug;
+        node_child_2->on_debug = node_sync_test_on_debug;
+
+        node_parent_1->init(0x12345678, &conf);
+        node_parent_2->init(0x12356789, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+        conf.father_address = "ipv4://127.0.0.1:16388";
+        node_child_2->init(0x12354678, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16390"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node_parent_1->connect("ipv4://127.0.0.1:16388");
+
+        // 等待注册完成并且路由表推送到C11
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            node_child_1->is_endpoint_available(node_parent_1->get_id()) &&
+                                node_child_2->is_endpoint_available(node_parent_2->get_id()) &&
+                                node_parent_1->is_endpoint_available(node_parent_2->get_id()) &&
+                                node_parent_2->is_endpoint_available(node_parent_1->get_id()) &&
+                                NULL != node_sync_test_find_route(*node_child_1, node_child_2->get_id()) &&
+                                NULL != node_sync_test_find_route(*node_child_2, node_child_1->get_id()),
+                            8000, 64) {
+            node_parent_1->proc(proc_t, 0);
+            node_parent_2->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+
+            ++proc_t;
+        }
+
+        const atbus::node::route_entry_t *route = node_sync_test_find_route(*node_parent_1, node_child_2->get_id());
+        CASE_EXPECT_NE(NULL, route);
+        if (NULL != route) {
+            CASE_EXPECT_EQ(node_parent_2->get_id(), route->next_hop);
+            CASE_EXPECT_EQ(2, route->distance);
+        }
+
+        route = node_sync_test_find_route(*node_child_1, node_child_2->get_id());
+        CASE_EXPECT_NE(NULL, route);
+        if (NULL != route) {
+            CASE_EXPECT_EQ(node_parent_1->get_id(), route->next_hop);
+            CASE_EXPECT_EQ(3, route->distance);
+            CASE_EXPECT_EQ(8, route->children_mask);
+        }
+
+        // 直连节点的距离是1
+        route = node_sync_test_find_route(*node_child_1, node_parent_1->get_id());
+        CASE_EXPECT_NE(NULL, route);
+        if (NULL != route) {
+            CASE_EXPECT_EQ(node_parent_1->get_id(), route->next_hop);
+            CASE_EXPECT_EQ(1, route->distance);
+        }
+
+        // 开启全局路由表后不再回退到父节点，经由路由表转发
+        std::string recv_data;
+        int recv_count = 0;
+        node_child_2->set_on_recv_handle([&recv_data, &recv_count](const atbus::node &, const atbus::endpoint *, const atbus::connection *,
+                                                                   const atbus::protocol::msg &, const void *buffer, size_t len) {
+            recv_data.assign(reinterpret_cast<const char *>(buffer), len);
+            ++recv_count;
+            return 0;
+        });
+
+        std::string send_data = "transfer by global router table";
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size()));
+        UNITTEST_WAIT_UNTIL(conf.ev_loop, recv_count > 0, 8000, 0) {}
+        CASE_EXPECT_EQ(1, recv_count);
+        CASE_EXPECT_EQ(send_data, recv_data);
+
+        // 节点下线后路由逐级删除
+        node_child_2->reset();
+        UNITTEST_WAIT_UNTIL(conf.ev_loop,
+                            NULL == node_sync_test_find_route(*node_child_1, 0x12354678) &&
+                                NULL == node_sync_test_find_route(*node_parent_1, 0x12354678),
+                            8000, 64) {
+            node_parent_1->proc(proc_t, 0);
+            node_parent_2->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+
+            ++proc_t;
+        }
+
+        CASE_EXPECT_EQ(NULL, node_sync_test_find_route(*node_child_1, 0x12354678));
+        CASE_EXPECT_EQ(NULL, node_sync_test_find_route(*node_parent_1, 0x12354678));
+        CASE_EXPECT_NE(NULL, node_sync_test_find_route(*node_child_1, node_parent_2->get_id()));
+    }
+
+    unit_test_setup_exit(&ev_loop);
+}
@@ -2,6 +2,8 @@
 #include <sstream>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <vector>
 
 #include "common/string_oprs.h"
 
@@ -15,6 +17,7 @@
 
 #include <atbus_node.h>
 
+#include "detail/endpoint_index.h"
 #include "detail/libatbus_protocol.h"
 
 #include "frame/test_macros.h"
@@ -60,6 +63,376 @@ CASE_TEST(atbus_node_rela, basic_test)
     }
 }
 
+CASE_TEST(atbus_node_rela, msg_unpacker_reuse)
+{
+    atbus::protocol::msg m_src;
+    std::string packed_buffer;
+    char test_buffer[] = "hello world!";
+
+    {
+        m_src.init(0x12345678, ATBUS_CMD_DATA_TRANSFORM_REQ, 123, 0, 13);
+        m_src.body.make_forward(456, 789, test_buffer, sizeof(test_buffer));
+        m_src.body.forward->router.push_back(210);
+        m_src.body.forward->router.push_back(211);
+
+        std::stringstream ss;
+        msgpack::pack(ss, m_src);
+        packed_buffer = ss.str();
+    }
+
+    // 内存分配次数的检查在test/alloc里，这里只检查复用解包器的结果
+    const size_t loop_times = 128;
+    size_t success_times = 0;
+    atbus::protocol::msg_unpacker unpacker;
+    for (size_t i = 0; i < loop_times; ++i) {
+        atbus::protocol::msg *m = unpacker.unpack(packed_buffer.data(), packed_buffer.size());
+        if (NULL != m && NULL != m->body.forward && 2 == m->body.forward->router.size() && 456 == m->body.forward->from &&
+            789 == m->body.forward->to && sizeof(test_buffer) == m->body.forward->content.size &&
+            0 == memcmp(test_buffer, m->body.forward->content.ptr, sizeof(test_buffer))) {
+            ++success_times;
+        }
+    }
+    CASE_EXPECT_EQ(loop_times, success_times);
+
+    // 解出的bin数据直接引用输入缓冲区
+    atbus::protocol::msg *m = unpacker.unpack(packed_buffer.data(), packed_buffer.size());
+    CASE_EXPECT_NE(NULL, m);
+    if (NULL != m && NULL != m->body.forward) {
+        CASE_EXPECT_GE(reinterpret_cast<const char *>(m->body.forward->content.ptr), packed_buffer.data());
+        CASE_EXPECT_LT(reinterpret_cast<const char *>(m->body.forward->content.ptr), packed_buffer.data() + packed_buffer.size());
+    }
+
+    // 不同类型的消息交替解包
+    {
+        atbus::protocol::msg ping_msg;
+        ping_msg.init(0x12345678, ATBUS_CMD_NODE_PING, 0, 0, 14);
+        ping_msg.body.make_body(ping_msg.body.ping)->time_point = 1234;
+        std::stringstream ss;
+        msgpack::pack(ss, ping_msg);
+        std::string ping_buffer = ss.str();
+
+        m = unpacker.unpack(ping_buffer.data(), ping_buffer.size());
+        CASE_EXPECT_NE(NULL, m);
+        if (NULL != m) {
+            CASE_EXPECT_EQ(ATBUS_CMD_NODE_PING, m->head.cmd);
+            CASE_EXPECT_EQ(NULL, m->body.forward);
+            CASE_EXPECT_NE(NULL, m->body.ping);
+            if (NULL != m->body.ping) {
+                CASE_EXPECT_EQ(1234, m->body.ping->time_point);
+            }
+        }
+
+        m = unpacker.unpack(packed_buffer.data(), packed_buffer.size());
+        CASE_EXPECT_NE(NULL, m);
+        if (NULL != m) {
+            CASE_EXPECT_EQ(ATBUS_CMD_DATA_TRANSFORM_REQ, m->head.cmd);
+            CASE_EXPECT_EQ(NULL, m->body.ping);
+            CASE_EXPECT_NE(NULL, m->body.forward);
+        }
+    }
+
+    unpacker.release();
+}
+
+CASE_TEST(atbus_node_rela, fast_data_head)
+{
+    atbus::protocol::msg m_src;
+    char test_buffer[] = "hello world!";
+    char packed_buffer[256] = {0};
+
+    m_src.init(0x12345678, ATBUS_CMD_DATA_TRANSFORM_RSP, 123, -5, 13);
+    m_src.body.make_forward(456, 789, test_buffer, sizeof(test_buffer));
+    m_src.body.forward->router.push_back(210);
+    m_src.body.forward->router.push_back(211);
+    m_src.body.forward->set_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP);
+
+    size_t packed_size = atbus::protocol::fast_data_head::packed_size(m_src);
+    CASE_EXPECT_EQ(atbus::protocol::fast_data_head::HEAD_SIZE + 2 * atbus::protocol::fast_data_head::ROUTER_NODE_SIZE + sizeof(test_buffer),
+                   packed_size);
+    CASE_EXPECT_EQ(0, atbus::protocol::fast_data_head::pack(m_src, packed_buffer, packed_size - 1));
+    CASE_EXPECT_EQ(packed_size, atbus::protocol::fast_data_head::pack(m_src, packed_buffer, sizeof(packed_buffer)));
+
+    atbus::protocol::msg_unpacker unpacker;
+    atbus::protocol::msg *m_dst = unpacker.unpack(packed_buffer, packed_size);
+    CASE_EXPECT_NE(NULL, m_dst);
+    if (NULL != m_dst && NULL != m_dst->body.forward) {
+        CASE_EXPECT_EQ(ATBUS_CMD_DATA_TRANSFORM_RSP, m_dst->head.cmd);
+        CASE_EXPECT_EQ(123, m_dst->head.type);
+        CASE_EXPECT_EQ(-5, m_dst->head.ret);
+        CASE_EXPECT_EQ(13, m_dst->head.sequence);
+        CASE_EXPECT_EQ(0x12345678, m_dst->head.src_bus_id);
+
+        CASE_EXPECT_EQ(456, m_dst->body.forward->from);
+        CASE_EXPECT_EQ(789, m_dst->body.forward->to);
+        CASE_EXPECT_EQ(2, m_dst->body.forward->router.size());
+        CASE_EXPECT_EQ(211, m_dst->body.forward->router.back());
+        CASE_EXPECT_TRUE(m_dst->body.forward->check_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP));
+        CASE_EXPECT_EQ(sizeof(test_buffer), m_dst->body.forward->content.size);
+        CASE_EXPECT_EQ(0, memcmp(test_buffer, m_dst->body.forward->content.ptr, sizeof(test_buffer)));
+    }
+
+    // 截断的数据
+    CASE_EXPECT_EQ(NULL, unpacker.unpack(packed_buffer, atbus::protocol::fast_data_head::HEAD_SIZE + 1));
+
+    // 控制消息不支持
+    atbus::protocol::msg ping_msg;
+    ping_msg.init(0x12345678, ATBUS_CMD_NODE_PING, 0, 0, 14);
+    ping_msg.body.make_body(ping_msg.body.ping);
+    CASE_EXPECT_FALSE(atbus::protocol::fast_data_head::is_supported(ping_msg));
+    CASE_EXPECT_EQ(0, atbus::protocol::fast_data_head::pack(ping_msg, packed_buffer, sizeof(packed_buffer)));
+}
+
+CASE_TEST(atbus_node_rela, fast_data_view)
+{
+    atbus::protocol::msg m_src;
+    char test_buffer[] = "hello world!";
+    char packed_buffer[256] = {0};
+
+    m_src.init(0x12345678, ATBUS_CMD_DATA_TRANSFORM_REQ, 123, 0, 13);
+    m_src.body.make_forward(456, 789, test_buffer, sizeof(test_buffer));
+    m_src.body.forward->router.push_back(210);
+    size_t packed_size = atbus::protocol::fast_data_head::pack(m_src, packed_buffer, sizeof(packed_buffer));
+    CASE_EXPECT_NE(0, packed_size);
+
+    // 直接在缓冲区上读取，不解包
+    atbus::protocol::fast_data_view view(packed_buffer, packed_size);
+    CASE_EXPECT_TRUE(view.is_valid());
+    CASE_EXPECT_EQ(ATBUS_CMD_DATA_TRANSFORM_REQ, view.get_cmd());
+    CASE_EXPECT_EQ(123, view.get_type());
+    CASE_EXPECT_EQ(13, view.get_sequence());
+    CASE_EXPECT_EQ(0x12345678, view.get_src_bus_id());
+    CASE_EXPECT_EQ(456, view.get_from());
+    CASE_EXPECT_EQ(789, view.get_to());
+    CASE_EXPECT_EQ(1, view.get_router_size());
+    CASE_EXPECT_EQ(210, view.get_router(0));
+    CASE_EXPECT_EQ(sizeof(test_buffer), view.get_content_size());
+    CASE_EXPECT_EQ(reinterpret_cast<const void *>(packed_buffer + packed_size - sizeof(test_buffer)), view.get_content());
+    CASE_EXPECT_EQ(1, view.get_passed_hops());
+
+    // 中转时只重新生成消息头，数据段和原消息拼接后和完整打包的结果一致
+    {
+        char relay_buffer[256] = {0};
+        size_t head_size = atbus::protocol::fast_data_head::pack_relay_head(view, 211, relay_buffer, sizeof(relay_buffer));
+        CASE_EXPECT_EQ(view.get_content_offset() + atbus::protocol::fast_data_head::ROUTER_NODE_SIZE, head_size);
+        CASE_EXPECT_EQ(0, atbus::protocol::fast_data_head::pack_relay_head(view, 211, relay_buffer, head_size - 1));
+        memcpy(relay_buffer + head_size, view.get_content(), view.get_content_size());
+
+        m_src.head.src_bus_id = 211;
+        m_src.body.forward->router.push_back(211);
+        char expect_buffer[256] = {0};
+        size_t expect_size = atbus::protocol::fast_data_head::pack(m_src, expect_buffer, sizeof(expect_buffer));
+        CASE_EXPECT_EQ(expect_size, head_size + view.get_content_size());
+        CASE_EXPECT_EQ(0, memcmp(expect_buffer, relay_buffer, expect_size));
+    }
+
+    // 非法数据
+    CASE_EXPECT_FALSE(atbus::protocol::fast_data_view(packed_buffer, atbus::protocol::fast_data_head::HEAD_SIZE + 1).is_valid());
+    CASE_EXPECT_FALSE(atbus::protocol::fast_data_view(packed_buffer + 1, packed_size - 1).is_valid());
+    CASE_EXPECT_FALSE(atbus::protocol::fast_data_view(NULL, 0).is_valid());
+}
+
+CASE_TEST(atbus_node_rela, bounded_router)
+{
+    atbus::protocol::msg m_src;
+    char test_buffer[] = "hello world!";
+    const size_t hop_times = atbus::protocol::forward_data::ROUTER_TRACE_SIZE + 3;
+
+    m_src.init(0x12345678, ATBUS_CMD_DATA_TRANSFORM_REQ, 123, 0, 13);
+    m_src.body.make_forward(456, 789, test_buffer, sizeof(test_buffer));
+    m_src.body.forward->set_flag(atbus::protocol::forward_data::FLAG_BOUNDED_ROUTER);
+    for (size_t i = 0; i < hop_times; ++i) {
+        m_src.body.forward->push_router(static_cast<ATBUS_MACRO_BUSID_TYPE>(200 + i), false);
+    }
+
+    // 不再展开router，跳数和最近的节点记录在定长数组里
+    CASE_EXPECT_TRUE(m_src.body.forward->router.empty());
+    CASE_EXPECT_EQ(hop_times, m_src.body.forward->get_hop_count());
+    CASE_EXPECT_EQ(atbus::protocol::forward_data::ROUTER_TRACE_SIZE, m_src.body.forward->get_router_trace_size());
+    size_t last_trace_idx = (hop_times - 1) % atbus::protocol::forward_data::ROUTER_TRACE_SIZE;
+    CASE_EXPECT_EQ(200 + hop_times - 1, m_src.body.forward->router_trace[last_trace_idx]);
+
+    // msgpack
+    {
+        std::stringstream ss;
+        msgpack::pack(ss, m_src);
+        std::string packed_buffer = ss.str();
+
+        atbus::protocol::msg_unpacker unpacker;
+        atbus::protocol::msg *m_dst = unpacker.unpack(packed_buffer.data(), packed_buffer.size());
+        CASE_EXPECT_NE(NULL, m_dst);
+        if (NULL != m_dst && NULL != m_dst->body.forward) {
+            CASE_EXPECT_TRUE(m_dst->body.forward->router.empty());
+            CASE_EXPECT_EQ(hop_times, m_dst->body.forward->get_hop_count());
+            CASE_EXPECT_EQ(0, memcmp(m_src.body.forward->router_trace, m_dst->body.forward->router_trace,
+                                     sizeof(m_src.body.forward->router_trace)));
+        }
+    }
+
+    // 定长二进制头，长度不随跳数增长
+    {
+        char packed_buffer[256] = {0};
+        size_t packed_size = atbus::protocol::fast_data_head::pack(m_src, packed_buffer, sizeof(packed_buffer));
+        CASE_EXPECT_EQ(atbus::protocol::fast_data_head::HEAD_SIZE +
+                           atbus::protocol::forward_data::ROUTER_TRACE_SIZE * atbus::protocol::fast_data_head::ROUTER_NODE_SIZE +
+                           sizeof(test_buffer),
+                       packed_size);
+
+        atbus::protocol::msg_unpacker unpacker;
+        atbus::protocol::msg *m_dst = unpacker.unpack(packed_buffer, packed_size);
+        CASE_EXPECT_NE(NULL, m_dst);
+        if (NULL != m_dst && NULL != m_dst->body.forward) {
+            CASE_EXPECT_TRUE(m_dst->body.forward->check_flag(atbus::protocol::forward_data::FLAG_BOUNDED_ROUTER));
+            CASE_EXPECT_TRUE(m_dst->body.forward->router.empty());
+            CASE_EXPECT_EQ(hop_times, m_dst->body.forward->get_hop_count());
+            CASE_EXPECT_EQ(0, memcmp(m_src.body.forward->router_trace, m_dst->body.forward->router_trace,
+                                     sizeof(m_src.body.forward->router_trace)));
+            CASE_EXPECT_EQ(sizeof(test_buffer), m_dst->body.forward->content.size);
+        }
+
+        // 中转时在环形数组里记录本节点，消息头长度不变
+        atbus::protocol::fast_data_view view(packed_buffer, packed_size);
+        CASE_EXPECT_EQ(hop_times, view.get_passed_hops());
+
+        char relay_buffer[256] = {0};
+        size_t head_size = atbus::protocol::fast_data_head::pack_relay_head(view, 300, relay_buffer, sizeof(relay_buffer));
+        CASE_EXPECT_EQ(view.get_content_offset(), head_size);
+        memcpy(relay_buffer + head_size, view.get_content(), view.get_content_size());
+
+        m_dst = unpacker.unpack(relay_buffer, head_size + view.get_content_size());
+        CASE_EXPECT_NE(NULL, m_dst);
+        if (NULL != m_dst && NULL != m_dst->body.forward) {
+            CASE_EXPECT_EQ(hop_times + 1, m_dst->body.forward->get_hop_count());
+            CASE_EXPECT_EQ(300, m_dst->body.forward->router_trace[hop_times % atbus::protocol::forward_data::ROUTER_TRACE_SIZE]);
+            CASE_EXPECT_EQ(sizeof(test_buffer), m_dst->body.forward->content.size);
+        }
+    }
+
+    // 调试时记录完整路由，这时走msgpack
+    m_src.body.forward->push_router(300, true);
+    CASE_EXPECT_EQ(1, m_src.body.forward->router.size());
+    CASE_EXPECT_EQ(hop_times + 1, m_src.body.forward->get_hop_count());
+    CASE_EXPECT_FALSE(atbus::protocol::fast_data_head::is_supported(m_src));
+
+    // 转发给不支持的节点前展开，跳数不变，已有的router保留在前面
+    m_src.body.forward->expand_router();
+    CASE_EXPECT_FALSE(m_src.body.forward->check_flag(atbus::protocol::forward_data::FLAG_BOUNDED_ROUTER));
+    CASE_EXPECT_EQ(0, m_src.body.forward->hop_count);
+    CASE_EXPECT_EQ(hop_times + 1, m_src.body.forward->router.size());
+    CASE_EXPECT_EQ(hop_times + 1, m_src.body.forward->get_hop_count());
+    CASE_EXPECT_EQ(300, m_src.body.forward->router.front());
+    CASE_EXPECT_EQ(300, m_src.body.forward->router.back());
+    CASE_EXPECT_EQ(200 + hop_times - 1, m_src.body.forward->router[hop_times - 1]);
+    CASE_EXPECT_EQ(0, m_src.body.forward->router[1]);
+
+    m_src.body.forward->push_router(301, false);
+    CASE_EXPECT_EQ(hop_times + 2, m_src.body.forward->router.size());
+}
+
+static uint32_t atbus_node_rela_forward_field_count(const atbus::protocol::msg &m, atbus::protocol::msg &out) {
+    std::stringstream ss;
+    msgpack::pack(ss, m);
+    std::string packed_buffer = ss.str();
+
+    msgpack::unpacked result;
+    msgpack::unpack(result, packed_buffer.data(), packed_buffer.size());
+    msgpack::object obj = result.get();
+    obj.convert(out);
+
+    for (uint32_t i = 0; i < obj.via.map.size; ++i) {
+        if (2 == obj.via.map.ptr[i].key.via.u64 && msgpack::type::ARRAY == obj.via.map.ptr[i].val.type) {
+            return obj.via.map.ptr[i].val.via.array.size;
+        }
+    }
+
+    return 0;
+}
+
+CASE_TEST(atbus_node_rela, forward_data_optional_fields)
+{
+    char test_buffer[] = "hello world!";
+
+    // 普通消息不打包跳数、路由记录和多目标的字段
+    atbus::protocol::msg m_src;
+    m_src.init(0x12345678, ATBUS_CMD_DATA_TRANSFORM_REQ, 123, 0, 13);
+    m_src.body.make_forward(456, 789, test_buffer, sizeof(test_buffer));
+    m_src.body.forward->router.push_back(210);
+    {
+        atbus::protocol::msg m_dst;
+        CASE_EXPECT_EQ(5, atbus_node_rela_forward_field_count(m_src, m_dst));
+        CASE_EXPECT_NE(NULL, m_dst.body.forward);
+        if (NULL != m_dst.body.forward) {
+            CASE_EXPECT_EQ(789, m_dst.body.forward->to);
+            CASE_EXPECT_EQ(1, m_dst.body.forward->router.size());
+            CASE_EXPECT_EQ(0, m_dst.body.forward->hop_count);
+            CASE_EXPECT_TRUE(m_dst.body.forward->targets.empty());
+            CASE_EXPECT_EQ(sizeof(test_buffer), m_dst.body.forward->content.size);
+        }
+    }
+
+    // 定长路由记录只打包已写入的部分
+    m_src.body.forward->router.clear();
+    m_src.body.forward->set_flag(atbus::protocol::forward_data::FLAG_BOUNDED_ROUTER);
+    m_src.body.forward->push_router(210, false);
+    m_src.body.forward->push_router(211, false);
+    {
+        atbus::protocol::msg m_dst;
+        CASE_EXPECT_EQ(7, atbus_node_rela_forward_field_count(m_src, m_dst));
+        if (NULL != m_dst.body.forward) {
+            CASE_EXPECT_EQ(2, m_dst.body.forward->get_hop_count());
+            CASE_EXPECT_EQ(210, m_dst.body.forward->router_trace[0]);
+            CASE_EXPECT_EQ(211, m_dst.body.forward->router_trace[1]);
+        }
+    }
+
+    // 多目标时跳数和路由记录用nil占位
+    m_src.body.forward->unset_flag(atbus::protocol::forward_data::FLAG_BOUNDED_ROUTER);
+    m_src.body.forward->hop_count = 0;
+    m_src.body.forward->set_flag(atbus::protocol::forward_data::FLAG_MULTICAST);
+    m_src.body.forward->targets.push_back(790);
+    m_src.body.forward->targets.push_back(791);
+    {
+        atbus::protocol::msg m_dst;
+        CASE_EXPECT_EQ(9, atbus_node_rela_forward_field_count(m_src, m_dst));
+        if (NULL != m_dst.body.forward) {
+            CASE_EXPECT_EQ(0, m_dst.body.forward->get_hop_count());
+            CASE_EXPECT_EQ(2, m_dst.body.forward->targets.size());
+        }
+    }
+}
+
+CASE_TEST(atbus_node_rela, conn_data_hop_count)
+{
+    atbus::protocol::msg m_src;
+    m_src.init(0x12345678, ATBUS_CMD_NODE_CONN_SYN, 0, 0, 13);
+    atbus::protocol::conn_data *syn = m_src.body.make_body(m_src.body.conn);
+    CASE_EXPECT_NE(NULL, syn);
+    if (NULL == syn) {
+        return;
+    }
+
+    syn->from = 0x12345678;
+    syn->to = 0x12356789;
+    syn->hop_count = 3;
+
+    std::stringstream ss;
+    msgpack::pack(ss, m_src);
+    std::string packed_buffer = ss.str();
+
+    msgpack::unpacked result;
+    msgpack::unpack(result, packed_buffer.data(), packed_buffer.size());
+    atbus::protocol::msg m_dst;
+    result.get().convert(m_dst);
+
+    // 逐跳转发的跳数要随请求一起传递
+    CASE_EXPECT_NE(NULL, m_dst.body.conn);
+    if (NULL != m_dst.body.conn) {
+        CASE_EXPECT_EQ(0x12345678, m_dst.body.conn->from);
+        CASE_EXPECT_EQ(0x12356789, m_dst.body.conn->to);
+        CASE_EXPECT_EQ(3, m_dst.body.conn->hop_count);
+        CASE_EXPECT_TRUE(m_dst.body.conn->channels.empty());
+    }
+}
+
 CASE_TEST(atbus_node_rela, child_endpoint_opr)
 {
     atbus::node::conf_t conf;
@@ -99,3 +472,119 @@ CASE_TEST(atbus_node_rela, child_endpoint_opr)
     // 移除成功
     CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node->remove_endpoint(0x12345589));
 }
+
+// 改用有序数组之前的查找方式，用于对比
+static atbus::endpoint *node_rela_find_child_by_map(const atbus::node::endpoint_collection_t &coll, atbus::node::bus_id_t id) {
+    atbus::node::endpoint_collection_t::const_iterator iter = coll.lower_bound(id);
+    if (iter == coll.end()) {
+        return NULL;
+    }
+
+    if (iter->second->get_id() == id || iter->second->is_child_node(id)) {
+        return iter->second.get();
+    }
+
+    return NULL;
+}
+
+CASE_TEST(atbus_node_rela, find_child_benchmark)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+
+    atbus::node::ptr_t node = atbus::node::create();
+    node->init(0x12345678, &conf);
+
+    // 256个子节点，每个子节点管理16个ID，中间留空洞
+    const atbus::node::bus_id_t base_id = 0x12340000;
+    for (atbus::node::bus_id_t i = 0; i < 512; i += 2) {
+        atbus::endpoint::ptr_t ep = atbus::endpoint::create(node.get(), base_id + (i << 4) + 1, 4, node->get_pid(), node->get_hostname());
+        CASE_EXPECT_EQ(0, node->add_endpoint(ep));
+    }
+    CASE_EXPECT_EQ(256, node->get_children().size());
+
+    atbus::node::endpoint_index_t index;
+    atbus::detail::rebuild_endpoint_index(node->get_children(), index);
+    CASE_EXPECT_EQ(node->get_children().size(), index.size());
+
+    // 查找结果必须和红黑树一致，包括子域空洞和范围外的ID
+    size_t mismatch = 0;
+    for (atbus::node::bus_id_t id = base_id - 16; id < base_id + (512 << 4) + 16; ++id) {
+        if (node_rela_find_child_by_map(node->get_children(), id) != atbus::detail::find_child(index, id)) {
+            ++mismatch;
+        }
+    }
+    CASE_EXPECT_EQ(0, mismatch);
+
+    // 性能对比
+    const size_t id_count = 4096;
+    const size_t loop_times = 256;
+    std::vector<atbus::node::bus_id_t> ids;
+    ids.reserve(id_count);
+    for (size_t i = 0; i < id_count; ++i) {
+        ids.push_back(base_id + static_cast<atbus::node::bus_id_t>(rand() % (512 << 4)));
+    }
+
+    size_t found_map = 0;
+    size_t found_index = 0;
+
+    clock_t begin_clk = clock();
+    for (size_t l = 0; l < loop_times; ++l) {
+        for (size_t i = 0; i < id_count; ++i) {
+            if (NULL != node_rela_find_child_by_map(node->get_children(), ids[i])) {
+                ++found_map;
+            }
+        }
+    }
+    clock_t map_clk = clock() - begin_clk;
+
+    begin_clk = clock();
+    for (size_t l = 0; l < loop_times; ++l) {
+        for (size_t i = 0; i < id_count; ++i) {
+            if (NULL != atbus::detail::find_child(index, ids[i])) {
+                ++found_index;
+            }
+        }
+    }
+    clock_t index_clk = clock() - begin_clk;
+
+    CASE_EXPECT_EQ(found_map, found_index);
+    CASE_MSG_INFO() << "find_child " << id_count * loop_times << " times in " << index.size() << " children, std::map: "
+                    << map_clk * 1000 / CLOCKS_PER_SEC << "ms, sorted vector: " << index_clk * 1000 / CLOCKS_PER_SEC << "ms" << std::endl;
+
+    // 移除后节点内部的索引同步更新
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node->remove_endpoint(base_id + 1));
+    CASE_EXPECT_EQ(NULL, node->get_endpoint(base_id + 1));
+    CASE_EXPECT_NE(NULL, node->get_endpoint(base_id + (2 << 4) + 1));
+}
+
+// 嵌套发送使用的打包缓冲区放回节点后复用
+CASE_TEST(atbus_node_rela, nested_pack_buffer)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+
+    atbus::node::ptr_t node = atbus::node::create();
+    node->init(0x12345678, &conf);
+
+    atbus::detail::buffer_block *block1 = node->alloc_nested_pack_buffer();
+    atbus::detail::buffer_block *block2 = node->alloc_nested_pack_buffer();
+    CASE_EXPECT_NE(NULL, block1);
+    CASE_EXPECT_NE(NULL, block2);
+    CASE_EXPECT_NE(block1, block2);
+    if (NULL == block1 || NULL == block2) {
+        return;
+    }
+    CASE_EXPECT_GE(block1->size(), conf.msg_size);
+
+    node->free_nested_pack_buffer(block2);
+    node->free_nested_pack_buffer(block1);
+
+    // 后放回的先取出
+    CASE_EXPECT_EQ(block1, node->alloc_nested_pack_buffer());
+    CASE_EXPECT_EQ(block2, node->alloc_nested_pack_buffer());
+    node->free_nested_pack_buffer(block1);
+    node->free_nested_pack_buffer(block2);
+}
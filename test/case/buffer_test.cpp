@@ -7,6 +7,8 @@
 #include <memory>
 #include <limits>
 #include <numeric>
+#include <vector>
+#include <algorithm>
 
 #include <detail/libatbus_error.h>
 #include <detail/buffer.h>
@@ -76,6 +78,118 @@ CASE_TEST(buffer, varint)
     CASE_EXPECT_EQ(10, res);
 }
 
+// 逐字节编解码的参考实现，用于校验和性能对比
+static size_t buffer_test_read_vint_bytewise(uint64_t &out, const void *pointer, size_t s) {
+    out = 0;
+    size_t left = s;
+    for (const char *d = reinterpret_cast<const char *>(pointer); left > 0; ++d) {
+        --left;
+        out <<= 7;
+        out |= 0x7F & *d;
+        if (0 == (0x80 & *d)) {
+            return s - left;
+        }
+    }
+
+    return 0;
+}
+
+static size_t buffer_test_write_vint_bytewise(uint64_t in, void *pointer, size_t s) {
+    size_t used = 1;
+    char *d = reinterpret_cast<char *>(pointer);
+    *d = 0x7F & in;
+    in >>= 7;
+    while (in && used + 1 <= s) {
+        ++used;
+        ++d;
+        *d = 0x80 | (in & 0x7F);
+        in >>= 7;
+    }
+
+    if (in) {
+        return 0;
+    }
+
+    std::reverse(reinterpret_cast<char *>(pointer), d + 1);
+    return used;
+}
+
+CASE_TEST(buffer, varint_benchmark)
+{
+    // 每种长度的边界值都要和参考实现一致
+    for (int bits = 0; bits <= 64; ++bits) {
+        uint64_t values[3];
+        values[0] = bits >= 64 ? UINT64_MAX : ((static_cast<uint64_t>(1) << bits) - 1);
+        values[1] = bits >= 64 ? UINT64_MAX : (static_cast<uint64_t>(1) << bits);
+        values[2] = values[0] / 3;
+
+        for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+            char expect_buf[10] = {0};
+            char real_buf[10] = {0};
+            size_t expect_len = buffer_test_write_vint_bytewise(values[i], expect_buf, sizeof(expect_buf));
+            size_t real_len = atbus::detail::fn::write_vint(values[i], real_buf, sizeof(real_buf));
+            CASE_EXPECT_EQ(expect_len, real_len);
+            CASE_EXPECT_EQ(0, memcmp(expect_buf, real_buf, real_len));
+
+            uint64_t out = 0;
+            CASE_EXPECT_EQ(real_len, atbus::detail::fn::read_vint(out, real_buf, real_len));
+            CASE_EXPECT_EQ(values[i], out);
+
+            // 截断的数据
+            if (real_len > 1) {
+                CASE_EXPECT_EQ(0, atbus::detail::fn::read_vint(out, real_buf, real_len - 1));
+                CASE_EXPECT_EQ(0, atbus::detail::fn::write_vint(values[i], real_buf, real_len - 1));
+            }
+        }
+    }
+
+    // 性能对比，数据长度按常见的消息长度分布
+    const size_t value_count = 4096;
+    const size_t loop_times = 256;
+    std::vector<uint64_t> values;
+    std::vector<char> encoded;
+    values.reserve(value_count);
+    encoded.resize(value_count * 10);
+    for (size_t i = 0; i < value_count; ++i) {
+        values.push_back(static_cast<uint64_t>(rand() % 65536));
+    }
+
+    uint64_t checksum_bytewise = 0;
+    uint64_t checksum_fast = 0;
+
+    clock_t begin_clk = clock();
+    for (size_t l = 0; l < loop_times; ++l) {
+        size_t offset = 0;
+        for (size_t i = 0; i < value_count; ++i) {
+            offset += buffer_test_write_vint_bytewise(values[i], &encoded[offset], encoded.size() - offset);
+        }
+        for (size_t read_offset = 0; read_offset < offset;) {
+            uint64_t out = 0;
+            read_offset += buffer_test_read_vint_bytewise(out, &encoded[read_offset], offset - read_offset);
+            checksum_bytewise += out;
+        }
+    }
+    clock_t bytewise_clk = clock() - begin_clk;
+
+    begin_clk = clock();
+    for (size_t l = 0; l < loop_times; ++l) {
+        size_t offset = 0;
+        for (size_t i = 0; i < value_count; ++i) {
+            offset += atbus::detail::fn::write_vint(values[i], &encoded[offset], encoded.size() - offset);
+        }
+        for (size_t read_offset = 0; read_offset < offset;) {
+            uint64_t out = 0;
+            read_offset += atbus::detail::fn::read_vint(out, &encoded[read_offset], offset - read_offset);
+            checksum_fast += out;
+        }
+    }
+    clock_t fast_clk = clock() - begin_clk;
+
+    CASE_EXPECT_EQ(checksum_bytewise, checksum_fast);
+    CASE_MSG_INFO() << "varint encode+decode " << value_count * loop_times << " times, bytewise: " << bytewise_clk * 1000 / CLOCKS_PER_SEC
+                    << "ms, current: " << fast_clk * 1000 / CLOCKS_PER_SEC << "ms" << std::endl;
+}
+
 CASE_TEST(buffer, buffer_block)
 {
     // size align
@@ -122,8 +236,83 @@ CASE_TEST(buffer, buffer_block)
     CASE_EXPECT_EQ(buf[fs - 1], -1);
 }
 
+CASE_TEST(buffer, fixed_buffer_stream)
+{
+    char buf[16] = {0};
+    atbus::detail::fixed_buffer_stream stream(buf, 8);
+    CASE_EXPECT_EQ(8, stream.capacity());
+    CASE_EXPECT_EQ(0, stream.size());
+
+    stream.write("0123", 4);
+    stream.write("4567", 4);
+    CASE_EXPECT_EQ(8, stream.size());
+    CASE_EXPECT_FALSE(stream.overflow());
+    CASE_EXPECT_EQ(0, memcmp(buf, "01234567", 8));
+
+    // overflow, only accumulate size
+    stream.write("89", 2);
+    CASE_EXPECT_EQ(10, stream.size());
+    CASE_EXPECT_TRUE(stream.overflow());
+    CASE_EXPECT_EQ(0, buf[8]);
+
+    stream.write("a", 1);
+    CASE_EXPECT_EQ(11, stream.size());
+    CASE_EXPECT_EQ(0, buf[8]);
+
+    stream.reset();
+    CASE_EXPECT_EQ(0, stream.size());
+    CASE_EXPECT_FALSE(stream.overflow());
+    stream.write("ab", 2);
+    CASE_EXPECT_EQ(0, memcmp(buf, "ab234567", 8));
+
+    // null buffer
+    atbus::detail::fixed_buffer_stream null_stream(NULL, 8);
+    null_stream.write("0123", 4);
+    CASE_EXPECT_TRUE(null_stream.overflow());
+}
+
 
 // push back ============== pop front
+CASE_TEST(buffer, shared_buffer)
+{
+    const char seg1[] = "hello ";
+    const char seg2[] = "world";
+    const void* bufs[3] = {seg1, NULL, seg2};
+    size_t lens[3] = {6, 100, 5};
+
+    atbus::detail::shared_buffer_ptr p(atbus::detail::shared_buffer::create(bufs, lens, 3));
+    CASE_EXPECT_TRUE(!!p);
+    CASE_EXPECT_EQ(11, p->size());
+    CASE_EXPECT_EQ(1, p->use_count());
+    CASE_EXPECT_EQ(0, memcmp(p->data(), "hello world", 11));
+
+    {
+        atbus::detail::shared_buffer_ptr q = p;
+        CASE_EXPECT_EQ(p.get(), q.get());
+        CASE_EXPECT_EQ(2, p->use_count());
+
+        atbus::detail::shared_buffer_ptr r;
+        CASE_EXPECT_FALSE(!!r);
+        r = q;
+        CASE_EXPECT_EQ(3, p->use_count());
+
+        r.reset();
+        CASE_EXPECT_EQ(2, p->use_count());
+    }
+    CASE_EXPECT_EQ(1, p->use_count());
+
+    // manual reference
+    p->add_ref();
+    CASE_EXPECT_EQ(2, p->use_count());
+    p->release();
+    CASE_EXPECT_EQ(1, p->use_count());
+
+    atbus::detail::shared_buffer* raw = atbus::detail::shared_buffer::malloc(0);
+    CASE_EXPECT_NE(NULL, raw);
+    CASE_EXPECT_EQ(0, raw->size());
+    raw->release();
+}
+
 CASE_TEST(buffer, dynamic_buffer_manager_bf)
 {
     atbus::detail::buffer_manager mgr;
@@ -872,6 +1061,211 @@ CASE_TEST(buffer, dynamic_buffer_manager_merge)
 }
 
 
+CASE_TEST(buffer, dynamic_buffer_manager_link)
+{
+    atbus::detail::buffer_manager mgr;
+    void* pointer;
+
+    // 0 1 2 3
+    for (int i = 1; i <= 3; ++ i) {
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 16 * i));
+        memset(pointer, i, 16 * i);
+    }
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_front(pointer, 8));
+    memset(pointer, 0, 8);
+    CASE_EXPECT_EQ(4, mgr.limit().cost_number_);
+
+    // merge the middle of list should keep links
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.merge_front(pointer, 8));
+    memset(pointer, 0x10, 8);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.merge_back(pointer, 16));
+    memset(pointer, 0x30, 16);
+    CASE_EXPECT_EQ(16, mgr.front()->raw_size());
+    CASE_EXPECT_EQ(64, mgr.back()->raw_size());
+
+    // 0 1 2
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_back(64));
+    CASE_EXPECT_EQ(32, mgr.back()->raw_size());
+    CHECK_BUFFER(mgr.back()->data(), 32, 2);
+
+    // 1 2
+    CHECK_BUFFER(mgr.front()->data(), 8, 0);
+    CHECK_BUFFER(atbus::detail::fn::buffer_next(mgr.front()->data(), 8), 8, 0x10);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_front(16));
+    CHECK_BUFFER(mgr.front()->data(), 16, 1);
+
+    // 1
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_back(32));
+    CASE_EXPECT_EQ(mgr.front(), mgr.back());
+
+    // 3 1
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_front(pointer, 48));
+    memset(pointer, 3, 48);
+    CHECK_BUFFER(mgr.front()->data(), 48, 3);
+    CHECK_BUFFER(mgr.back()->data(), 16, 1);
+    CASE_EXPECT_EQ(2, mgr.limit().cost_number_);
+
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_front(48));
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_front(16));
+    CASE_EXPECT_TRUE(mgr.empty());
+    CASE_EXPECT_EQ(NULL, mgr.front());
+    CASE_EXPECT_EQ(NULL, mgr.back());
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_NO_DATA, mgr.pop_back(1));
+
+    // reset with data
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 16));
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 16));
+    mgr.reset();
+    CASE_EXPECT_TRUE(mgr.empty());
+    CASE_EXPECT_EQ(NULL, mgr.back());
+}
+
+CASE_TEST(buffer, dynamic_buffer_manager_pool)
+{
+    atbus::detail::buffer_block_pool pool;
+    size_t class_sizes[] = {1024, 256, 256, 4096};
+    CASE_EXPECT_TRUE(pool.set_size_classes(class_sizes, sizeof(class_sizes) / sizeof(class_sizes[0])));
+    CASE_EXPECT_EQ(3, pool.get_size_classes().size());
+    CASE_EXPECT_EQ(256, pool.get_size_classes()[0]);
+    CASE_EXPECT_EQ(4096, pool.get_size_classes()[2]);
+    pool.set_max_idle_size(atbus::detail::buffer_block::full_size(1024) * 2);
+
+    atbus::detail::buffer_manager mgr;
+    CASE_EXPECT_TRUE(mgr.set_block_pool(&pool));
+    CASE_EXPECT_EQ(&pool, mgr.get_block_pool());
+
+    // first round, all blocks are new
+    void* pointer;
+    for (int i = 0; i < 4; ++ i) {
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 100 + i * 200));
+        memset(pointer, i, 100 + i * 200);
+    }
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 8192));
+    CASE_EXPECT_EQ(0, pool.get_stat().hit_count);
+    CASE_EXPECT_EQ(1, pool.get_stat().oversize_count);
+    CASE_EXPECT_EQ(4, pool.get_stat().used_number);
+
+    // can not change pool or size classes when blocks in use
+    CASE_EXPECT_FALSE(mgr.set_block_pool(NULL));
+    CASE_EXPECT_FALSE(pool.set_size_classes(class_sizes, 1));
+
+    CHECK_BUFFER(mgr.front()->data(), 100, 0);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_front(100));
+    CHECK_BUFFER(mgr.front()->data(), 300, 1);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_front(300));
+    CASE_EXPECT_EQ(2, pool.get_stat().held_number);
+    CASE_EXPECT_EQ(atbus::detail::buffer_block::full_size(256) + atbus::detail::buffer_block::full_size(1024), pool.get_stat().held_size);
+
+    // reuse blocks in free lists
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 200));
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 800));
+    CASE_EXPECT_EQ(2, pool.get_stat().hit_count);
+    CASE_EXPECT_EQ(0, pool.get_stat().held_number);
+    CASE_EXPECT_EQ(0, pool.get_stat().held_size);
+
+    // idle size limit, only 2 blocks of 1024 or less can be cached
+    mgr.reset();
+    CASE_EXPECT_EQ(0, pool.get_stat().used_number);
+    CASE_EXPECT_LE(pool.get_stat().held_size, pool.get_max_idle_size());
+    CASE_EXPECT_GT(pool.get_stat().trim_count, 0);
+    CASE_EXPECT_GT(pool.get_hit_rate(), 0.0);
+    CASE_EXPECT_LT(pool.get_hit_rate(), 1.0);
+
+    size_t held_number = pool.get_stat().held_number;
+    CASE_EXPECT_GT(held_number, 0);
+    pool.trim(0);
+    CASE_EXPECT_EQ(0, pool.get_stat().held_number);
+    CASE_EXPECT_EQ(0, pool.get_stat().held_size);
+
+    // merge also use the pool
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, 100));
+    memset(pointer, 0x5a, 100);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.merge_back(pointer, 100));
+    memset(pointer, 0xa5, 100);
+    CASE_EXPECT_EQ(200, mgr.back()->raw_size());
+    CHECK_BUFFER(mgr.back()->raw_data(), 100, 0x5a);
+    CHECK_BUFFER(atbus::detail::fn::buffer_next(mgr.back()->raw_data(), 100), 100, 0xa5);
+    CASE_EXPECT_EQ(1, pool.get_stat().used_number);
+    CASE_EXPECT_EQ(1, pool.get_stat().held_number);
+
+    mgr.reset();
+    CASE_EXPECT_TRUE(mgr.set_block_pool(NULL));
+}
+
+CASE_TEST(buffer, static_buffer_manager_overflow)
+{
+    atbus::detail::buffer_manager mgr;
+    mgr.set_mode(1024, 4, 1024);
+    CASE_EXPECT_TRUE(mgr.is_static_mode());
+    CASE_EXPECT_TRUE(mgr.is_overflow_enabled());
+    CASE_EXPECT_EQ(2048, mgr.limit().limit_size_);
+
+    void* pointer;
+    size_t s = 200;
+    // 0-3 in circle buffer, 4-7 overflow
+    for (int i = 0; i < 8; ++ i) {
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, s));
+        memset(pointer, i, s);
+        CASE_EXPECT_EQ(i >= 4, mgr.is_overflowed());
+    }
+    CASE_EXPECT_EQ(8, mgr.limit().cost_number_);
+    CASE_EXPECT_EQ(8 * s, mgr.limit().cost_size_);
+
+    // total size limit
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_BUFF_LIMIT, mgr.push_back(pointer, 2048 - 8 * s + 1));
+
+    // can not push front when circle buffer is full
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_BUFF_LIMIT, mgr.push_front(pointer, s));
+    CHECK_BUFFER(mgr.back()->data(), s, 7);
+
+    // pop back from overflow blocks
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_back(s));
+    CHECK_BUFFER(mgr.back()->data(), s, 6);
+
+    // keep order
+    for (int j = 0; j < 5; ++ j) {
+        CASE_EXPECT_TRUE(mgr.is_overflowed());
+        CHECK_BUFFER(mgr.front()->data(), s, j);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_front(s));
+    }
+
+    // circle buffer is empty now, push_back still go after overflow blocks
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, s));
+    memset(pointer, 8, s);
+    // push_front go to circle buffer
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_front(pointer, s));
+    memset(pointer, 4, s);
+    CASE_EXPECT_EQ(4, mgr.limit().cost_number_);
+
+    CHECK_BUFFER(mgr.front()->data(), s, 4);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_front(s));
+    CHECK_BUFFER(mgr.front()->data(), s, 5);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_front(s));
+    CHECK_BUFFER(mgr.front()->data(), s, 6);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_front(s));
+    CHECK_BUFFER(mgr.front()->data(), s, 8);
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.pop_front(s));
+
+    // overflow blocks are released
+    CASE_EXPECT_TRUE(mgr.empty());
+    CASE_EXPECT_FALSE(mgr.is_overflowed());
+    CASE_EXPECT_EQ(0, mgr.limit().cost_number_);
+    CASE_EXPECT_EQ(0, mgr.limit().cost_size_);
+
+    // back to circle buffer
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, s));
+    CASE_EXPECT_FALSE(mgr.is_overflowed());
+
+    // disabled by default
+    mgr.set_mode(1024, 4);
+    CASE_EXPECT_FALSE(mgr.is_overflow_enabled());
+    for (int i = 0; i < 4; ++ i) {
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, mgr.push_back(pointer, s));
+    }
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_BUFF_LIMIT, mgr.push_back(pointer, s));
+    CASE_EXPECT_FALSE(mgr.is_overflowed());
+}
+
 CASE_TEST(buffer, static_buffer_manager_merge_back)
 {
     // merge back : head NN tail ... => head NN NN tail ...
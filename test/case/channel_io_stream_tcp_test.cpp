@@ -8,6 +8,7 @@
 #include <iostream>
 #include <map>
 #include <memory>
+#include <vector>
 
 
 #include "detail/libatbus_channel_export.h"
@@ -440,6 +441,570 @@ CASE_TEST(channel, io_stream_tcp_size_extended) {
     atbus::channel::io_stream_close(&svr);
 }
 
+static std::pair<int, int> g_watermark_rec = std::make_pair(0, 0);
+static void watermark_callback_test_fn(atbus::channel::io_stream_channel *channel,       // 事件触发的channel
+                                       atbus::channel::io_stream_connection *connection, // 事件触发的连接
+                                       int status,                                       // libuv传入的转态码
+                                       void *,                                           // 额外参数(不同事件不同含义)
+                                       size_t s                                          // 额外参数长度
+                                       ) {
+    CASE_EXPECT_NE(NULL, channel);
+    CASE_EXPECT_NE(NULL, connection);
+    CASE_EXPECT_EQ(0, status);
+
+    if (ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, atbus::channel::io_stream_connection::EN_CF_CONGESTED)) {
+        CASE_EXPECT_GE(s, channel->conf.send_buffer_high_watermark);
+        ++g_watermark_rec.first;
+    } else {
+        CASE_EXPECT_LE(s, channel->conf.send_buffer_low_watermark);
+        ++g_watermark_rec.second;
+    }
+}
+
+static void recv_count_callback_fn(atbus::channel::io_stream_channel *channel,       // 事件触发的channel
+                                   atbus::channel::io_stream_connection *connection, // 事件触发的连接
+                                   int status,                                       // libuv传入的转态码
+                                   void *input,                                      // 额外参数(不同事件不同含义)
+                                   size_t s                                          // 额外参数长度
+                                   ) {
+    if (status >= 0 && NULL != input) {
+        ++g_recv_rec.first;
+        g_recv_rec.second += s;
+    }
+}
+
+// 低水位不低于高水位的配置在初始化时修正
+CASE_TEST(channel, io_stream_watermark_conf) {
+    atbus::channel::io_stream_channel channel;
+    atbus::channel::io_stream_conf conf;
+    atbus::channel::io_stream_init_configure(&conf);
+    conf.send_buffer_high_watermark = 64 * 1024;
+    conf.send_buffer_low_watermark = 64 * 1024;
+
+    atbus::channel::io_stream_init(&channel, NULL, &conf);
+    CASE_EXPECT_EQ(64 * 1024, channel.conf.send_buffer_high_watermark);
+    CASE_EXPECT_EQ(32 * 1024, channel.conf.send_buffer_low_watermark);
+    atbus::channel::io_stream_close(&channel);
+
+    // 不启用时不修正
+    conf.send_buffer_high_watermark = 0;
+    conf.send_buffer_low_watermark = 16 * 1024;
+    atbus::channel::io_stream_init(&channel, NULL, &conf);
+    CASE_EXPECT_EQ(16 * 1024, channel.conf.send_buffer_low_watermark);
+    atbus::channel::io_stream_close(&channel);
+}
+
+CASE_TEST(channel, io_stream_tcp_watermark) {
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_conf conf;
+    atbus::channel::io_stream_init_configure(&conf);
+    conf.send_buffer_high_watermark = 64 * 1024;
+    conf.send_buffer_low_watermark = 16 * 1024;
+
+    atbus::channel::io_stream_init(&svr, NULL, &conf);
+    atbus::channel::io_stream_init(&cli, NULL, &conf);
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = recv_count_callback_fn;
+    cli.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_CONGESTED] = watermark_callback_test_fn;
+    cli.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_DRAINED] = watermark_callback_test_fn;
+
+    int check_flag = g_check_flag = 0;
+
+    setup_channel(svr, "ipv6://:::16387", NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    int inited_fds = 0;
+    inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+
+    while (g_check_flag - check_flag < 2 * inited_fds) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_NE(0, cli.conn_pool.size());
+    if (cli.conn_pool.empty()) {
+        atbus::channel::io_stream_close(&cli);
+        atbus::channel::io_stream_close(&svr);
+        return;
+    }
+
+    g_watermark_rec = std::make_pair(0, 0);
+    g_recv_rec = std::make_pair(0, 0);
+
+    // 写完成回调之前数据都还在发送缓冲区内，所以连续发送一定会越过高水位
+    atbus::channel::io_stream_connection *conn = cli.conn_pool.begin()->second.get();
+    const int send_times = 16;
+    for (int i = 0; i < send_times; ++i) {
+        CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(conn, get_test_buffer(), 8 * 1024));
+    }
+    CASE_EXPECT_EQ(1, g_watermark_rec.first);
+    CASE_EXPECT_EQ(0, g_watermark_rec.second);
+    CASE_EXPECT_TRUE(ATBUS_CHANNEL_IOS_CHECK_FLAG(conn->flags, atbus::channel::io_stream_connection::EN_CF_CONGESTED));
+
+    while (g_recv_rec.first < static_cast<size_t>(send_times) || 0 == g_watermark_rec.second) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+
+    CASE_EXPECT_EQ(1, g_watermark_rec.first);
+    CASE_EXPECT_EQ(1, g_watermark_rec.second);
+    CASE_EXPECT_FALSE(ATBUS_CHANNEL_IOS_CHECK_FLAG(conn->flags, atbus::channel::io_stream_connection::EN_CF_CONGESTED));
+
+    atbus::channel::io_stream_close(&cli);
+    atbus::channel::io_stream_close(&svr);
+}
+
+static std::vector<char> g_compress_test_buffer;
+static size_t g_compress_written_size = 0;
+static void compress_written_callback_fn(atbus::channel::io_stream_channel *channel,       // 事件触发的channel
+                                         atbus::channel::io_stream_connection *connection, // 事件触发的连接
+                                         int status,                                       // libuv传入的转态码
+                                         void *,                                           // 额外参数(不同事件不同含义)
+                                         size_t s                                          // 额外参数长度
+                                         ) {
+    CASE_EXPECT_EQ(0, status);
+    g_compress_written_size += s;
+}
+
+static void compress_recv_callback_fn(atbus::channel::io_stream_channel *channel,       // 事件触发的channel
+                                      atbus::channel::io_stream_connection *connection, // 事件触发的连接
+                                      int status,                                       // libuv传入的转态码
+                                      void *input,                                      // 额外参数(不同事件不同含义)
+                                      size_t s                                          // 额外参数长度
+                                      ) {
+    if (status < 0 && NULL == input) {
+        return;
+    }
+
+    CASE_EXPECT_EQ(0, status);
+    CASE_EXPECT_FALSE(g_check_buff_sequence.empty());
+    if (g_check_buff_sequence.empty()) {
+        return;
+    }
+
+    CASE_EXPECT_EQ(g_check_buff_sequence.front().second, s);
+    if (g_check_buff_sequence.front().second == s) {
+        CASE_EXPECT_EQ(0, memcmp(&g_compress_test_buffer[g_check_buff_sequence.front().first], input, s));
+    }
+    g_check_buff_sequence.pop_front();
+
+    ++g_recv_rec.first;
+    g_recv_rec.second += s;
+}
+
+CASE_TEST(channel, io_stream_tcp_compress) {
+    // 可压缩的测试数据
+    g_compress_test_buffer.resize(128 * 1024);
+    for (size_t i = 0; i < g_compress_test_buffer.size(); ++i) {
+        g_compress_test_buffer[i] = static_cast<char>('a' + (i / 7) % 13);
+    }
+
+    const atbus::channel::io_stream_codec *codec = atbus::channel::io_stream_get_codec(atbus::channel::io_stream_codec::EN_CT_LZ);
+    CASE_EXPECT_NE(NULL, codec);
+    if (NULL == codec) {
+        return;
+    }
+    CASE_EXPECT_EQ(NULL, atbus::channel::io_stream_get_codec(atbus::channel::io_stream_codec::EN_CT_NONE));
+
+    // 算法本身的正确性
+    {
+        std::vector<char> compressed(codec->compress_bound(g_compress_test_buffer.size()));
+        std::vector<char> decompressed(g_compress_test_buffer.size());
+        size_t compressed_len = codec->compress(&g_compress_test_buffer[0], g_compress_test_buffer.size(), &compressed[0], compressed.size());
+        CASE_EXPECT_GT(compressed_len, 0);
+        CASE_EXPECT_LT(compressed_len, g_compress_test_buffer.size());
+        CASE_EXPECT_EQ(0, codec->decompress(&compressed[0], compressed_len, &decompressed[0], decompressed.size()));
+        CASE_EXPECT_TRUE(decompressed == g_compress_test_buffer);
+
+        // 错误的长度或数据必须失败
+        CASE_EXPECT_NE(0, codec->decompress(&compressed[0], compressed_len, &decompressed[0], decompressed.size() - 1));
+        CASE_EXPECT_NE(0, codec->decompress(&compressed[0], compressed_len / 2, &decompressed[0], decompressed.size()));
+    }
+
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_conf conf;
+    atbus::channel::io_stream_init_configure(&conf);
+    conf.compress_threshold = 256;
+
+    atbus::channel::io_stream_init(&svr, NULL, &conf);
+    atbus::channel::io_stream_init(&cli, NULL, &conf);
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = compress_recv_callback_fn;
+    cli.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_WRITEN] = compress_written_callback_fn;
+
+    int check_flag = g_check_flag = 0;
+
+    setup_channel(svr, "ipv6://:::16387", NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    int inited_fds = 0;
+    inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+
+    while (g_check_flag - check_flag < 2 * inited_fds) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_NE(0, cli.conn_pool.size());
+    if (cli.conn_pool.empty()) {
+        atbus::channel::io_stream_close(&cli);
+        atbus::channel::io_stream_close(&svr);
+        return;
+    }
+
+    atbus::channel::io_stream_connection *conn = cli.conn_pool.begin()->second.get();
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_NOT_SUPPORT, atbus::channel::io_stream_set_codec(conn, 255));
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_set_codec(conn, atbus::channel::io_stream_codec::EN_CT_LZ));
+
+    g_recv_rec = std::make_pair(0, 0);
+    g_compress_written_size = 0;
+    g_check_buff_sequence.clear();
+
+    // 小于阈值的数据不压缩，大的数据压缩
+    size_t sum_size = 0;
+    size_t test_lens[] = {13, 255, 1024, 32 * 1024, 60 * 1024};
+    for (size_t i = 0; i < sizeof(test_lens) / sizeof(test_lens[0]); ++i) {
+        CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(conn, &g_compress_test_buffer[i], test_lens[i]));
+        g_check_buff_sequence.push_back(std::make_pair(i, test_lens[i]));
+        sum_size += test_lens[i];
+    }
+
+    while (g_recv_rec.first < sizeof(test_lens) / sizeof(test_lens[0])) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+
+    CASE_EXPECT_EQ(sum_size, g_recv_rec.second);
+    CASE_EXPECT_LT(g_compress_written_size, sum_size);
+    CASE_MSG_INFO() << "send " << sum_size << " bytes with " << g_compress_written_size << " bytes after compressed" << std::endl;
+
+    atbus::channel::io_stream_close(&cli);
+    atbus::channel::io_stream_close(&svr);
+}
+
+CASE_TEST(channel, io_stream_tcp_send_v) {
+    g_compress_test_buffer.resize(64 * 1024);
+    for (size_t i = 0; i < g_compress_test_buffer.size(); ++i) {
+        g_compress_test_buffer[i] = static_cast<char>(rand() & 0xFF);
+    }
+
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_conf conf;
+    atbus::channel::io_stream_init_configure(&conf);
+
+    atbus::channel::io_stream_init(&svr, NULL, &conf);
+    atbus::channel::io_stream_init(&cli, NULL, &conf);
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = compress_recv_callback_fn;
+
+    int check_flag = g_check_flag = 0;
+
+    setup_channel(svr, "ipv6://:::16387", NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    int inited_fds = 0;
+    inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+
+    while (g_check_flag - check_flag < 2 * inited_fds) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_NE(0, cli.conn_pool.size());
+    if (cli.conn_pool.empty()) {
+        atbus::channel::io_stream_close(&cli);
+        atbus::channel::io_stream_close(&svr);
+        return;
+    }
+
+    atbus::channel::io_stream_connection *conn = cli.conn_pool.begin()->second.get();
+
+    g_recv_rec = std::make_pair(0, 0);
+    g_check_buff_sequence.clear();
+
+    // 多段数据收到的是一条连续的消息
+    size_t sum_size = 0;
+    size_t recv_times = 0;
+    size_t test_lens[][3] = {{48, 13, 0}, {48, 0, 1024}, {56, 32 * 1024, 7}, {1, 1, 1}};
+    size_t offset = 0;
+    for (size_t i = 0; i < sizeof(test_lens) / sizeof(test_lens[0]); ++i) {
+        const void *bufs[3];
+        size_t total = 0;
+        for (size_t j = 0; j < 3; ++j) {
+            bufs[j] = &g_compress_test_buffer[offset + total];
+            total += test_lens[i][j];
+        }
+
+        CASE_EXPECT_EQ(0, atbus::channel::io_stream_send_v(conn, bufs, test_lens[i], 3));
+        g_check_buff_sequence.push_back(std::make_pair(offset, total));
+        sum_size += total;
+        offset += total;
+        ++recv_times;
+    }
+
+    // 一段数据
+    {
+        const void *bufs[1] = {&g_compress_test_buffer[offset]};
+        size_t lens[1] = {128};
+        CASE_EXPECT_EQ(0, atbus::channel::io_stream_send_v(conn, bufs, lens, 1));
+        g_check_buff_sequence.push_back(std::make_pair(offset, lens[0]));
+        sum_size += lens[0];
+        ++recv_times;
+    }
+
+    while (g_recv_rec.first < recv_times) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+
+    CASE_EXPECT_EQ(recv_times, g_recv_rec.first);
+    CASE_EXPECT_EQ(sum_size, g_recv_rec.second);
+
+    atbus::channel::io_stream_close(&cli);
+    atbus::channel::io_stream_close(&svr);
+}
+
+static std::list<std::pair<size_t, size_t> > g_written_check_sequence;
+static size_t g_written_check_count = 0;
+static void written_check_callback_fn(atbus::channel::io_stream_channel *channel,       // 事件触发的channel
+                                      atbus::channel::io_stream_connection *connection, // 事件触发的连接
+                                      int status,                                       // libuv传入的转态码
+                                      void *input,                                      // 额外参数(不同事件不同含义)
+                                      size_t s                                          // 额外参数长度
+                                      ) {
+    CASE_EXPECT_EQ(0, status);
+    CASE_EXPECT_FALSE(g_written_check_sequence.empty());
+    if (g_written_check_sequence.empty()) {
+        return;
+    }
+
+    CASE_EXPECT_EQ(g_written_check_sequence.front().second, s);
+    if (g_written_check_sequence.front().second == s) {
+        CASE_EXPECT_EQ(0, memcmp(&g_compress_test_buffer[g_written_check_sequence.front().first], input, s));
+    }
+    g_written_check_sequence.pop_front();
+    ++g_written_check_count;
+}
+
+// 写完成时按帧索引回调，合并发送的小包也要逐个回调
+CASE_TEST(channel, io_stream_tcp_written_frames) {
+    g_compress_test_buffer.resize(64 * 1024);
+    for (size_t i = 0; i < g_compress_test_buffer.size(); ++i) {
+        g_compress_test_buffer[i] = static_cast<char>(rand() & 0xFF);
+    }
+
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_init(&svr, NULL, NULL);
+    atbus::channel::io_stream_init(&cli, NULL, NULL);
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = compress_recv_callback_fn;
+    cli.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_WRITEN] = written_check_callback_fn;
+
+    int check_flag = g_check_flag = 0;
+
+    setup_channel(svr, "ipv6://:::16387", NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    int inited_fds = 0;
+    inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+
+    while (g_check_flag - check_flag < 2 * inited_fds) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_NE(0, cli.conn_pool.size());
+    if (cli.conn_pool.empty()) {
+        atbus::channel::io_stream_close(&cli);
+        atbus::channel::io_stream_close(&svr);
+        return;
+    }
+
+    atbus::channel::io_stream_connection *conn = cli.conn_pool.begin()->second.get();
+
+    g_recv_rec = std::make_pair(0, 0);
+    g_check_buff_sequence.clear();
+    g_written_check_sequence.clear();
+    g_written_check_count = 0;
+
+    // 很多小包会被合并成一个发送块，再加上几个大包
+    size_t send_times = 0;
+    size_t offset = 0;
+    for (size_t i = 0; i < 200; ++i) {
+        size_t len = 1 + static_cast<size_t>(rand() % 200);
+        if (0 == i % 50) {
+            len = 4096 + static_cast<size_t>(rand() % 4096);
+        }
+        if (offset + len > g_compress_test_buffer.size()) {
+            offset = 0;
+        }
+
+        CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(conn, &g_compress_test_buffer[offset], len));
+        g_check_buff_sequence.push_back(std::make_pair(offset, len));
+        g_written_check_sequence.push_back(std::make_pair(offset, len));
+        offset += len;
+        ++send_times;
+    }
+
+    while (g_written_check_count < send_times || g_recv_rec.first < send_times) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+
+    CASE_EXPECT_EQ(send_times, g_written_check_count);
+    CASE_EXPECT_EQ(send_times, g_recv_rec.first);
+    CASE_EXPECT_TRUE(conn->write_frames.empty());
+
+    atbus::channel::io_stream_close(&cli);
+    atbus::channel::io_stream_close(&svr);
+}
+
+// 共享数据块只在写队列里保存引用，和普通数据交替发送时顺序不变
+CASE_TEST(channel, io_stream_tcp_send_shared) {
+    g_compress_test_buffer.resize(64 * 1024);
+    for (size_t i = 0; i < g_compress_test_buffer.size(); ++i) {
+        g_compress_test_buffer[i] = static_cast<char>(rand() & 0xFF);
+    }
+
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_init(&svr, NULL, NULL);
+    atbus::channel::io_stream_init(&cli, NULL, NULL);
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = compress_recv_callback_fn;
+    cli.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_WRITEN] = written_check_callback_fn;
+
+    int check_flag = g_check_flag = 0;
+
+    setup_channel(svr, "ipv6://:::16387", NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    int inited_fds = 0;
+    inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+
+    while (g_check_flag - check_flag < 2 * inited_fds) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_NE(0, cli.conn_pool.size());
+    if (cli.conn_pool.empty()) {
+        atbus::channel::io_stream_close(&cli);
+        atbus::channel::io_stream_close(&svr);
+        return;
+    }
+
+    atbus::channel::io_stream_connection *conn = cli.conn_pool.begin()->second.get();
+
+    g_recv_rec = std::make_pair(0, 0);
+    g_check_buff_sequence.clear();
+    g_written_check_sequence.clear();
+    g_written_check_count = 0;
+
+    const size_t shared_offset = 1024;
+    const size_t shared_len = 2048;
+    const void *shared_bufs[1] = {&g_compress_test_buffer[shared_offset]};
+    size_t shared_lens[1] = {shared_len};
+    atbus::detail::shared_buffer_ptr shared(atbus::detail::shared_buffer::create(shared_bufs, shared_lens, 1));
+    CASE_EXPECT_TRUE(!!shared);
+    CASE_EXPECT_EQ(shared_len, shared->size());
+
+    size_t send_times = 0;
+    for (size_t i = 0; i < 64; ++i) {
+        if (0 == i % 4) {
+            CASE_EXPECT_EQ(0, atbus::channel::io_stream_send_shared(conn, shared.get()));
+            g_check_buff_sequence.push_back(std::make_pair(shared_offset, shared_len));
+            g_written_check_sequence.push_back(std::make_pair(shared_offset, shared_len));
+        } else {
+            size_t len = 1 + static_cast<size_t>(rand() % 200);
+            CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(conn, &g_compress_test_buffer[i * 256], len));
+            g_check_buff_sequence.push_back(std::make_pair(i * 256, len));
+            g_written_check_sequence.push_back(std::make_pair(i * 256, len));
+        }
+        ++send_times;
+    }
+
+    // 写队列持有引用
+    CASE_EXPECT_LT(1, shared->use_count());
+
+    while (g_written_check_count < send_times || g_recv_rec.first < send_times) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+
+    CASE_EXPECT_EQ(send_times, g_written_check_count);
+    CASE_EXPECT_EQ(send_times, g_recv_rec.first);
+    CASE_EXPECT_TRUE(conn->write_frames.empty());
+    CASE_EXPECT_EQ(0, conn->write_shared_size);
+    // 全部写完后只剩下自己的引用
+    CASE_EXPECT_EQ(1, shared->use_count());
+
+    atbus::channel::io_stream_close(&cli);
+    atbus::channel::io_stream_close(&svr);
+}
+
+// 写队列里引用的共享数据块也计入普通数据的发送缓冲区限制
+CASE_TEST(channel, io_stream_tcp_send_shared_limit) {
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_conf conf;
+    atbus::channel::io_stream_init_configure(&conf);
+    conf.send_buffer_max_size = 16 * 1024;
+
+    atbus::channel::io_stream_init(&svr, NULL, NULL);
+    atbus::channel::io_stream_init(&cli, NULL, &conf);
+
+    int check_flag = g_check_flag = 0;
+
+    setup_channel(svr, "ipv6://:::16387", NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    int inited_fds = 0;
+    inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+
+    while (g_check_flag - check_flag < 2 * inited_fds) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_NE(0, cli.conn_pool.size());
+    if (cli.conn_pool.empty()) {
+        atbus::channel::io_stream_close(&cli);
+        atbus::channel::io_stream_close(&svr);
+        return;
+    }
+
+    atbus::channel::io_stream_connection *conn = cli.conn_pool.begin()->second.get();
+
+    std::vector<char> shared_data(4 * 1024, 'S');
+    const void *shared_bufs[1] = {&shared_data[0]};
+    size_t shared_lens[1] = {shared_data.size()};
+    atbus::detail::shared_buffer_ptr shared(atbus::detail::shared_buffer::create(shared_bufs, shared_lens, 1));
+
+    for (int i = 0; i < 3; ++i) {
+        CASE_EXPECT_EQ(0, atbus::channel::io_stream_send_shared(conn, shared.get()));
+    }
+    CASE_EXPECT_EQ(3 * shared_data.size(), conn->write_shared_size);
+
+    // 只看写队列本身还放得下，加上共享数据块后超出限制
+    std::vector<char> plain_data(6 * 1024, 'P');
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_BUFF_LIMIT, atbus::channel::io_stream_send(conn, &plain_data[0], plain_data.size()));
+
+    // 共享数据块发送完以后可以继续发送
+    while (0 != conn->write_shared_size) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(conn, &plain_data[0], plain_data.size()));
+
+    atbus::channel::io_stream_close(&cli);
+    atbus::channel::io_stream_close(&svr);
+}
+
 static void connect_failed_callback_test_fn(atbus::channel::io_stream_channel *channel,       // 事件触发的channel
                                             atbus::channel::io_stream_connection *connection, // 事件触发的连接
                                             int status,                                       // libuv传入的转态码
@@ -436,6 +436,72 @@ CASE_TEST(channel, io_stream_unix_size_extended)
     atbus::channel::io_stream_close(&svr);
 }
 
+// unix socket上跳过帧校验和
+CASE_TEST(channel, io_stream_unix_skip_checksum)
+{
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_init(&svr, NULL, NULL);
+    atbus::channel::io_stream_init(&cli, NULL, NULL);
+
+    int check_flag = g_check_flag = 0;
+
+    setup_channel(svr, UNIT_TEST_LISTEN_ADDR, NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    setup_channel(cli, NULL, UNIT_TEST_LISTEN_ADDR);
+
+    while (g_check_flag - check_flag < 3) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_NE(0, cli.conn_pool.size());
+    if (cli.conn_pool.empty()) {
+        atbus::channel::io_stream_close(&cli);
+        atbus::channel::io_stream_close(&svr);
+        return;
+    }
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = recv_callback_check_fn;
+
+    atbus::channel::io_stream_connection* conn = cli.conn_pool.begin()->second.get();
+    CASE_EXPECT_TRUE(atbus::channel::io_stream_is_trusted_transport(conn));
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_set_skip_checksum(conn, true));
+
+    // accept时也已经判定好可信传输标记
+    for (atbus::channel::io_stream_channel::conn_pool_t::iterator iter = svr.conn_pool.begin(); iter != svr.conn_pool.end(); ++iter) {
+        if (ATBUS_CHANNEL_IOS_CHECK_FLAG(iter->second->flags, atbus::channel::io_stream_connection::EN_CF_ACCEPT)) {
+            CASE_EXPECT_TRUE(atbus::channel::io_stream_is_trusted_transport(iter->second.get()));
+        }
+    }
+
+    check_flag = g_check_flag;
+    g_check_buff_sequence.clear();
+    char* buf = get_test_buffer();
+
+    // small buffer
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(conn, buf, 13));
+    g_check_buff_sequence.push_back(std::make_pair(0, 13));
+    // big buffer
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(conn, buf + 1024, 56 * 1024 + 3));
+    g_check_buff_sequence.push_back(std::make_pair(1024, 56 * 1024 + 3));
+
+    // 关闭后恢复为带校验和的帧
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_set_skip_checksum(conn, false));
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(conn, buf + 13, 28));
+    g_check_buff_sequence.push_back(std::make_pair(13, 28));
+
+    while (g_check_flag - check_flag < 3) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_TRUE(g_check_buff_sequence.empty());
+
+    atbus::channel::io_stream_close(&cli);
+    atbus::channel::io_stream_close(&svr);
+}
+
 static void connect_failed_callback_test_fn(
     atbus::channel::io_stream_channel* channel,         // 事件触发的channel
     atbus::channel::io_stream_connection* connection,   // 事件触发的连接